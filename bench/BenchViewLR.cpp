@@ -0,0 +1,293 @@
+// Viewer headers
+#include "MeshKernels.h"
+#include "Camera.h"
+#include "Rect.h"
+#include "PointLocator.h"
+#include "MeshCheck.h"
+
+// standard c++ headers
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/*
+ * Micro-benchmarks of the CPU kernels of the viewer (see MeshKernels.h), run on
+ * synthetic n x n x n grids of elements so that no spline file or display is needed.
+ * Setup work (allocation, resetting the blink state) is done outside the timed region.
+ */
+
+//! \brief timings of one kernel on one mesh size, in milliseconds
+struct Result {
+	string name;
+	long   elements;
+	long   items;      // work items per run, for the per item time
+	vector<double> ms;
+};
+
+//! \brief a synthetic mesh and the render buffers for it
+struct Mesh {
+	long n;
+	long nEl;
+	vector<double> box;
+	vector<double> coord, coord2, normal, color;
+	vector<GLuint> lines, faces;
+	vector<double> rectCoord;
+	vector<double> rectColor;
+	ElementBuffers buffers;
+
+	explicit Mesh(long n) : n(n), nEl(n*n*n) {
+		box.resize(nEl*6);
+		double h = 1.0 / n;
+		long e = 0;
+		for(long k=0; k<n; k++)
+			for(long j=0; j<n; j++)
+				for(long i=0; i<n; i++, e++) {
+					double *b = &box[6*e];
+					b[0] = i*h;  b[1] = j*h;  b[2] = k*h;
+					b[3] = b[0]+h;  b[4] = b[1]+h;  b[5] = b[2]+h;
+				}
+		coord.resize(nEl*24*3);
+		coord2.resize(nEl*24*3);
+		normal.resize(nEl*24*3);
+		color.resize(nEl*24*4);
+		lines.resize(nEl*24);
+		faces.resize(nEl*24);
+		buffers.layout.nEl = nEl;
+		buffers.coord  = &coord[0];
+		buffers.coord2 = &coord2[0];
+		buffers.normal = &normal[0];
+		buffers.color  = &color[0];
+		buffers.lines  = &lines[0];
+		buffers.faces  = &faces[0];
+
+		// one meshrectangle per element, its bottom face
+		rectCoord.resize(nEl*12);
+		rectColor.assign(nEl*16, 0.0);
+		for(e=0; e<nEl; e++) {
+			const double *b = &box[6*e];
+			double *r = &rectCoord[12*e];
+			r[0] = b[0];  r[ 1] = b[1];  r[ 2] = b[2];
+			r[3] = b[3];  r[ 4] = b[1];  r[ 5] = b[2];
+			r[6] = b[3];  r[ 7] = b[4];  r[ 8] = b[2];
+			r[9] = b[0];  r[10] = b[4];  r[11] = b[2];
+		}
+	}
+
+	void tessellate() {
+		double rgb[] = {0.5, 0.5, 0.5};
+		for(long e=0; e<nEl; e++)
+			tessellateElement(buffers, e, &box[6*e], rgb, 0.0);
+	}
+};
+
+/**********************************************************************************//**
+ * \brief times run, calling setup untimed before every repetition
+ *************************************************************************************/
+template<class Setup, class Run>
+vector<double> measure(int warmup, int reps, Setup setup, Run run) {
+	typedef chrono::steady_clock Clock;
+	vector<double> ms;
+	for(int r=0; r<warmup+reps; r++) {
+		setup();
+		Clock::time_point start = Clock::now();
+		run();
+		Clock::time_point stop  = Clock::now();
+		if(r >= warmup)
+			ms.push_back(chrono::duration<double, milli>(stop - start).count());
+	}
+	return ms;
+}
+
+void benchSize(long n, int warmup, int reps, vector<Result> &results) {
+	Mesh   mesh(n);
+	Camera cam;
+	cam.setLookAt(0.5, 0.5, 0.5);
+	cam.setPos(3, 1.0, 0.5);
+	long   nEl     = mesh.nEl;
+	int    count   = max(1L, nEl/20);   // spawn attempts, as after a long pause
+	double midTime = 2.0;
+	BlinkParams fade = {4.0, 0.2, 0.0, 1.0};
+	auto all = [](long) { return true; };
+
+	vector<bool> showing;
+	vector<Rect> blinks;
+	Result r;
+	r.elements = nEl;
+
+	r.name  = "tessellate";
+	r.items = nEl;
+	r.ms    = measure(warmup, reps, [](){}, [&](){ mesh.tessellate(); });
+	results.push_back(r);
+
+	r.name  = "spawnElementBlinks";
+	r.items = count;
+	r.ms    = measure(warmup, reps,
+		[&](){ srand(1); showing.assign(nEl, false); blinks.clear(); blinks.reserve(6*count); },
+		[&](){ spawnElementBlinks(mesh.buffers.layout, nEl, count, showing, all, mesh.buffers.coord, midTime, blinks); });
+	results.push_back(r);
+
+	r.name  = "spawnRectBlinks";
+	r.items = count;
+	r.ms    = measure(warmup, reps,
+		[&](){ srand(1); showing.assign(nEl, false); blinks.clear(); blinks.reserve(count); },
+		[&](){ spawnRectBlinks(nEl, count, showing, all, &mesh.rectCoord[0], midTime, blinks); });
+	results.push_back(r);
+
+	// a blink set with spread out life times, so that sorting and fading have work
+	srand(1);
+	showing.assign(nEl, false);
+	vector<Rect> spawned;
+	for(int i=0; i<8; i++)
+		spawnElementBlinks(mesh.buffers.layout, nEl, count/8+1, showing, all, mesh.buffers.coord, i*0.5, spawned);
+	vector<bool> spawnedShowing = showing;
+
+	r.name  = "sortFaces";
+	r.items = spawned.size();
+	r.ms    = measure(warmup, reps,
+		[&](){ blinks = spawned; },
+		[&](){ sortFaces(blinks, cam); });
+	results.push_back(r);
+
+	r.name  = "fadeBlinks";
+	r.items = spawned.size();
+	r.ms    = measure(warmup, reps,
+		[&](){ blinks = spawned; showing = spawnedShowing; },
+		[&](){ fadeBlinks(blinks, showing, mesh.buffers.color, 3.5, fade); });
+	results.push_back(r);
+
+	vector<double> outCoord, outNormal, outColor;
+	vector<GLuint> outIndex;
+	r.name  = "gatherFaces";
+	r.items = spawned.size();
+	r.ms    = measure(warmup, reps,
+		[&](){ blinks = spawned; },
+		[&](){ gatherFaces(blinks, 0, nEl, mesh.buffers.coord, mesh.buffers.normal, mesh.buffers.color,
+		                   outCoord, outNormal, outColor); });
+	results.push_back(r);
+
+	r.name  = "gatherFaceIndices";
+	r.items = spawned.size();
+	r.ms    = measure(warmup, reps,
+		[&](){ blinks = spawned; },
+		[&](){ gatherFaceIndices(blinks, 0, nEl, outIndex); });
+	results.push_back(r);
+
+	// one random point per element, queried in random order
+	PointLocator locator;
+	r.name  = "buildLocator";
+	r.items = nEl;
+	r.ms    = measure(warmup, reps, [](){}, [&](){ locator.build(&mesh.box[0], nEl); });
+	results.push_back(r);
+
+	srand(1);
+	vector<double> points(3*nEl);
+	for(double &x : points)
+		x = rand() / (double) RAND_MAX;
+	vector<long> found(nEl);
+	r.name  = "locatePoints";
+	r.items = nEl;
+	r.ms    = measure(warmup, reps, [](){}, [&](){ locator.locate(&points[0], nEl, &found[0]); });
+	results.push_back(r);
+
+	vector<double> rectBox(6*nEl);
+	for(long e=0; e<nEl; e++)
+		for(int d=0; d<3; d++) {
+			rectBox[6*e+d  ] = mesh.rectCoord[12*e+d];
+			rectBox[6*e+d+3] = mesh.rectCoord[12*e+6+d];
+		}
+	vector<double> domain = {0, 0, 0, 1, 1, 1};
+	MeshCheck check;
+	r.name  = "checkMesh";
+	r.items = nEl;
+	r.ms    = measure(warmup, reps, [](){}, [&](){ check.run(&mesh.box[0], nEl, NULL, &rectBox[0], nEl, NULL, domain); });
+	results.push_back(r);
+}
+
+void writeJSON(ostream &out, const vector<Result> &results, int warmup, int reps) {
+	out << "{\n";
+	out << "  \"warmup\": " << warmup << ",\n";
+	out << "  \"repetitions\": " << reps << ",\n";
+	out << "  \"benchmarks\": [\n";
+	for(size_t i=0; i<results.size(); i++) {
+		const Result &r = results[i];
+		vector<double> ms = r.ms;
+		sort(ms.begin(), ms.end());
+		double sum = 0;
+		for(double t : ms)
+			sum += t;
+		double mean   = sum / ms.size();
+		double median = (ms.size()%2) ? ms[ms.size()/2] : (ms[ms.size()/2-1] + ms[ms.size()/2]) / 2;
+		out << "    {\"name\": \"" << r.name << "\", \"elements\": " << r.elements
+		    << ", \"items\": " << r.items
+		    << ", \"min_ms\": " << ms.front() << ", \"median_ms\": " << median
+		    << ", \"mean_ms\": " << mean
+		    << ", \"median_ns_per_item\": " << (r.items > 0 ? median*1e6/r.items : 0) << "}"
+		    << ((i+1 < results.size()) ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+void printUsage(char *program) {
+	cerr << "Usage:\n" << program << " [options]" << endl;
+	cerr << "  --sizes <n,n,...>  elements per side of the synthetic grids (default 16,32,64)" << endl;
+	cerr << "  --reps <n>         timed repetitions of every kernel (default 10)" << endl;
+	cerr << "  --warmup <n>       untimed repetitions before them (default 2)" << endl;
+	cerr << "  --out <file>       write the JSON results here instead of to stdout" << endl;
+}
+
+int main(int argc, char **argv) {
+	vector<long> sizes;
+	int    reps   = 10;
+	int    warmup = 2;
+	string outFile;
+	for(int i=1; i<argc; i++) {
+		if(strcmp(argv[i], "--sizes") == 0 && i+1 < argc) {
+			stringstream list(argv[++i]);
+			string n;
+			while(getline(list, n, ','))
+				if(atol(n.c_str()) > 0)
+					sizes.push_back(atol(n.c_str()));
+		} else if(strcmp(argv[i], "--reps") == 0 && i+1 < argc)
+			reps = max(1, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--warmup") == 0 && i+1 < argc)
+			warmup = max(0, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--out") == 0 && i+1 < argc)
+			outFile = argv[++i];
+		else {
+			printUsage(argv[0]);
+			exit(1);
+		}
+	}
+	if(sizes.empty()) {
+		sizes.push_back(16);
+		sizes.push_back(32);
+		sizes.push_back(64);
+	}
+
+	vector<Result> results;
+	for(long n : sizes) {
+		cerr << "Benchmarking " << n << "x" << n << "x" << n << " elements" << endl;
+		benchSize(n, warmup, reps, results);
+	}
+
+	if(outFile.empty()) {
+		writeJSON(cout, results, warmup, reps);
+	} else {
+		ofstream out(outFile.c_str());
+		if(!out) {
+			cerr << "Unable to open \"" << outFile << "\" for writing" << endl;
+			exit(1);
+		}
+		writeJSON(out, results, warmup, reps);
+	}
+	return 0;
+}
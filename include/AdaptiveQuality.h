@@ -0,0 +1,44 @@
+#ifndef _ADAPTIVE_QUALITY_H
+#define _ADAPTIVE_QUALITY_H
+
+#include <GL/glut.h>
+
+//! \brief what is spent on one frame
+struct QualityLevel {
+	const char *name;
+	bool        smoothing;    // GL_LINE_SMOOTH and GL_POLYGON_SMOOTH (nicest)
+	bool        multisample;
+	GLfloat     lineScale;    // factor on all line widths
+	int         lineStride;   // draw the wireframe of every n-th element/meshrectangle
+};
+
+/**********************************************************************************//**
+ * \brief Drops to a cheaper quality level while the view is being moved
+ * Interaction handlers call moved(). The moving level is used from then on, and full
+ * quality returns once nothing has moved for the still delay. update() applies the
+ * GL part of the level, only when the level actually changes.
+ *************************************************************************************/
+class AdaptiveQuality {
+
+	public:
+		AdaptiveQuality();
+		void moved();
+		bool update();
+		void full();
+		void   setMovingLevel(int level);
+		int    getMovingLevel() const         { return movingLevel; };
+		void   setStillDelay(double seconds)  { stillDelay = seconds; };
+		const QualityLevel &current() const;
+		static int nLevels();
+
+	private:
+		static double now();
+		bool apply(int level);
+
+		int    movingLevel;
+		double stillDelay;
+		double lastMove;
+		int    applied;     // level currently set in GL, -1 if none
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stddef.h>
+
+/**********************************************************************************//**
+ * \brief Bump allocator for the render buffers
+ * All buffers are carved out of a few large anonymous mappings, optionally backed by
+ * huge pages, and released together when the arena dies. Buffers which may grow get
+ * a mapping of their own instead, which is released when they do. Every allocation
+ * is named so the memory footprint can be reported per buffer.
+ *************************************************************************************/
+class Arena {
+
+	public:
+		Arena();
+		~Arena();
+		void   reserve(size_t bytes);
+		void   setHugePages(bool use) { hugePages = use; };
+		void   report(std::ostream &out) const;
+		size_t bytesUsed() const;
+		size_t bytesMapped() const;
+		static size_t peakRSS();
+
+		//! \brief count items, in their own mapping if they may grow() later
+		template<class T> T* alloc(const char *name, size_t count, bool growable = false) {
+			return (T*) allocBytes(name, count*sizeof(T), growable);
+		};
+		//! \brief moves the first used items of a growable buffer to one of count items
+		template<class T> T* grow(T *old, size_t used, size_t count) {
+			return (T*) growBytes(old, used*sizeof(T), count*sizeof(T));
+		};
+
+	private:
+		struct Block {
+			char  *base;
+			size_t size;
+			size_t used;
+		};
+		struct Record {
+			std::string name;
+			size_t      bytes;
+			void       *ptr;
+		};
+
+		void *allocBytes(const char *name, size_t bytes, bool growable);
+		void *growBytes(void *old, size_t used, size_t bytes);
+		Block mapBlock(size_t bytes);
+
+		std::vector<Block>  blocks;
+		std::vector<Block>  own;      // mappings of the growable buffers
+		std::vector<Record> records;
+		bool hugePages;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _ATTRIBUTE_H
+#define _ATTRIBUTE_H
+
+#include <string>
+#include <stddef.h>
+
+/**********************************************************************************//**
+ * \brief One value per element from an external binary file, mapped read-only
+ * The file is a raw array of native-endian float64 (or float32, detected from the file
+ * size) in the element order of getAllElements(), patch after patch. Values are read
+ * straight from the mapping; nothing is copied.
+ *************************************************************************************/
+class Attribute {
+
+	public:
+		Attribute();
+		~Attribute();
+		bool   open(const std::string &fileName, long nValues);
+		double value(long i) const {
+			return (isFloat) ? ((const float*) data)[i] : ((const double*) data)[i];
+		};
+		const std::string &getName() const { return name; };
+		long   size()  const { return n;    };
+		double min()   const { return lo;   };
+		double max()   const { return hi;   };
+		double mean()  const { return avg;  };
+		long   nanCount() const { return nNan; };
+
+	private:
+		void computeStats();
+
+		std::string name;
+		const void *data;
+		size_t      bytes;
+		long        n;
+		bool        isFloat;
+		double      lo, hi, avg;
+		long        nNan;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef _BRICK_STORE_H
+#define _BRICK_STORE_H
+
+#include <GL/glut.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class Camera;
+
+/**********************************************************************************//**
+ * \brief Out-of-core storage of the mesh as spatial bricks on disk
+ * The patches are written one at a time. Elements and meshrectangles of a patch are
+ * binned on a regular grid by their centers, in one pass counting them and one
+ * streaming them to their place in the file, and each brick is one contiguous block
+ * of boxes. An index of the bricks and patches follows the boxes, so the file can be
+ * opened again without the spline files as long as the key (naming the sources)
+ * matches. At runtime, update() ranks the bricks on visibility and camera distance,
+ * and the bricks that fit in the memory budget are read and tessellated to
+ * wireframes by a loader thread. Resident bricks which are no longer wanted are
+ * evicted least recently used first. The render thread never waits for the disk;
+ * bricks simply appear as they are ready.
+ *************************************************************************************/
+class BrickStore {
+
+	public:
+		// a patch, in scene coordinates
+		struct Domain {
+			double bbMin[3];
+			double bbMax[3];
+			double offset;    // z-translation of the patch in the scene
+			long   nEl;
+			long   nRect;
+		};
+		// calls back with the box (min xyz, max xyz) of every item
+		typedef std::function<void(const std::function<void(const double*)>&)> Items;
+
+		BrickStore();
+		~BrickStore();
+		bool   open(const std::string &fileName, const std::string &key);
+		bool   create(const std::string &fileName);
+		bool   addPatch(long nEl, const Items &elements, long nRect, const Items &rects,
+		                const double *bbMin, const double *bbMax, int itemsPerBrick);
+		bool   finish(const std::string &key, const std::vector<Domain> &patches);
+		const std::vector<Domain> &domains() const { return patches; };
+		void   setBudget(size_t bytes) { budget = bytes; };
+		void   update(Camera &cam);
+		void   draw(bool elements, bool rectangles);
+		int    size() const { return bricks.size(); };
+		int    residentCount() const;
+		size_t residentBytes() const { return resident; };
+
+	private:
+		// tessellated wireframe of one brick
+		struct Geometry {
+			std::vector<float>  coord;
+			std::vector<GLuint> elLines;
+			std::vector<GLuint> rectLines;
+		};
+		struct Brick {
+			double    bbMin[3];
+			double    bbMax[3];
+			long      offset;    // byte position in the brick file
+			double    zOffset;   // of the patch, added to the boxes when read
+			int       patch;
+			long      nEl;
+			long      nRect;
+			size_t    bytes;     // memory footprint when resident
+			bool      visible;
+			bool      requested;
+			long      lastUsed;  // frame number
+			Geometry *geometry;  // NULL unless resident
+		};
+
+		void      loaderLoop();
+		Geometry *load(const Brick &b);
+		void      stopLoader();
+		void      startLoader();
+
+		std::vector<Brick>  bricks;
+		std::vector<Domain> patches;
+		std::string fileName;
+		long   fileEnd;   // while creating
+		int    added;     // patches written so far
+		int    fd;
+		size_t budget;
+		size_t resident;
+		long   frame;
+
+		std::thread             loader;
+		std::mutex              lock;
+		std::condition_variable cond;
+		std::deque<int>         requests;   // bricks to load, most important first
+		std::vector<std::pair<int,Geometry*> > ready;
+		bool                    quit;
+};
+
+#endif
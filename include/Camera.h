@@ -16,14 +16,28 @@ class Camera  {
 		void setLookAt(float x, float y, float z);
 		void pan(float d_u, float d_v);
 		void setModelView();
+		static void setLights();
+		static void getLights(GLfloat *ambient, GLfloat *position, GLfloat *diffuse);
+		//! \brief the matrices of the last setProjection() and setModelView(), column major
+		const GLdouble *getProjection() const { return projection; };
+		const GLdouble *getModelView()  const { return modelView;  };
 		void setProjection();
 		void handleResize(int x, int y, int w, int h);
+		void setViewport();
+		void setTile(int x, int y, int w, int h);
+		bool contains(int x, int y, int windowHeight) const;
+		void setOrthographic(int axis);
+		int  getOrthographic() const { return ortho_axis; };
+		void translate(float dx, float dy, float dz);
+		void updateFrustum();
+		bool boxInFrustum(const double *min, const double *max) const;
 		GLfloat getR()        { return r;     };
 		GLfloat getPhi()      { return phi;   };
 		GLfloat getTheta()    { return theta; };
 		Go::Point getLookAt() { return Go::Point(look_at_x, look_at_y, look_at_z); };
 		Go::Point getPos()    { return Go::Point(x,y,z); };
 		virtual void processMouse(int button, int state, int x, int y);
+		virtual void processMouse(int button, int state, int x, int y, int modifiers);
 		virtual void processMouseActiveMotion(int x, int y);
 		virtual void processMousePassiveMotion(int x, int y);
 
@@ -53,13 +67,20 @@ class Camera  {
 		int last_mouse_y;
 		bool just_warped;
 
+		int vp_x;
+		int vp_y;
 		int vp_width;
 		int vp_height;
+		int ortho_axis;  // viewing direction of an orthographic camera, -1 for perspective
+		int tile[4];     // part of the viewport drawn when rendering tiles (x,y,w,h), w=0 if not
 		
 		int specialKey;
 		bool right_mouse_button_down;
 
 		double size;
+		double frustum[6][4];
+		GLdouble projection[16];
+		GLdouble modelView[16];
 		bool upside_down;
 		bool adaptive_tesselation;
 };
@@ -0,0 +1,42 @@
+#ifndef _DENSITY_MAP_H
+#define _DENSITY_MAP_H
+
+#include <vector>
+#include <stddef.h>
+
+/**********************************************************************************//**
+ * \brief The elements projected along one parametric axis onto a 2D grid
+ * Cell (i,j) covers the domain along axis u = (axis+1)%3 and v = (axis+2)%3. In COUNT
+ * mode it holds the number of elements whose center projects into it, so the map
+ * sums to the element count however fine the elements are. In DEPTH mode it holds
+ * the mean refinement level of the elements pierced by the line through the cell
+ * center, where the level of an element is log2(domain size / element size) averaged
+ * over the three axes. Counts are binned, and the depths are spread with 2D
+ * difference arrays, one grid per thread, and then summed up; both are O(n) in the
+ * elements plus O(res^2) per thread.
+ *************************************************************************************/
+class DensityMap {
+
+	public:
+		enum Mode { COUNT, DEPTH };
+
+		DensityMap();
+		void build(const double *box, long nElements, const char *skip, int axis, Mode mode,
+		           const double *domainMin, const double *domainMax, int resolution);
+		int    size() const             { return res;                          };
+		int    getAxis() const          { return axis;                         };
+		Mode   getMode() const          { return mode;                         };
+		double value(int i, int j) const { return grid[(size_t) j*res + i];    };
+		double min() const              { return minValue;                     };
+		double max() const              { return maxValue;                     };
+
+	private:
+		std::vector<double> grid;   // res x res values, i fastest
+		int    res;
+		int    axis;
+		Mode   mode;
+		double minValue;
+		double maxValue;
+};
+
+#endif
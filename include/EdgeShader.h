@@ -0,0 +1,36 @@
+#ifndef _EDGE_SHADER_H
+#define _EDGE_SHADER_H
+
+#include <GL/glut.h>
+#include <functional>
+
+GLuint buildProgram(const char *name, const char *vertexSource, const char *fragmentSource,
+                    const std::function<void(GLuint)> &bind = std::function<void(GLuint)>());
+
+/**********************************************************************************//**
+ * \brief Draws quads together with their outlines in a single pass
+ * Every vertex carries the corner it is of its box as a texture coordinate, 0 or 1
+ * along each axis. Across a face one of these is constant and the other two run from
+ * 0 to 1, so the fragment shader finds its distance to the nearest edge in pixels
+ * from the screen space derivatives, and blends in the edge color within half the
+ * line width. Lighting follows the fixed function setup of the viewer (ambient and
+ * diffuse from GL_LIGHT0 and GL_LIGHT1, color material), so faces look the same with
+ * and without the shader.
+ *************************************************************************************/
+class EdgeShader {
+
+	public:
+		EdgeShader();
+		bool init();
+		bool ready() const   { return program != 0; };
+		GLuint id() const    { return program;      };
+		void setUniforms(bool lighting, const GLfloat *edgeRgb, GLfloat edgeWidth);
+
+	private:
+		GLuint program;
+		GLint  lightingLoc;
+		GLint  colorLoc;
+		GLint  widthLoc;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _FACE_ADJACENCY_H
+#define _FACE_ADJACENCY_H
+
+#include <vector>
+
+/**********************************************************************************//**
+ * \brief Which element faces touch which across shared face planes
+ * Faces are numbered 6*element + 2*axis + side, where side 0 is the face at the lower
+ * parameter value and side 1 the one at the upper value. Two faces are adjacent if
+ * they lie in the same plane on opposite sides and overlap with positive area, so a
+ * large face at a T-junction is adjacent to all the smaller hanging faces across from
+ * it. The graph is built by sorting the faces on their plane and sweeping each plane,
+ * O(n log n) for a valid mesh. Face numbers pass 2^31 at 358M elements, so they are
+ * long throughout.
+ *************************************************************************************/
+class FaceAdjacency {
+
+	public:
+		FaceAdjacency();
+		void build(const double *box, long nElements);
+		void exposedFaces(const std::vector<long> &elements, const std::vector<char> &inSet,
+		                  std::vector<long> &faces) const;
+		double faceArea(long face) const;
+		double overlapArea(long faceA, long faceB) const;
+		long size() const                       { return n;                                  };
+		int  neighbourCount(long face) const    { return offset[face+1] - offset[face];      };
+		const long *neighbours(long face) const { return (adj.empty()) ? 0 : &adj[offset[face]]; };
+
+	private:
+		void sweepAxis(int d, std::vector<long> &pairs) const;
+
+		const double     *box;     // element boxes (min xyz, max xyz)
+		long              n;
+		std::vector<long> offset;  // neighbours of face i are adj[offset[i]] ... adj[offset[i+1]-1]
+		std::vector<long> adj;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _FRAME_CAPTURE_H
+#define _FRAME_CAPTURE_H
+
+#include <GL/glut.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**********************************************************************************//**
+ * \brief Records rendered frames to disk without stalling the render loop
+ * Every frame is read back into one of a ring of pixel buffer objects. The buffer is
+ * only mapped a few frames later, when the transfer has completed, and the pixels are
+ * handed to a writer thread which encodes them as PNG/PPM images or appends them to a
+ * raw rgb24 video stream. Frames are never dropped: if the writer falls behind, the
+ * render loop waits, and since animation time is taken from the frame counter
+ * (time()) rather than the wall clock, the recording is still frame exact.
+ *************************************************************************************/
+class FrameCapture {
+
+	public:
+		FrameCapture();
+		~FrameCapture();
+		bool   start(const std::string &target, int width, int height, double fps);
+		void   capture();
+		void   stop();
+		bool   active() const { return running;           };
+		long   frames() const { return frameCount;        };
+		double time()   const { return frameCount / fps;  };
+		int    frameWidth()  const { return width;  };
+		int    frameHeight() const { return height; };
+
+	private:
+		struct Frame {
+			long index;
+			std::vector<unsigned char> pixels;
+		};
+
+		void collect(int slot);
+		void writerLoop();
+		void write(Frame *f);
+		bool writePNG(const char *fileName, Frame *f);
+		bool writePPM(const char *fileName, Frame *f);
+
+		static const int ringSize  = 3;
+		static const int maxQueued = 8;
+
+		GLuint pbo[ringSize];
+		long   pboFrame[ringSize];  // frame index held by each pbo, -1 if empty
+		int    head;
+		long   frameCount;
+		int    width;
+		int    height;
+		double fps;
+		bool   running;
+
+		std::string pattern;  // printf-style image name, or a raw stream if it has no '%'
+		FILE  *raw;
+
+		std::thread             writer;
+		std::mutex              lock;
+		std::condition_variable cond;
+		std::deque<Frame*>      queue;
+		bool                    done;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _INTERVAL_TREE_H
+#define _INTERVAL_TREE_H
+
+#include <vector>
+
+/**********************************************************************************//**
+ * \brief Static centered interval tree over closed intervals [lo,hi]
+ * Built once in O(n log n), answers overlap queries against a point or a range in
+ * O(log n + k). Every interval is identified by its index in the build arrays.
+ *************************************************************************************/
+class IntervalTree {
+
+	public:
+		IntervalTree();
+		void build(const std::vector<double> &lo, const std::vector<double> &hi);
+		void query(double a, double b, std::vector<long> &result) const;
+		void stab(double x, std::vector<long> &result) const { query(x, x, result); };
+		long size() const { return n; };
+		void clear();
+
+	private:
+		struct Node {
+			double center;
+			long begin;  // first entry in byLo/byHi owned by this node
+			long count;  // number of intervals containing center
+			long left;
+			long right;
+		};
+		struct Entry {
+			double val;
+			long id;
+		};
+
+		long build(std::vector<long> &ids, const std::vector<double> &lo, const std::vector<double> &hi);
+		void query(long node, double a, double b, std::vector<long> &result) const;
+
+		std::vector<Node>  nodes;
+		std::vector<Entry> byLo;  // intervals per node sorted on ascending lower bound
+		std::vector<Entry> byHi;  // intervals per node sorted on descending upper bound
+		long n;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _MESH_CHECK_H
+#define _MESH_CHECK_H
+
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <stddef.h>
+
+/**********************************************************************************//**
+ * \brief Validates a mesh of element boxes and meshrectangles against its patch domains
+ * Every face of an element lies in a plane normal to one of the axes. Along a line
+ * through a valid mesh exactly one element starts where another one ends, so in every
+ * such plane the faces of the elements starting there cover the same area as those
+ * of the elements ending there, with the patch domains counted as outside elements.
+ * Any overlap or gap breaks this on one of its sides. The faces are sorted by plane,
+ * and every plane is swept along one direction with a segment tree over the other,
+ * which finds the mismatched area and the meshrectangles that are not on element
+ * faces. This is O(n log n), and the three axes are checked in parallel. Elements at
+ * a mismatch are then tested for overlaps against all elements, in a PointLocator.
+ *************************************************************************************/
+class MeshCheck {
+
+	public:
+		MeshCheck();
+		void run(const double *elBox, long nElements, const char *elSkip,
+		         const double *rectBox, long nRect, const char *rectSkip,
+		         const std::vector<double> &domains);
+		bool valid() const { return mismatched.empty() && dangling.empty(); };
+		void report(std::ostream &out, const long *elId = NULL, const long *rectId = NULL) const;
+
+		std::vector<long>                     mismatched;  // elements at a mismatched face
+		std::vector<std::pair<long, long> >   overlaps;    // overlapping element pairs
+		std::vector<long>                     dangling;    // meshrectangles not on element faces
+		double mismatchArea[3];   // per plane normal
+		double danglingArea[3];
+		double elementVolume;
+		double domainVolume;
+		double overlapVolume;     // pairwise, so triple overlaps count more than once
+		double uncoveredVolume;   // negative if elements stick out of the domain
+		double seconds;
+
+	private:
+		void checkAxis(int axis, std::vector<long> &badElements, std::vector<long> &badRects);
+
+		const double *elBox;
+		const char   *elSkip;
+		long          nEl;
+		const double *rectBox;
+		const char   *rectSkip;
+		long          nRect;
+		const double *domain;
+		long          nDomain;
+};
+
+#endif
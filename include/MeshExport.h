@@ -0,0 +1,63 @@
+#ifndef _MESH_EXPORT_H
+#define _MESH_EXPORT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+class Attribute;
+
+//! \brief the tessellated scene, as read by MeshExport straight from the render buffers
+struct ExportScene {
+	long          nEl;
+	long          nRect;
+	const double *elBox;        // element boxes (min xyz, max xyz)
+	const double *rectCoord;    // 4 corners per meshrectangle
+	const double *rectColor;    // rgba per corner
+	const char   *boundary;     // 1 for elements with a face on the solid shell
+	std::function<const double*(long)> elColor;  // rgba of element e
+	std::vector<const Attribute*>      attributes;
+};
+
+/**********************************************************************************//**
+ * \brief Writes the elements and meshrectangles as binary VTU or PLY
+ * Elements become hexahedra and meshrectangles quads. Per item the constDirection
+ * (-1 for elements), the boundary flag, the color and every attribute are written
+ * (attributes are NaN on meshrectangles). The output is generated item by item into
+ * a fixed-size buffer which is flushed whenever it fills up, so nothing of the size
+ * of the mesh is ever held besides the render buffers themselves.
+ *************************************************************************************/
+class MeshExport {
+
+	public:
+		MeshExport(const ExportScene &scene);
+		~MeshExport();
+		bool write(const std::string &fileName);
+
+	private:
+		void writeVTU();
+		void writePLY();
+		int  direction(long rect) const;
+		void elementCorner(long e, int corner, double *p) const;
+		void rectColorBytes(long rect, unsigned char *rgb) const;
+		void elementColorBytes(long e, unsigned char *rgb) const;
+
+		template<class T> void put(T value) {
+			if(used + sizeof(T) > buffer.size())
+				flush();
+			memcpy(&buffer[used], &value, sizeof(T));
+			used += sizeof(T);
+		};
+		void putText(const std::string &text);
+		void flush();
+
+		const ExportScene &scene;
+		FILE             *file;
+		std::vector<char> buffer;
+		size_t            used;
+		bool              failed;
+};
+
+#endif
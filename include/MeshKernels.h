@@ -0,0 +1,73 @@
+#ifndef _MESH_KERNELS_H
+#define _MESH_KERNELS_H
+
+#include <GL/glut.h>
+#include <vector>
+#include <functional>
+#include "Rect.h"
+
+class Camera;
+
+/**********************************************************************************//**
+ * \brief Where the vertices of every element are in the render buffers
+ * Elements are stored in chunks of chunkElements. All vertices of a chunk (the three
+ * normal sets) are contiguous and the element indices count from the start of their
+ * chunk, so they stay 32 bit for any mesh size.
+ *************************************************************************************/
+struct ElementLayout {
+	static const long chunkElements = 1<<16;
+
+	long nEl;
+
+	static long chunkOf(long e) { return e / chunkElements; };
+	GLuint localVertex(long e, int s, int c) const;
+	size_t globalVertex(long e, int s, int c) const;
+};
+
+//! \brief the element render buffers, sized for layout.nEl elements
+struct ElementBuffers {
+	ElementLayout layout;
+	double *coord;    // corners sorted for viewing from the inside (showInner)
+	double *coord2;   // ... and from the outside
+	double *normal;
+	double *color;
+	GLuint *lines;
+	GLuint *faces;
+};
+
+//! \brief how the blinking faces fade in and out
+struct BlinkParams {
+	double lifeLength;
+	double sigma;
+	double minAlpha;
+	double maxAlpha;
+};
+
+/*
+ * The CPU work of the viewer, free of GLUT and the viewer state so that it can be
+ * run and timed without a display (see bench/)
+ */
+
+// tessellation
+void tessellateElement(const ElementBuffers &b, long e, const double *box, const double *rgb, double alpha);
+void writeElementIndices(const ElementBuffers &b, long e);
+
+// blinking faces
+void pushElementFaces(const ElementLayout &layout, long e, double *coord, double midTime,
+                      std::vector<Rect> &out);
+void pushRectFace(long i, double *coord, double midTime, std::vector<Rect> &out);
+int  spawnElementBlinks(const ElementLayout &layout, long nEl, int count, std::vector<bool> &showing,
+                        const std::function<bool(long)> &accept, double *coord, double midTime,
+                        std::vector<Rect> &out);
+int  spawnRectBlinks(long nRect, int count, std::vector<bool> &showing,
+                     const std::function<bool(long)> &accept, double *coord, double midTime,
+                     std::vector<Rect> &out);
+void fadeBlinks(std::vector<Rect> &faces, std::vector<bool> &showing, double *color,
+                double mtime, const BlinkParams &params);
+void sortFaces(std::vector<Rect> &faces, Camera &cam);
+void gatherFaces(const std::vector<Rect> &faces, long first, long last, const double *coord,
+                 const double *normal, const double *color, std::vector<double> &outCoord,
+                 std::vector<double> &outNormal, std::vector<double> &outColor);
+void gatherFaceIndices(const std::vector<Rect> &faces, long first, long last, std::vector<GLuint> &out);
+
+#endif
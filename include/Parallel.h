@@ -0,0 +1,38 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <algorithm>
+#include "TaskPool.h"
+
+/**********************************************************************************//**
+ * \brief runs body(chunkBegin, chunkEnd) over [begin,end) split on the shared task pool
+ * The calling thread runs the first chunk and helps with the rest, so nested calls
+ * (from inside a task) are fine.
+ * \param begin first index
+ * \param end one past the last index
+ * \param body callable taking an index range. Ranges are disjoint and may run concurrently
+ * \param grain smallest range worth a task of its own
+ *************************************************************************************/
+template<class Body>
+void parallelFor(long begin, long end, Body body, long grain = 4096) {
+	long n       = end - begin;
+	TaskPool &pool = TaskPool::shared();
+	long threads = pool.threads();
+	if(n < 2*grain || threads == 1) {
+		if(n > 0)
+			body(begin, end);
+		return;
+	}
+	// a few chunks per thread, so that threads busy elsewhere do not hold up the rest
+	long chunks = std::min(4*threads, n / grain);
+	TaskGroup group(pool);
+	for(long t=1; t<chunks; t++) {
+		long a = begin + n* t   /chunks;
+		long b = begin + n*(t+1)/chunks;
+		group.run([&body, a, b]() { body(a, b); });
+	}
+	body(begin, begin + n/chunks);
+	group.wait();
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _POINT_LOCATOR_H
+#define _POINT_LOCATOR_H
+
+#include <vector>
+#include <stddef.h>
+
+/**********************************************************************************//**
+ * \brief Finds the element containing a point, by a bounding volume hierarchy over
+ *        the element boxes
+ * The tree is built top down, splitting the elements at the median center along the
+ * longest side of each node, O(n log n). Elements are half open boxes [min, max),
+ * except at the upper end of their patch domain, so every point of a valid mesh is
+ * in exactly one element. A query visits O(log n) nodes for a valid mesh, and batches
+ * of queries are run in parallel. Points with NaN or infinite coordinates are in none.
+ *************************************************************************************/
+class PointLocator {
+
+	public:
+		PointLocator();
+		void build(const double *box, long nElements, const char *skip = NULL,
+		           const std::vector<double> &domains = std::vector<double>());
+		long locate(const double *point) const;
+		void locate(const double *points, long nPoints, long *elements) const;
+		void overlapping(const double *box, std::vector<long> &elements) const;
+		long size() const { return n; };
+
+	private:
+		struct Node {
+			double lo[3];
+			double hi[3];
+			long   first;   // items of a leaf
+			long   count;   // 0 for inner nodes
+			long   right;   // second child of an inner node, the first one follows it
+		};
+		long buildNode(long first, long last);
+		bool contains(long element, const double *point) const;
+
+		const double     *box;
+		long              n;
+		double            top[3];   // upper end of the domain, where boxes are closed
+		std::vector<char> closed;   // per element, bit d if it is closed along d (with domains)
+		std::vector<Node> nodes;
+		std::vector<long> items;    // elements in leaf order
+		std::vector<double> center; // box centers, while building
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _POSTER_H
+#define _POSTER_H
+
+#include <GL/glut.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+/**********************************************************************************//**
+ * \brief Renders images larger than any framebuffer, one tile at a time
+ * The image is cut into tiles no larger than an offscreen renderbuffer may be. Each
+ * tile is drawn by a callback which is told the pixel rectangle of the tile within
+ * the full image, and is expected to set up a sub-frustum for it (see
+ * Camera::setTile()). Tiles are drawn one row at a time and the scanlines of a row
+ * are written out before the next one is started, so memory holds at most one row
+ * of tiles. The output is PNG if the name ends in .png (when compiled with libpng)
+ * and binary PPM otherwise.
+ *************************************************************************************/
+class Poster {
+
+	public:
+		typedef std::function<void(int x, int y, int width, int height)> DrawTile;
+
+		Poster();
+		~Poster();
+		void setTileSize(int size) { tileSize = size; };
+		bool render(const std::string &fileName, int width, int height, DrawTile drawTile);
+
+	private:
+		bool bindTarget();
+		bool openOutput(const std::string &fileName, int width, int height);
+		bool writeRows(const unsigned char *rgb, int count);
+		bool closeOutput();
+
+		GLuint fbo;
+		GLuint color;
+		GLuint depth;
+		int    tileSize;
+		int    width;
+		FILE  *file;
+		void  *png;    // png_structp when writing PNG
+		void  *info;   // png_infop
+};
+
+#endif
@@ -1,20 +1,19 @@
 #ifndef _RECT_H
 #define _RECT_H
 
-class Camera;
+#include <stddef.h>
 
+//! \brief one quad of a blinking item, see sortFaces() for their back to front order
 class Rect {
 	public:
 		double* coords;
-		int i[4];
-		int initI;
+		size_t i[4];
+		long initI;
 		double midTime;
-		Camera *cam;
 		
 		Rect(const Rect &other);
-		Rect(int *ind, double *coords, Camera *cam);
+		Rect(const size_t *ind, double *coords);
 
-		bool operator<(const Rect &other) const;
 		Rect & operator=(const Rect &other) ;
 };
 
@@ -0,0 +1,78 @@
+#ifndef _REMOTE_VIEW_H
+#define _REMOTE_VIEW_H
+
+#include <GL/glut.h>
+#include <string>
+#include <vector>
+
+//! \brief user input forwarded from the client to the server
+struct RemoteEvent {
+	enum Type {
+		KEY,      // a = key,    b,c = x,y
+		MOUSE,    // a = button, b = state, c,d = x,y, e = modifiers
+		MOTION,   // c,d = x,y  (with a button down)
+		PASSIVE,  // c,d = x,y
+		RESIZE    // a,b = width,height
+	};
+	int type;
+	int a, b, c, d, e;
+};
+
+/**********************************************************************************//**
+ * \brief Renders offscreen and streams the frames to one connected client
+ * Rendering goes to a framebuffer object of the client's window size, so the server
+ * window may be hidden (any X display will do, i.e. Xvfb on a compute node). Each
+ * frame is read back, XORed with the previous one and compressed (zlib if available,
+ * run-length otherwise), so a still image costs next to nothing on the wire. Events
+ * coming back are queued for the render loop. All calls are made from the GL thread.
+ *************************************************************************************/
+class FrameServer {
+
+	public:
+		FrameServer();
+		~FrameServer();
+		bool listen(int port, const std::string &address = "127.0.0.1");
+		bool poll();
+		bool connected() const { return client >= 0; };
+		void bindTarget(int width, int height);
+		void sendFrame();
+		bool nextEvent(RemoteEvent &ev);
+
+	private:
+		void disconnect();
+
+		int    server;
+		int    client;
+		GLuint fbo;
+		GLuint color;
+		GLuint depth;
+		int    width;
+		int    height;
+		std::vector<unsigned char> pixels;
+		std::vector<unsigned char> previous;
+		std::vector<unsigned char> packet;
+		std::vector<unsigned char> input;   // partially received events
+};
+
+/**********************************************************************************//**
+ * \brief The thin client: receives frames and sends events back
+ * receiveFrame() blocks and is meant for a network thread, sendEvent() may be called
+ * from the GLUT callbacks at the same time.
+ *************************************************************************************/
+class FrameClient {
+
+	public:
+		FrameClient();
+		~FrameClient();
+		bool connect(const std::string &host, int port);
+		bool receiveFrame(std::vector<unsigned char> &rgb, int &width, int &height);
+		void sendEvent(const RemoteEvent &ev);
+		void shutdown();
+
+	private:
+		int socket;
+		std::vector<unsigned char> packet;
+		std::vector<unsigned char> delta;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef _RENDER_BACKEND_H
+#define _RENDER_BACKEND_H
+
+#include "RenderPass.h"
+#include "EdgeShader.h"
+#include <GL/glut.h>
+#include <map>
+#include <string>
+#include <ostream>
+
+/**********************************************************************************//**
+ * \brief Sends the passes of a RenderQueue to OpenGL
+ * The passes describe what to draw (arrays, flat color, lighting, outlines) and the
+ * backend decides how. The draw callbacks of the passes only issue draw calls, and
+ * go through bindArrays() when they need to move the vertex arrays (for element
+ * chunks), and put them back when done. Camera still sets up the matrices and
+ * lights, and hands them to setView() and setLights() for backends doing their own
+ * transformation and lighting. The background and domain box stay in immediate mode
+ * outside the passes.
+ *************************************************************************************/
+class RenderBackend {
+
+	public:
+		virtual ~RenderBackend() {};
+		virtual const char *name() const = 0;
+		//! \brief prepares the backend, needs a current context. false if it can not run
+		virtual bool init() = 0;
+		//! \brief prepares drawing faces with outlines. false if not supported
+		virtual bool initOutlines() = 0;
+		virtual bool hasOutlines() const = 0;
+		//! \brief the camera matrices of the passes that follow, column major
+		virtual void setView(const GLdouble *modelView, const GLdouble *projection) {};
+		//! \brief the lighting conditions, see Camera::getLights()
+		virtual void setLights(const GLfloat *ambient, const GLfloat *position, const GLfloat *diffuse) {};
+		virtual void beginFrame() = 0;
+		virtual void setPass(const RenderPass &p, GLfloat lineScale) = 0;
+		virtual void bindArrays(const GLvoid *vertex, const GLvoid *normal, const GLvoid *color = NULL) = 0;
+		//! \brief leaves GL to the fixed function code again
+		virtual void endFrame() = 0;
+		//! \brief keeps a copy of a large client array in GPU memory, again if it changed.
+		//!        false if there is no room for it, and the client array is drawn instead
+		virtual bool keepArray(const GLvoid *data, size_t bytes) { return true; };
+		//! \brief copies bytes from offset of an array given to keepArray() to its GPU copy
+		virtual void updateArray(const GLvoid *data, size_t offset, size_t bytes) {};
+		//! \brief drops the GPU copies of all arrays
+		virtual void releaseArrays() {};
+		virtual void report(std::ostream &out) const {};
+
+		static RenderBackend *create(const std::string &name);
+};
+
+/**********************************************************************************//**
+ * \brief The fixed function path: client arrays, GL lighting and the StateCache,
+ *        with the EdgeShader for outlined faces
+ *************************************************************************************/
+class LegacyBackend : public RenderBackend {
+
+	public:
+		const char *name() const       { return "legacy";        };
+		bool init()                    { return true;            };
+		bool initOutlines()            { return edges.init();    };
+		bool hasOutlines() const       { return edges.ready();   };
+		void beginFrame();
+		void setPass(const RenderPass &p, GLfloat lineScale);
+		void bindArrays(const GLvoid *vertex, const GLvoid *normal, const GLvoid *color = NULL);
+		void endFrame();
+		void report(std::ostream &out) const;
+
+	private:
+		StateCache state;
+		EdgeShader edges;
+};
+
+/**********************************************************************************//**
+ * \brief The programmable path: buffer objects, generic vertex attributes and one
+ *        shader program doing lighting and outlines
+ * Arrays handed to keepArray() live in buffer objects and any pointer into them is
+ * drawn from there. Other arrays (the small per-frame ones) are read from client
+ * memory. The matrices and lights come from Camera, so the scene looks the same as
+ * with the legacy backend. This runs in the compatibility context of the rest of the
+ * viewer (GLSL 1.30, quads and client index arrays), it is not a core profile path.
+ *************************************************************************************/
+class ShaderBackend : public RenderBackend {
+
+	public:
+		ShaderBackend();
+		const char *name() const       { return "shader";        };
+		bool init();
+		bool initOutlines()            { return program != 0;    };
+		bool hasOutlines() const       { return program != 0;    };
+		void setView(const GLdouble *modelView, const GLdouble *projection);
+		void setLights(const GLfloat *ambient, const GLfloat *position, const GLfloat *diffuse);
+		void beginFrame();
+		void setPass(const RenderPass &p, GLfloat lineScale);
+		void bindArrays(const GLvoid *vertex, const GLvoid *normal, const GLvoid *color = NULL);
+		void endFrame();
+		bool keepArray(const GLvoid *data, size_t bytes);
+		void updateArray(const GLvoid *data, size_t offset, size_t bytes);
+		void releaseArrays();
+		void report(std::ostream &out) const;
+
+	private:
+		struct Buffer {
+			GLuint id;
+			size_t bytes;
+		};
+		void attribute(GLuint index, GLint size, GLenum type, const GLvoid *data);
+
+		StateCache state;
+		GLuint program;
+		GLfloat modelView[16], projection[16];
+		GLfloat ambient[4], lightPosition[8], lightDiffuse[8];
+		std::map<const char*, Buffer> buffers;   // by first byte of the client array
+		size_t bufferBytes;
+		GLint  mvpLoc, modelViewLoc, normalMatrixLoc, lightingLoc, colorArrayLoc, flatColorLoc;
+		GLint  ambientLoc, lightPositionLoc, lightDiffuseLoc;
+		GLint  outlineLoc, edgeColorLoc, edgeWidthLoc;
+};
+
+#endif
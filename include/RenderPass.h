@@ -0,0 +1,111 @@
+#ifndef _RENDER_PASS_H
+#define _RENDER_PASS_H
+
+#include <GL/glut.h>
+#include <vector>
+#include <map>
+#include <functional>
+
+class RenderBackend;
+
+/**********************************************************************************//**
+ * \brief Shadow copy of the GL state touched by the render passes
+ * Every setter compares against the last value it issued and skips the GL call if
+ * nothing changes. Call invalidate() whenever GL state has been changed behind its
+ * back, after which the next setter of every kind is issued again.
+ *************************************************************************************/
+class StateCache {
+
+	public:
+		StateCache();
+		void invalidate();
+		void enable(GLenum cap, bool on);
+		void clientState(GLenum array, bool on);
+		void vertexPointer(const GLvoid *coord);
+		void normalPointer(const GLvoid *normal);
+		void colorPointer(const GLvoid *color);
+		void texCoordPointer(const GLvoid *coord);
+		void useProgram(GLuint program);
+		void lineWidth(GLfloat width);
+		void attribArray(GLuint index, bool on);
+		void attribPointer(GLuint index, GLint size, GLenum type, GLuint buffer, const GLvoid *data);
+		void uniform(GLint location, GLint value);
+		void uniform(GLint location, int n, const GLfloat *value);
+		long issued()  const { return nIssued;  };
+		long skipped() const { return nSkipped; };
+
+	private:
+		bool changed(bool same);
+
+		struct Attrib {
+			GLuint        buffer;
+			const GLvoid *data;
+		};
+
+		std::map<GLenum,bool> caps;
+		std::map<GLenum,bool> arrays;
+		std::map<GLuint,bool> attribs;
+		std::map<GLuint,Attrib> pointers;            // generic attribute arrays, by index
+		std::map<GLint,std::vector<GLfloat> > uniforms;  // of the program in use, by location
+		GLint         arrayBuffer;  // -1 when unknown
+		const GLvoid *vertex;
+		const GLvoid *normal;
+		const GLvoid *color;
+		const GLvoid *texCoord;
+		GLint         program;    // -1 when unknown
+		GLfloat       width;
+		long nIssued;
+		long nSkipped;
+};
+
+/**********************************************************************************//**
+ * \brief One draw call (or a few) together with the GL state it needs
+ * All arrays are tightly packed doubles, with 4 color components. Without a color
+ * array the pass is drawn in the flat color rgb, and without blending the alpha of
+ * the color array is ignored. A lineWidth of zero leaves the line
+ * width alone. Faces with an edge array are drawn with their outlines, if the
+ * backend can (see EdgeShader), pushed back by a polygon offset so that lines drawn on
+ * top of them still win the depth test.
+ *************************************************************************************/
+struct RenderPass {
+	RenderPass(const char *name, int phase, const GLvoid *vertex);
+
+	const char   *name;
+	int           phase;       // passes are only reordered within their phase
+	bool          clearDepth;  // clear the depth buffer before this pass
+	bool          lighting;
+	bool          depthTest;
+	bool          blend;       // GL_BLEND, on unless the pass is opaque
+	const GLvoid *vertex;
+	const GLvoid *normal;      // NULL disables the normal array
+	const GLvoid *color;       // NULL disables the color array
+	const GLvoid *edge;        // box corner of every vertex (3 GLshort), NULL for no outline
+	GLfloat       rgb[3];
+	GLfloat       edgeRgb[3];
+	GLfloat       lineWidth;   // also the width of the outline
+	std::function<void()> draw;
+};
+
+/**********************************************************************************//**
+ * \brief The passes making up a frame
+ * Passes are drawn phase by phase. Within a phase they commute, and are sorted on
+ * their state so that passes sharing lighting, client arrays and vertex data follow
+ * each other and the backend only has to send the differences to GL.
+ *************************************************************************************/
+class RenderQueue {
+
+	public:
+		RenderQueue() { lineScale = 1.0f; maxLineWidth = 0.0f; };
+		void clear() { passes.clear(); };
+		void add(const RenderPass &pass) { passes.push_back(pass); };
+		void setLineScale(GLfloat scale) { lineScale = scale; };
+		void setMaxLineWidth(GLfloat width) { maxLineWidth = width; };
+		void execute(RenderBackend &backend);
+
+	private:
+		std::vector<RenderPass> passes;
+		GLfloat                 lineScale;  // applied to the line width of every pass
+		GLfloat                 maxLineWidth;  // scaled widths are clamped to this, 0 for no limit
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _SLOT_MAP_H
+#define _SLOT_MAP_H
+
+#include <vector>
+#include <unordered_map>
+
+/**********************************************************************************//**
+ * \brief Stable buffer slots for items which come and go between updates
+ * Items are identified by a key (their address in the LR spline), and keep their slot
+ * for as long as they exist. Slots of items which are gone are handed out again to
+ * new items before the slot range is extended, so the buffers only grow when the
+ * number of live items does.
+ *************************************************************************************/
+class SlotMap {
+
+	public:
+		SlotMap();
+		void assign(const std::vector<const void*> &keys);
+		void update(const std::vector<const void*> &keys, std::vector<long> &added,
+		            std::vector<long> &freed);
+		long slot(long item) const      { return slotOf[item];                  };
+		const std::vector<long> &slots() const { return slotOf;                 };
+		long size() const               { return nSlots;                        };
+		long live() const               { return slotOf.size();                 };
+		bool isFree(long s) const       { return s >= nSlots || freeSlot[s];    };
+
+	private:
+		std::unordered_map<const void*, long> byKey;   // live item -> slot
+		std::vector<long> slotOf;      // slot of the items, in the order of the last update
+		std::vector<long> freeList;
+		std::vector<char> freeSlot;
+		long nSlots;
+};
+
+#endif
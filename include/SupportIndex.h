@@ -0,0 +1,40 @@
+#ifndef _SUPPORT_INDEX_H
+#define _SUPPORT_INDEX_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace LR {
+	class LRSplineVolume;
+}
+
+/**********************************************************************************//**
+ * \brief Compressed (CSR) incidence between basis functions and elements
+ * Elements and basis functions are numbered consecutively over all patches, in the
+ * order of getAllElements() and by getId() respectively. Both directions are stored
+ * so the support of a basis function and the functions active on an element are
+ * direct lookups. Elements may instead be numbered by their buffer slot, in which
+ * case unused slots have no basis functions.
+ *************************************************************************************/
+class SupportIndex {
+
+	public:
+		SupportIndex();
+		void build(const std::vector<LR::LRSplineVolume*> &patches,
+		           const std::vector<long> *slots = NULL, long nSlots = 0);
+		int  nBasis()    const { return basisOffset.size() - 1; };
+		long nElements() const { return elOffset.size() - 1;    };
+		long nPairs()    const { return elBasis.size();         };
+		long supportSize(int basis) const     { return basisOffset[basis+1] - basisOffset[basis]; };
+		int  activeCount(long element) const  { return elOffset[element+1] - elOffset[element];   };
+		const long *support(int basis) const  { return &basisEl[basisOffset[basis]];  };
+		const int  *active(long element) const { return &elBasis[elOffset[element]];  };
+
+	private:
+		std::vector<long> elOffset;     // element -> basis functions
+		std::vector<int>  elBasis;
+		std::vector<long> basisOffset;  // basis function -> elements
+		std::vector<long> basisEl;
+};
+
+#endif
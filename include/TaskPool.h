@@ -0,0 +1,116 @@
+#ifndef _TASK_POOL_H
+#define _TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+
+class TaskGroup;
+
+/**********************************************************************************//**
+ * \brief The one set of worker threads shared by every parallel stage of the viewer
+ * Each worker has its own task deque. Tasks spawned on a worker go on its own deque
+ * and are taken from the back (most recent first), idle workers steal from the front
+ * of the others. Tasks spawned from other threads (the loader, the render loop) go
+ * on a separate injection deque. A thread waiting for a TaskGroup helps run tasks
+ * instead of blocking; threads outside the pool only help with tasks of the group
+ * they wait for, so the render loop is never caught up in a long loading task.
+ * Concurrency is threads(): threads()-1 workers plus the waiting thread.
+ *************************************************************************************/
+class TaskPool {
+
+	public:
+		typedef std::function<void()> Task;
+
+		static TaskPool &shared();
+
+		~TaskPool();
+		void setThreads(int threads);
+		int  threads() const { return nThreads; };
+
+		void submit(const Task &task, TaskGroup *group);
+		void wait(TaskGroup *group);
+
+	private:
+		struct Item {
+			Task       task;
+			TaskGroup *group;
+		};
+		struct Queue {
+			std::mutex       lock;
+			std::deque<Item> items;
+		};
+
+		TaskPool();
+		void start();
+		void stop();
+		void workerLoop(int index);
+		bool runOne(int index, const TaskGroup *only);
+		bool take(Queue &q, bool back, const TaskGroup *only, Item &out);
+		void finished(TaskGroup *group);
+
+		int nThreads;
+		std::vector<std::thread> workers;
+		std::vector<std::unique_ptr<Queue> > queues;  // one per worker, then the injection queue
+		std::atomic<long> queued;                     // tasks in the queues, not yet taken
+		bool stopping;
+
+		std::mutex              sleepLock;
+		std::condition_variable wake;
+		std::mutex              startLock;
+
+		friend class TaskGroup;
+};
+
+/**********************************************************************************//**
+ * \brief A set of tasks which can be waited for together
+ *************************************************************************************/
+class TaskGroup {
+
+	public:
+		explicit TaskGroup(TaskPool &pool = TaskPool::shared());
+		~TaskGroup() { wait(); };
+		void run(const TaskPool::Task &task) { pool.submit(task, this); };
+		void wait()                          { pool.wait(this);         };
+
+	private:
+		TaskPool          &pool;
+		std::atomic<long>  pending;   // tasks not yet finished
+		std::atomic<long>  queued;    // tasks not yet started
+
+		friend class TaskPool;
+};
+
+/**********************************************************************************//**
+ * \brief Tasks with dependencies, started as soon as everything they depend on is done
+ *************************************************************************************/
+class TaskGraph {
+
+	public:
+		typedef int Node;
+
+		explicit TaskGraph(TaskPool &pool = TaskPool::shared()) : pool(pool) {};
+		Node add(const TaskPool::Task &task, std::initializer_list<Node> after = {});
+		void run();
+
+	private:
+		struct Item {
+			TaskPool::Task    task;
+			int               dependencies;
+			std::vector<Node> next;
+		};
+
+		void start(Node n, TaskGroup &group);
+
+		TaskPool &pool;
+		std::vector<Item> items;
+		std::unique_ptr<std::atomic<int>[]> remaining;
+};
+
+#endif
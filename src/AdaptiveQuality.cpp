@@ -0,0 +1,80 @@
+// Viewer headers
+#include "AdaptiveQuality.h"
+
+// standard c++ headers
+#include <sys/time.h>
+
+using namespace std;
+
+static const QualityLevel levels[] = {
+	// name       smoothing  multisample  lineScale  lineStride
+	{ "full",     true,      true,        1.0f,      1 },
+	{ "fast",     false,     true,        0.5f,      1 },
+	{ "fastest",  false,     false,       0.5f,      4 },
+};
+
+AdaptiveQuality::AdaptiveQuality() {
+	movingLevel = 1;
+	stillDelay  = 0.25;
+	lastMove    = -1e10;
+	applied     = -1;
+}
+
+int AdaptiveQuality::nLevels() {
+	return sizeof(levels) / sizeof(QualityLevel);
+}
+
+double AdaptiveQuality::now() {
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec*1e-6;
+}
+
+void AdaptiveQuality::setMovingLevel(int level) {
+	if(level < 0)          level = 0;
+	if(level >= nLevels()) level = nLevels()-1;
+	movingLevel = level;
+}
+
+//! \brief marks the view as changing by user interaction
+void AdaptiveQuality::moved() {
+	lastMove = now();
+}
+
+const QualityLevel &AdaptiveQuality::current() const {
+	return levels[(applied < 0) ? 0 : applied];
+}
+
+/**********************************************************************************//**
+ * \brief picks the level for this frame and sets its GL state
+ * \return true if the level changed
+ *************************************************************************************/
+bool AdaptiveQuality::update() {
+	return apply((now() - lastMove < stillDelay) ? movingLevel : 0);
+}
+
+//! \brief sets full quality right away, until the next update()
+void AdaptiveQuality::full() {
+	apply(0);
+}
+
+bool AdaptiveQuality::apply(int level) {
+	if(level == applied)
+		return false;
+	applied = level;
+
+	if(levels[level].smoothing) {
+		glEnable( GL_LINE_SMOOTH );
+		glEnable( GL_POLYGON_SMOOTH );
+		glHint( GL_LINE_SMOOTH_HINT, GL_NICEST );
+	} else {
+		glDisable( GL_LINE_SMOOTH );
+		glDisable( GL_POLYGON_SMOOTH );
+		glHint( GL_LINE_SMOOTH_HINT, GL_FASTEST );
+	}
+	if(levels[level].multisample)
+		glEnable( GL_MULTISAMPLE_ARB );
+	else
+		glDisable( GL_MULTISAMPLE_ARB );
+	return true;
+}
@@ -0,0 +1,154 @@
+// Viewer headers
+#include "Arena.h"
+
+// standard c++ headers
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+static const size_t alignment      = 64;               // one cache line
+static const size_t hugePageSize   = 2*1024*1024;
+static const size_t smallBlockSize = 16*1024*1024;
+
+Arena::Arena() {
+	hugePages = false;
+}
+
+//! \brief Destructor, unmaps all blocks (invalidating every pointer handed out)
+Arena::~Arena() {
+	for(Block &b : blocks)
+		munmap(b.base, b.size);
+	for(Block &b : own)
+		munmap(b.base, b.size);
+}
+
+/**********************************************************************************//**
+ * \brief maps one block large enough for the given number of bytes
+ * Explicit huge pages (MAP_HUGETLB) are tried first if requested, falling back to
+ * regular pages with transparent huge pages advised.
+ *************************************************************************************/
+Arena::Block Arena::mapBlock(size_t bytes) {
+	size_t page = (hugePages) ? hugePageSize : 4096;
+	size_t size = max(page, (bytes + page - 1) / page * page);
+	void  *ptr  = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if(hugePages)
+		ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+	if(ptr == MAP_FAILED) {
+		ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if(ptr == MAP_FAILED) {
+			cerr << "Arena: unable to map " << size << " bytes" << endl;
+			exit(3);
+		}
+#ifdef MADV_HUGEPAGE
+		if(hugePages)
+			madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	Block b;
+	b.base = (char*) ptr;
+	b.size = size;
+	b.used = 0;
+	return b;
+}
+
+/**********************************************************************************//**
+ * \brief maps one block for all upcoming allocations
+ * \param bytes the total expected size. Allocations exceeding this end up in new blocks
+ *************************************************************************************/
+void Arena::reserve(size_t bytes) {
+	blocks.push_back(mapBlock(bytes + alignment*32));
+}
+
+void *Arena::allocBytes(const char *name, size_t bytes, bool growable) {
+	void *ptr;
+	if(growable) {
+		own.push_back(mapBlock(bytes));
+		own.back().used = bytes;
+		ptr = own.back().base;
+	} else {
+		size_t size = (bytes + alignment - 1) / alignment * alignment;
+		if(blocks.empty() || blocks.back().used + size > blocks.back().size)
+			blocks.push_back(mapBlock( (size > smallBlockSize) ? size : smallBlockSize ));
+		Block &b = blocks.back();
+		ptr      = b.base + b.used;
+		b.used  += size;
+	}
+
+	Record r;
+	r.name  = name;
+	r.bytes = bytes;
+	r.ptr   = ptr;
+	records.push_back(r);
+	return ptr;
+}
+
+/**********************************************************************************//**
+ * \brief maps a new buffer for a growable one, copies it over and unmaps the old one
+ * The buffer keeps its record, which now reports the new size.
+ * \param old a buffer allocated as growable
+ * \param used the bytes to keep from the old buffer
+ * \param bytes the new size
+ *************************************************************************************/
+void *Arena::growBytes(void *old, size_t used, size_t bytes) {
+	vector<Block>::iterator b = own.begin();
+	while(b != own.end() && b->base != old)
+		++b;
+	if(b == own.end()) {
+		cerr << "Arena: growing a buffer which is not growable" << endl;
+		exit(3);
+	}
+	Block grown = mapBlock(bytes);
+	grown.used  = bytes;
+	copy(b->base, b->base + used, grown.base);
+	munmap(b->base, b->size);
+	*b = grown;
+	for(Record &r : records)
+		if(r.ptr == old) {
+			r.bytes = bytes;
+			r.ptr   = grown.base;
+		}
+	return grown.base;
+}
+
+size_t Arena::bytesUsed() const {
+	size_t sum = 0;
+	for(const Record &r : records)
+		sum += r.bytes;
+	return sum;
+}
+
+size_t Arena::bytesMapped() const {
+	size_t sum = 0;
+	for(const Block &b : blocks)
+		sum += b.size;
+	for(const Block &b : own)
+		sum += b.size;
+	return sum;
+}
+
+//! \brief peak resident set size of the process in bytes
+size_t Arena::peakRSS() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t) usage.ru_maxrss * 1024; // reported in kilobytes on linux
+}
+
+//! \brief prints bytes per buffer, totals and the peak resident set size
+void Arena::report(ostream &out) const {
+	out << "Render buffers:" << endl;
+	for(const Record &r : records)
+		out << "  " << left << setw(16) << r.name << right << setw(14) << r.bytes << " bytes" << endl;
+	out << "  " << left << setw(16) << "total"  << right << setw(14) << bytesUsed()   << " bytes" << endl;
+	out << "  " << left << setw(16) << "mapped" << right << setw(14) << bytesMapped() << " bytes";
+	out << " in " << blocks.size() + own.size() << " block(s)" << ((hugePages) ? " (huge pages)" : "") << endl;
+	out << "Peak RSS: " << peakRSS() << " bytes" << endl;
+}
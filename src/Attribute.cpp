@@ -0,0 +1,101 @@
+// Viewer headers
+#include "Attribute.h"
+#include "Parallel.h"
+
+// standard c++ headers
+#include <iostream>
+#include <mutex>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+Attribute::Attribute() {
+	data    = NULL;
+	bytes   = 0;
+	n       = 0;
+	isFloat = false;
+	lo = hi = avg = 0;
+	nNan    = 0;
+}
+
+Attribute::~Attribute() {
+	if(data)
+		munmap((void*) data, bytes);
+}
+
+/**********************************************************************************//**
+ * \brief maps the file and computes its range
+ * \param fileName raw float64 or float32 values
+ * \param nValues the number of elements in the scene
+ * \return false if the file can not be mapped or does not have one value per element
+ *************************************************************************************/
+bool Attribute::open(const string &fileName, long nValues) {
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if(fd < 0) {
+		cerr << "Unable to open attribute file \"" << fileName << "\"" << endl;
+		return false;
+	}
+	struct stat st;
+	fstat(fd, &st);
+	bytes = st.st_size;
+	if(bytes == nValues*sizeof(double)) {
+		isFloat = false;
+	} else if(bytes == nValues*sizeof(float)) {
+		isFloat = true;
+	} else {
+		cerr << "Attribute file \"" << fileName << "\" has " << bytes << " bytes, expected "
+		     << nValues << " float64 or float32 values" << endl;
+		close(fd);
+		return false;
+	}
+
+	void *ptr = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ptr == MAP_FAILED) {
+		cerr << "Unable to map attribute file \"" << fileName << "\"" << endl;
+		return false;
+	}
+	// the values are read front to back when computing the statistics and the colors
+	madvise(ptr, bytes, MADV_SEQUENTIAL);
+
+	data = ptr;
+	name = fileName;
+	n    = nValues;
+	computeStats();
+	return true;
+}
+
+//! \brief min, max and mean of all values (NaNs are counted and skipped), in parallel
+void Attribute::computeStats() {
+	mutex lock;
+	double sum = 0;
+	lo   =  HUGE_VAL;
+	hi   = -HUGE_VAL;
+	nNan = 0;
+	parallelFor(0, n, [&](long begin, long end) {
+		double myLo  =  HUGE_VAL;
+		double myHi  = -HUGE_VAL;
+		double mySum = 0;
+		long   myNan = 0;
+		for(long i=begin; i<end; i++) {
+			double v = value(i);
+			if(v != v) {
+				myNan++;
+				continue;
+			}
+			myLo   = (v < myLo) ? v : myLo;
+			myHi   = (v > myHi) ? v : myHi;
+			mySum += v;
+		}
+		lock_guard<mutex> guard(lock);
+		lo    = (myLo < lo) ? myLo : lo;
+		hi    = (myHi > hi) ? myHi : hi;
+		sum  += mySum;
+		nNan += myNan;
+	});
+	avg = (n > nNan) ? sum / (n - nNan) : 0.0;
+}
@@ -0,0 +1,504 @@
+// Viewer headers
+#include "BrickStore.h"
+#include "Camera.h"
+
+// standard c++ headers
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**********************************************************************************//**
+ * \brief appends the wireframe of the box [lo,hi]
+ * Corners are numbered with x as bit 0, y as bit 1 and z as bit 2. Flat directions
+ * only keep their lower corners, so a flat box becomes a rectangle outline.
+ *************************************************************************************/
+static void pushWire(const double *lo, const double *hi, vector<float> &coord, vector<GLuint> &lines) {
+	int flat = 0;
+	for(int d=0; d<3; d++)
+		if(hi[d] <= lo[d])
+			flat |= 1<<d;
+	GLuint start = coord.size() / 3;
+	GLuint local[8];
+	for(int c=0, n=0; c<8; c++) {
+		if(c & flat)
+			continue;
+		local[c] = start + n++;
+		for(int d=0; d<3; d++)
+			coord.push_back( (c & (1<<d)) ? hi[d] : lo[d] );
+	}
+	for(int c=0; c<8; c++) {
+		if(c & flat)
+			continue;
+		for(int d=0; d<3; d++) {
+			if((c & (1<<d)) || (flat & (1<<d)))
+				continue;
+			lines.push_back(local[c]);
+			lines.push_back(local[c | (1<<d)]);
+		}
+	}
+}
+
+BrickStore::BrickStore() {
+	fd       = -1;
+	fileEnd  = 0;
+	added    = 0;
+	budget   = 512*1024*1024;
+	resident = 0;
+	frame    = 0;
+	quit     = false;
+}
+
+BrickStore::~BrickStore() {
+	stopLoader();
+	for(Brick &b : bricks)
+		delete b.geometry;
+	if(fd >= 0)
+		close(fd);
+}
+
+void BrickStore::stopLoader() {
+	if(!loader.joinable())
+		return;
+	{
+		lock_guard<mutex> guard(lock);
+		quit = true;
+		cond.notify_all();
+	}
+	loader.join();
+	for(pair<int,Geometry*> &r : ready)
+		delete r.second;
+	ready.clear();
+}
+
+// the file starts with a header pointing at the index after the boxes
+static const char brickMagic[8] = {'L','R','V','B','R','K','1','\0'};
+struct BrickHeader {
+	char magic[8];
+	long indexOffset;
+	long indexBytes;
+};
+// a brick in the index
+struct BrickRecord {
+	double bbMin[3];
+	double bbMax[3];
+	double zOffset;
+	long   offset;
+	long   nEl;
+	long   nRect;
+	long   patch;
+};
+
+//! \brief appends the bytes of value to out
+template<class T>
+static void putBytes(vector<char> &out, const T *value, size_t n = 1) {
+	const char *p = (const char*) value;
+	out.insert(out.end(), p, p + n*sizeof(T));
+}
+
+//! \brief reads n values from in at pos, false if it runs past the end
+template<class T>
+static bool getBytes(const vector<char> &in, size_t &pos, T *value, size_t n = 1) {
+	if(n > (in.size() - pos) / sizeof(T))
+		return false;
+	copy(in.begin()+pos, in.begin()+pos+n*sizeof(T), (char*) value);
+	pos += n*sizeof(T);
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief opens a brick file written by an earlier run
+ * \param key names the sources of the mesh, and must be the one the file was written with
+ * \return false if the file is missing, incomplete or made from other sources
+ *************************************************************************************/
+bool BrickStore::open(const string &fileName, const string &key) {
+	stopLoader();
+	if(fd >= 0)
+		close(fd);
+	fd = ::open(fileName.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	BrickHeader header;
+	vector<char> index;
+	bool valid = pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+	             equal(brickMagic, brickMagic+8, header.magic) &&
+	             header.indexBytes > 0 && header.indexBytes < (1L << 32);
+	if(valid) {
+		index.resize(header.indexBytes);
+		valid = pread(fd, &index[0], index.size(), header.indexOffset) == (ssize_t) index.size();
+	}
+	size_t pos = 0;
+	long   keyLength, nPatches, nBricks;
+	string fileKey;
+	valid = valid && getBytes(index, pos, &keyLength) && keyLength >= 0 && keyLength <= (long) index.size();
+	if(valid) {
+		fileKey.resize(keyLength);
+		valid = getBytes(index, pos, &fileKey[0], keyLength) && fileKey == key;
+	}
+	valid = valid && getBytes(index, pos, &nPatches) && nPatches >= 0 && nPatches <= (long) index.size();
+	if(valid) {
+		patches.resize(nPatches);
+		valid = getBytes(index, pos, patches.data(), nPatches);
+	}
+	valid = valid && getBytes(index, pos, &nBricks) && nBricks >= 0 && nBricks <= (long) index.size();
+	vector<BrickRecord> records(valid ? nBricks : 0);
+	valid = valid && getBytes(index, pos, records.data(), nBricks);
+	if(!valid) {
+		close(fd);
+		fd = -1;
+		patches.clear();
+		return false;
+	}
+
+	bricks.clear();
+	for(BrickRecord &r : records) {
+		Brick b;
+		copy(r.bbMin, r.bbMin+3, b.bbMin);
+		copy(r.bbMax, r.bbMax+3, b.bbMax);
+		b.offset    = r.offset;
+		b.zOffset   = r.zOffset;
+		b.patch     = r.patch;
+		b.nEl       = r.nEl;
+		b.nRect     = r.nRect;
+		b.bytes     = b.nEl   * (8*3*sizeof(float) + 12*2*sizeof(GLuint)) +
+		              b.nRect * (4*3*sizeof(float) +  4*2*sizeof(GLuint));
+		b.visible   = false;
+		b.requested = false;
+		b.lastUsed  = -1;
+		b.geometry  = NULL;
+		bricks.push_back(b);
+	}
+	this->fileName = fileName;
+	cout << "Reusing " << bricks.size() << " bricks from " << fileName << endl;
+	startLoader();
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief starts a new brick file, to be filled by addPatch() and completed by finish()
+ * \param fileName the brick file, overwritten if it exists
+ *************************************************************************************/
+bool BrickStore::create(const string &fileName) {
+	stopLoader();
+	if(fd >= 0)
+		close(fd);
+	fd = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		cerr << "Unable to create brick file \"" << fileName << "\"" << endl;
+		return false;
+	}
+	// no magic until the index is written, so an interrupted file is never reused
+	BrickHeader header = {};
+	if(write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+		cerr << "Error writing brick file \"" << fileName << "\"" << endl;
+		return false;
+	}
+	this->fileName = fileName;
+	fileEnd = sizeof(header);
+	added   = 0;
+	bricks.clear();
+	patches.clear();
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief partitions one patch into bricks and writes them to the file
+ * The items are visited twice: once to count them per brick, and once to stream them
+ * to their brick through a bounded write buffer.
+ * \param elements visits the element boxes, in the coordinates of bbMin and bbMax
+ * \param rects visits the meshrectangle boxes
+ * \param bbMin lower corner of the patch
+ * \param bbMax upper corner of the patch
+ * \param itemsPerBrick the targeted average number of elements and meshrectangles per brick
+ * \return true if the bricks were successfully written
+ *************************************************************************************/
+bool BrickStore::addPatch(long nEl, const Items &elements, long nRect, const Items &rects,
+                          const double *bbMin, const double *bbMax, int itemsPerBrick) {
+	int grid = (int) ceil(cbrt((double) (nEl+nRect) / itemsPerBrick));
+	grid = max(1, min(grid, 64));
+	long nCells = (long) grid*grid*grid;
+	auto cellOf = [&](const double *box) {
+		int c = 0;
+		for(int d=2; d>=0; d--) {
+			double mid = (box[d] + box[3+d]) / 2.0;
+			int    j   = (int) ((mid - bbMin[d]) / (bbMax[d] - bbMin[d]) * grid);
+			c = c*grid + max(0, min(j, grid-1));
+		}
+		return c;
+	};
+
+	// elements before meshrectangles within every brick
+	vector<long> count(2*nCells, 0);
+	elements([&](const double *box) { count[2*cellOf(box)  ]++; });
+	rects(   [&](const double *box) { count[2*cellOf(box)+1]++; });
+	vector<long> start(2*nCells+1, 0);
+	for(long c=0; c<2*nCells; c++)
+		start[c+1] = start[c] + count[c];
+
+	vector<long>           written(2*nCells, 0);
+	vector<vector<double> > pending(2*nCells);
+	vector<double>          lo(3*nCells,  HUGE_VAL);
+	vector<double>          hi(3*nCells, -HUGE_VAL);
+	size_t buffered = 0;
+	bool   ok       = true;
+	auto flush = [&]() {
+		for(long c=0; c<2*nCells; c++) {
+			if(pending[c].empty())
+				continue;
+			size_t bytes = pending[c].size()*sizeof(double);
+			off_t  pos   = fileEnd + (start[c] + written[c]) * 6*sizeof(double);
+			ok &= pwrite(fd, &pending[c][0], bytes, pos) == (ssize_t) bytes;
+			written[c] += pending[c].size() / 6;
+			vector<double>().swap(pending[c]);
+		}
+		buffered = 0;
+	};
+	auto stream = [&](int type) {
+		return [&, type](const double *box) {
+			long c = cellOf(box);
+			pending[2*c+type].insert(pending[2*c+type].end(), box, box+6);
+			for(int d=0; d<3; d++) {
+				lo[3*c+d] = min(lo[3*c+d], box[d]);
+				hi[3*c+d] = max(hi[3*c+d], box[3+d]);
+			}
+			if(++buffered >= (1 << 20))
+				flush();
+		};
+	};
+	elements(stream(0));
+	rects(stream(1));
+	flush();
+	if(!ok) {
+		cerr << "Error writing brick file \"" << fileName << "\"" << endl;
+		return false;
+	}
+
+	for(long c=0; c<nCells; c++) {
+		Brick b;
+		b.nEl       = count[2*c];
+		b.nRect     = count[2*c+1];
+		b.offset    = fileEnd + start[2*c] * 6*sizeof(double);
+		b.zOffset   = 0;
+		b.patch     = added;
+		b.visible   = false;
+		b.requested = false;
+		b.lastUsed  = -1;
+		b.geometry  = NULL;
+		b.bytes     = b.nEl   * (8*3*sizeof(float) + 12*2*sizeof(GLuint)) +
+		              b.nRect * (4*3*sizeof(float) +  4*2*sizeof(GLuint));
+		if(b.nEl + b.nRect == 0)
+			continue;
+		copy(&lo[3*c], &lo[3*c+3], b.bbMin);
+		copy(&hi[3*c], &hi[3*c+3], b.bbMax);
+		bricks.push_back(b);
+	}
+	fileEnd += start[2*nCells] * 6*sizeof(double);
+	added++;
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief places the bricks in the scene, writes the index and starts loading
+ * \param key names the sources of the mesh, see open()
+ * \param patches every patch given to addPatch(), in that order, placed in the scene
+ *************************************************************************************/
+bool BrickStore::finish(const string &key, const vector<Domain> &patches) {
+	this->patches = patches;
+	for(Brick &b : bricks) {
+		b.zOffset   = patches[b.patch].offset;
+		b.bbMin[2] += b.zOffset;
+		b.bbMax[2] += b.zOffset;
+	}
+
+	vector<char> index;
+	long n = key.size();
+	putBytes(index, &n);
+	putBytes(index, key.data(), key.size());
+	n = patches.size();
+	putBytes(index, &n);
+	putBytes(index, patches.data(), patches.size());
+	n = bricks.size();
+	putBytes(index, &n);
+	for(Brick &b : bricks) {
+		BrickRecord r;
+		copy(b.bbMin, b.bbMin+3, r.bbMin);
+		copy(b.bbMax, b.bbMax+3, r.bbMax);
+		r.zOffset = b.zOffset;
+		r.offset  = b.offset;
+		r.nEl     = b.nEl;
+		r.nRect   = b.nRect;
+		r.patch   = b.patch;
+		putBytes(index, &r);
+	}
+	BrickHeader header;
+	copy(brickMagic, brickMagic+8, header.magic);
+	header.indexOffset = fileEnd;
+	header.indexBytes  = index.size();
+	if(pwrite(fd, &index[0], index.size(), fileEnd) != (ssize_t) index.size() ||
+	   pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+		cerr << "Error writing brick file \"" << fileName << "\"" << endl;
+		return false;
+	}
+	cout << "Wrote " << bricks.size() << " bricks (" << fileEnd << " bytes) to " << fileName << endl;
+	startLoader();
+	return true;
+}
+
+void BrickStore::startLoader() {
+	stopLoader();
+	quit   = false;
+	loader = thread(&BrickStore::loaderLoop, this);
+}
+
+/**********************************************************************************//**
+ * \brief reads and tessellates one brick. Called on the loader thread
+ *************************************************************************************/
+BrickStore::Geometry *BrickStore::load(const Brick &b) {
+	vector<double> box((b.nEl + b.nRect) * 6);
+	size_t bytes = box.size()*sizeof(double);
+	if(pread(fd, &box[0], bytes, b.offset) != (ssize_t) bytes)
+		return NULL;
+	for(size_t i=0; i<box.size(); i+=6) {
+		box[i+2] += b.zOffset;
+		box[i+5] += b.zOffset;
+	}
+
+	Geometry *g = new Geometry();
+	g->coord.reserve(b.nEl*8*3 + b.nRect*4*3);
+	g->elLines.reserve(b.nEl*12*2);
+	g->rectLines.reserve(b.nRect*4*2);
+	for(long i=0; i<b.nEl; i++)
+		pushWire(&box[6*i], &box[6*i+3], g->coord, g->elLines);
+	for(long i=b.nEl; i<b.nEl+b.nRect; i++)
+		pushWire(&box[6*i], &box[6*i+3], g->coord, g->rectLines);
+	return g;
+}
+
+void BrickStore::loaderLoop() {
+	while(true) {
+		int id;
+		{
+			unique_lock<mutex> guard(lock);
+			cond.wait(guard, [this]() { return quit || !requests.empty(); });
+			if(quit)
+				return;
+			id = requests.front();
+			requests.pop_front();
+		}
+		Geometry *g = load(bricks[id]);
+		lock_guard<mutex> guard(lock);
+		ready.push_back(make_pair(id, g));
+	}
+}
+
+/**********************************************************************************//**
+ * \brief picks up loaded bricks and decides what to load and evict next
+ * Must be called after the camera matrices for the frame are set up.
+ *************************************************************************************/
+void BrickStore::update(Camera &cam) {
+	frame++;
+	vector<int> pending;
+	{
+		lock_guard<mutex> guard(lock);
+		for(pair<int,Geometry*> &r : ready) {
+			Brick &b = bricks[r.first];
+			b.requested = false;
+			if(r.second == NULL || b.geometry != NULL) {
+				delete r.second;
+				continue;
+			}
+			b.geometry = r.second;
+			resident  += b.bytes;
+		}
+		ready.clear();
+		// whatever the loader has not started on is reprioritized below
+		pending.assign(requests.begin(), requests.end());
+		requests.clear();
+	}
+	for(int id : pending)
+		bricks[id].requested = false;
+
+	// rank on visibility first and distance to the camera second
+	Go::Point eye = cam.getPos();
+	vector<pair<double,int> > rank;
+	for(size_t i=0; i<bricks.size(); i++) {
+		Brick &b  = bricks[i];
+		b.visible = cam.boxInFrustum(b.bbMin, b.bbMax);
+		double dist2 = 0;
+		for(int d=0; d<3; d++) {
+			double outside = max(b.bbMin[d] - eye[d], max(0.0, eye[d] - b.bbMax[d]));
+			dist2 += outside*outside;
+		}
+		if(b.visible && b.geometry != NULL)
+			b.lastUsed = frame;
+		rank.push_back(make_pair((b.visible ? 0.0 : 1e300) + dist2, (int) i));
+	}
+	sort(rank.begin(), rank.end());
+
+	// the most important bricks which fit in the budget, and always the first one
+	vector<char> wanted(bricks.size(), 0);
+	vector<int>  missing;
+	size_t total   = 0;
+	size_t loading = 0;
+	for(pair<double,int> &r : rank) {
+		Brick &b = bricks[r.second];
+		if(total > 0 && total + b.bytes > budget)
+			continue;
+		total += b.bytes;
+		wanted[r.second] = 1;
+		if(b.geometry == NULL) {
+			loading += b.bytes;
+			if(!b.requested)
+				missing.push_back(r.second);
+		}
+	}
+
+	// make room for them, least recently used first
+	vector<pair<long,int> > evictable;
+	for(size_t i=0; i<bricks.size(); i++)
+		if(bricks[i].geometry != NULL && !wanted[i])
+			evictable.push_back(make_pair(bricks[i].lastUsed, (int) i));
+	sort(evictable.begin(), evictable.end());
+	for(pair<long,int> &e : evictable) {
+		if(resident + loading <= budget)
+			break;
+		Brick &b = bricks[e.second];
+		delete b.geometry;
+		b.geometry = NULL;
+		resident  -= b.bytes;
+	}
+
+	if(missing.empty())
+		return;
+	lock_guard<mutex> guard(lock);
+	for(int id : missing) {
+		bricks[id].requested = true;
+		requests.push_back(id);
+	}
+	cond.notify_all();
+}
+
+//! \brief draws the wireframes of all resident bricks inside the view frustum
+void BrickStore::draw(bool elements, bool rectangles) {
+	for(Brick &b : bricks) {
+		if(!b.visible || b.geometry == NULL)
+			continue;
+		Geometry *g = b.geometry;
+		glVertexPointer(3, GL_FLOAT, 0, &g->coord[0]);
+		if(elements && !g->elLines.empty())
+			glDrawElements(GL_LINES, g->elLines.size(), GL_UNSIGNED_INT, &g->elLines[0]);
+		if(rectangles && !g->rectLines.empty())
+			glDrawElements(GL_LINES, g->rectLines.size(), GL_UNSIGNED_INT, &g->rectLines[0]);
+	}
+}
+
+int BrickStore::residentCount() const {
+	int n = 0;
+	for(const Brick &b : bricks)
+		if(b.geometry != NULL)
+			n++;
+	return n;
+}
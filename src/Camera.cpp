@@ -15,6 +15,7 @@
 #include <math.h>
 #include "Camera.h"
 #include <stdio.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -23,17 +24,84 @@ static const GLfloat speed_scale_rotate = 0.003;
 static const GLfloat speed_scale_zoom = 0.005; // this is again multiplied by the model size (bounding box)
 static const GLfloat speed_scale_pan = 0.0014;
 
+// lighting conditions, with the light positions in eye coordinates. The last position
+// value is 0 for a directional and 1 for a positional light
+static const GLfloat ambientLight[4] = {0.3f, 0.3f, 0.3f, 1.0f};
+static const GLfloat lightPosition[8] = {2, -1, -4, 0,   -14, -7, -28, 1};
+static const GLfloat lightDiffuse[8]  = {0.8f, 0.8f, 0.8f, 1.0f,   0.5f, 0.5f, 0.5f, 1.0f};
+static const GLfloat lightSpecular[8] = {1.0f, 1.0f, 1.0f, 1.0f,   0.3f, 0.3f, 0.3f, 1.0f};
+
 void Camera::handleResize(int x, int y, int w, int h) {
+	vp_x = x;
+	vp_y = y;
 	vp_width = w;
 	vp_height = h;
 }
 
+//! \brief restricts drawing (and clearing) to the camera viewport, or to the current tile
+void Camera::setViewport() {
+	if(tile[2] > 0) {
+		glViewport(0, 0, tile[2], tile[3]);
+		glScissor( 0, 0, tile[2], tile[3]);
+		return;
+	}
+	glViewport(vp_x, vp_y, vp_width, vp_height);
+	glScissor( vp_x, vp_y, vp_width, vp_height);
+}
+
+/**********************************************************************************//**
+ * \brief draws only a part of the view, for images larger than the framebuffer
+ * The projection becomes the sub-frustum of the pixels (x,y,w,h) of the viewport, and
+ * they are drawn to the lower left corner of the framebuffer. A zero width turns
+ * tiling off again.
+ *************************************************************************************/
+void Camera::setTile(int x, int y, int w, int h) {
+	tile[0] = x;
+	tile[1] = y;
+	tile[2] = w;
+	tile[3] = h;
+}
+
+/**********************************************************************************//**
+ * \brief checks if a window position is inside the camera viewport
+ * \param x GLUT window coordinate
+ * \param y GLUT window coordinate (counted from the top)
+ * \param windowHeight height of the GLUT window
+ *************************************************************************************/
+bool Camera::contains(int x, int y, int windowHeight) const {
+	y = windowHeight - y;
+	return x >= vp_x && x < vp_x+vp_width && y >= vp_y && y < vp_y+vp_height;
+}
+
+/**********************************************************************************//**
+ * \brief makes this an orthographic camera looking down along an axis
+ * \param axis 0,1 or 2 to look along -x,-y or -z. -1 makes it a perspective camera again
+ * The distance r keeps acting as zoom; rotation is disabled for orthographic cameras.
+ *************************************************************************************/
+void Camera::setOrthographic(int axis) {
+	ortho_axis  = axis;
+	upside_down = false;
+	recalc_pos();
+}
+
+//! \brief moves both the camera and the point it is looking at
+void Camera::translate(float dx, float dy, float dz) {
+	look_at_x += dx;
+	look_at_y += dy;
+	look_at_z += dz;
+	recalc_pos();
+}
+
 /**********************************************************************************//**
  * \brief Default constructor
  * Sets a camera at 15 length units from the origin and looking towards if from 
  * a default angle
  *************************************************************************************/
 Camera::Camera() {
+	vp_x                    = 0;
+	vp_y                    = 0;
+	vp_width                = 1;
+	vp_height               = 1;
 	r                       = 15;
 	phi                     = M_PI_4;
 	theta                   = M_PI_4;
@@ -47,6 +115,9 @@ Camera::Camera() {
 	last_mouse_x            = 0;
 	last_mouse_y            = 0;
 	specialKey              = 0;
+	upside_down             = false;
+	ortho_axis              = -1;
+	setTile(0, 0, 0, 0);
 	recalc_pos();
 }
 
@@ -58,6 +129,10 @@ Camera::Camera() {
  * \param h camera render area height
  *************************************************************************************/
 Camera::Camera(int x, int y, int w, int h) {
+	vp_x                    = x;
+	vp_y                    = y;
+	vp_width                = w;
+	vp_height               = h;
 	r                       = 15;
 	phi                     = M_PI_4;
 	theta                   = M_PI_4;
@@ -71,6 +146,9 @@ Camera::Camera(int x, int y, int w, int h) {
 	last_mouse_x            = 0;
 	last_mouse_y            = 0;
 	specialKey              = 0;
+	upside_down             = false;
+	ortho_axis              = -1;
+	setTile(0, 0, 0, 0);
 	recalc_pos();
 }
 
@@ -88,6 +166,10 @@ Camera::~Camera() {
  * \param d_theta angle-change in the xy-plane (rotate around the object keeping z-height unchanged)
  *************************************************************************************/
 void Camera::rotate(float d_r, float d_phi, float d_theta) {
+	if(ortho_axis >= 0) {
+		d_phi   = 0;
+		d_theta = 0;
+	}
 	r     += d_r;
 	phi   += (upside_down) ? -d_phi : d_phi;
 	theta += (upside_down) ? -d_theta : d_theta;
@@ -135,6 +217,16 @@ void Camera::setLookAt(float x, float y, float z) {
  * \param d_v change in y-coordinate
  *************************************************************************************/
 void Camera::pan(float d_u, float d_v) {
+	if(ortho_axis >= 0) {
+		// screen right and up vectors of the orthographic views
+		static const GLfloat right[3][3] = {{0,1,0}, {-1,0,0}, {1,0,0}};
+		static const GLfloat up[3][3]    = {{0,0,1}, { 0,0,1}, {0,1,0}};
+		look_at_x -= d_u*right[ortho_axis][0] + d_v*up[ortho_axis][0];
+		look_at_y -= d_u*right[ortho_axis][1] + d_v*up[ortho_axis][1];
+		look_at_z -= d_u*right[ortho_axis][2] + d_v*up[ortho_axis][2];
+		recalc_pos();
+		return;
+	}
 	
 	GLfloat cam[] = {look_at_x-x, look_at_y-y, look_at_z-z};
 	GLfloat pan_u[] = {0,0,0};
@@ -172,55 +264,186 @@ void Camera::pan(float d_u, float d_v) {
  * \brief recalculate the x,y,z position based on the (r,theta,phi) position 
  *************************************************************************************/
 void Camera::recalc_pos() {
+	if(ortho_axis >= 0) {
+		x = look_at_x + ((ortho_axis==0) ? r : 0);
+		y = look_at_y + ((ortho_axis==1) ? r : 0);
+		z = look_at_z + ((ortho_axis==2) ? r : 0);
+		return;
+	}
 	x = r*cos(theta)*sin(phi) + look_at_x;
 	y = r*sin(theta)*sin(phi) + look_at_y;
 	z = r*cos(phi) + look_at_z;
 }
 
-//! \brief sets the GL_PROJECTION matrix based on camera parameters
+/**********************************************************************************//**
+ * \brief sets the GL_PROJECTION matrix based on camera parameters
+ * The matrix is the one of glOrtho() or glFrustum(), computed here so that it can
+ * also be handed to shaders without reading it back from GL.
+ *************************************************************************************/
 void Camera::setProjection() {
+	float aspect = (float)vp_width / (float)vp_height;
+	double left, right, bottom, top;
+	if(ortho_axis >= 0) {
+		// same extent at the look-at point as the perspective camera at distance r
+		top = r*tan(M_PI/6);
+	} else {
+		top = size/1000 * tan(M_PI/6);
+	}
+	right  =  top*aspect;
+	left   = -right;
+	bottom = -top;
+	if(tile[2] > 0) {
+		double dx = (right - left) / vp_width;
+		double dy = (top - bottom) / vp_height;
+		left   += dx*tile[0];
+		right   = left   + dx*tile[2];
+		bottom += dy*tile[1];
+		top     = bottom + dy*tile[3];
+	}
+	GLdouble *m = projection;
+	for(int i=0; i<16; i++)
+		m[i] = 0;
+	if(ortho_axis >= 0) {
+		double zNear = -(r+size*10);
+		double zFar  =   r+size*10;
+		m[0]  =  2 / (right - left);
+		m[5]  =  2 / (top - bottom);
+		m[10] = -2 / (zFar - zNear);
+		m[12] = -(right + left) / (right - left);
+		m[13] = -(top + bottom) / (top - bottom);
+		m[14] = -(zFar + zNear) / (zFar - zNear);
+		m[15] =  1;
+	} else {
+		double zNear = size/1000;
+		double zFar  = size*10;
+		m[0]  =  2*zNear / (right - left);
+		m[5]  =  2*zNear / (top - bottom);
+		m[8]  =  (right + left) / (right - left);
+		m[9]  =  (top + bottom) / (top - bottom);
+		m[10] = -(zFar + zNear) / (zFar - zNear);
+		m[11] = -1;
+		m[14] = -2*zFar*zNear / (zFar - zNear);
+	}
 	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(60.0, (float)vp_width / (float)vp_height, size/1000, size*10);
+	glLoadMatrixd(projection);
 }
 
-//! \brief sets the GL_MODELVIEW matrix based on camera parameters (plus lighting conditions)
-void Camera::setModelView() {
+/**********************************************************************************//**
+ * \brief uploads the lighting conditions to the current GL context
+ * The light positions are given in eye coordinates (an identity modelview), so they
+ * follow every camera and only need to be uploaded once per context.
+ *************************************************************************************/
+void Camera::setLights() {
 	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
 	glLoadIdentity();
 
-	GLfloat ambientLight[] = {0.3f, 0.3f, 0.3f, 1.0f};
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientLight);
 	glShadeModel(GL_SMOOTH);
 	glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
 
+	for(int i=0; i<2; i++) {
+		glLightfv(GL_LIGHT0+i, GL_DIFFUSE,  lightDiffuse  + 4*i);
+		glLightfv(GL_LIGHT0+i, GL_SPECULAR, lightSpecular + 4*i);
+		glLightfv(GL_LIGHT0+i, GL_POSITION, lightPosition + 4*i);
+	}
+	glPopMatrix();
+}
 
-	GLfloat lightColor[] = {0.8f, 0.8f, 0.8f, 1.0f};
-	GLfloat specularColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-	// GLfloat lightPos[] = {-7, 7, 28, 1};
-	GLfloat lightPos[] = {2, -1, -4, 0}; // last value=0, directional light
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);
-	glLightfv(GL_LIGHT0, GL_SPECULAR, specularColor);
-	glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
-
-	GLfloat lightColor2[] = {0.5f, 0.5f, 0.5f, 1.0f};
-	GLfloat specularColor2[] = {0.3f, 0.3f, 0.3f, 1.0f};
-	GLfloat lightPos2[] = {-14, -7, -28, 1}; // last value=1, positional light
-	glLightfv(GL_LIGHT1, GL_DIFFUSE, lightColor2);
-	glLightfv(GL_LIGHT1, GL_SPECULAR, specularColor2);
-	glLightfv(GL_LIGHT1, GL_POSITION, lightPos2);
-	
-	if(upside_down)
-		gluLookAt(x,y,z,                            // camera pos
-		          look_at_x, look_at_y, look_at_z,  // viewing pos
-		          0,0,-1);                          // up vector
-	else
-		gluLookAt(x,y,z,                            // camera pos
-		          look_at_x, look_at_y, look_at_z,  // viewing pos
-		          0,0,1);                           // up vector
+/**********************************************************************************//**
+ * \brief the lighting conditions uploaded by setLights(), for shaders doing their own
+ * \param ambient the ambient light (4 values)
+ * \param position the positions of the two lights in eye coordinates (2x4 values)
+ * \param diffuse the diffuse colors of the two lights (2x4 values)
+ *************************************************************************************/
+void Camera::getLights(GLfloat *ambient, GLfloat *position, GLfloat *diffuse) {
+	copy(ambientLight,  ambientLight+4,  ambient);
+	copy(lightPosition, lightPosition+8, position);
+	copy(lightDiffuse,  lightDiffuse+8,  diffuse);
+}
+
+/**********************************************************************************//**
+ * \brief sets the GL_MODELVIEW matrix based on camera parameters
+ * The matrix is the one of gluLookAt(), computed here like the projection.
+ *************************************************************************************/
+void Camera::setModelView() {
+	double eye[] = {x, y, z};
+	double up[3];
+	if(ortho_axis >= 0) {
+		up[0] = 0;  up[1] = (ortho_axis==2);  up[2] = (ortho_axis!=2);
+	} else {
+		up[0] = 0;  up[1] = 0;                up[2] = upside_down ? -1 : 1;
+	}
+
+	// forward, side and (recomputed) up directions of the camera
+	double f[] = {look_at_x - x, look_at_y - y, look_at_z - z};
+	double s[3], u[3];
+	for(int i=0; i<3; i++)
+		s[i] = f[(i+1)%3]*up[(i+2)%3] - f[(i+2)%3]*up[(i+1)%3];
+	double lf = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+	double ls = sqrt(s[0]*s[0] + s[1]*s[1] + s[2]*s[2]);
+	for(int i=0; i<3; i++) {
+		f[i] /= lf;
+		s[i] /= ls;
+	}
+	for(int i=0; i<3; i++)
+		u[i] = s[(i+1)%3]*f[(i+2)%3] - s[(i+2)%3]*f[(i+1)%3];
+
+	GLdouble *m = modelView;
+	for(int i=0; i<3; i++) {
+		m[4*i  ] =  s[i];
+		m[4*i+1] =  u[i];
+		m[4*i+2] = -f[i];
+		m[4*i+3] =  0;
+	}
+	m[12] = -(s[0]*eye[0] + s[1]*eye[1] + s[2]*eye[2]);
+	m[13] = -(u[0]*eye[0] + u[1]*eye[1] + u[2]*eye[2]);
+	m[14] =  (f[0]*eye[0] + f[1]*eye[1] + f[2]*eye[2]);
+	m[15] =  1;
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixd(modelView);
+}
+
+
+/**********************************************************************************//**
+ * \brief extracts the six clipping planes from the camera matrices
+ * Must be called after setProjection() and setModelView(). The planes are stored as
+ * (a,b,c,d) with the inside of the frustum being ax+by+cz+d >= 0
+ *************************************************************************************/
+void Camera::updateFrustum() {
+	const GLdouble *proj = projection;
+	const GLdouble *mv   = modelView;
+	GLdouble m[16];
+
+	// m = proj * mv (column major)
+	for(int col=0; col<4; col++)
+		for(int row=0; row<4; row++) {
+			m[col*4+row] = 0;
+			for(int k=0; k<4; k++)
+				m[col*4+row] += proj[k*4+row] * mv[col*4+k];
+		}
 
+	// left, right, bottom, top, near, far as row3 +/- row0,1,2
+	for(int p=0; p<6; p++)
+		for(int col=0; col<4; col++)
+			frustum[p][col] = m[col*4+3] + ((p%2) ? -1 : 1) * m[col*4+p/2];
 }
 
+/**********************************************************************************//**
+ * \brief conservative test whether an axis-aligned box is (partly) inside the frustum
+ * \param min lower corner of the box
+ * \param max upper corner of the box
+ *************************************************************************************/
+bool Camera::boxInFrustum(const double *min, const double *max) const {
+	for(int p=0; p<6; p++) {
+		double dist = frustum[p][3];
+		for(int d=0; d<3; d++)
+			dist += frustum[p][d] * ((frustum[p][d] >= 0) ? max[d] : min[d]);
+		if(dist < 0)
+			return false;
+	}
+	return true;
+}
 
 /**********************************************************************************//**
  * \brief Mouse action event (clicking)
@@ -230,8 +453,13 @@ void Camera::setModelView() {
  * \param y position of the mouse at the time of use
  *************************************************************************************/
 void Camera::processMouse(int button, int state, int x, int y) {
+	processMouse(button, state, x, y, glutGetModifiers());
+}
+
+//! \brief as above, with the modifier keys given explicitly (i.e. by a remote client)
+void Camera::processMouse(int button, int state, int x, int y, int modifiers) {
 	y = vp_height - y ;
-	specialKey = glutGetModifiers();
+	specialKey = modifiers;
 	if(button == GLUT_RIGHT_BUTTON) {
 		right_mouse_button_down = true;
 		if(state == GLUT_UP) {
@@ -297,11 +525,18 @@ void Camera::paintBackground() {
 	glLoadIdentity();
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
+	// a tile gets its part of the gradient over the full viewport
+	float lo = .3;
+	float hi = .9;
+	if(tile[2] > 0) {
+		lo = .3 + .6 * tile[1]           / vp_height;
+		hi = .3 + .6 * (tile[1]+tile[3]) / vp_height;
+	}
 	glBegin(GL_QUADS);
-		glColor3f(.3, .3, .3);
+		glColor3f(lo, lo, lo);
 		glVertex2f(-1, -1);
 		glVertex2f( 1, -1);
-		glColor3f(.9, .9, .9);
+		glColor3f(hi, hi, hi);
 		glVertex2f( 1, 1);
 		glVertex2f(-1, 1);
 	glEnd();
@@ -0,0 +1,138 @@
+// Viewer headers
+#include "DensityMap.h"
+#include "Parallel.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+DensityMap::DensityMap() {
+	res      = 0;
+	axis     = 2;
+	mode     = COUNT;
+	minValue = 0;
+	maxValue = 0;
+}
+
+//! \brief the cells [first,last) of size h from start, whose centers lie in [lo,hi)
+static void cellRange(double lo, double hi, double start, double h, int n, int &first, int &last) {
+	first = (int) ceil((lo-start)/h - 0.5);
+	last  = (int) ceil((hi-start)/h - 0.5);
+	first = std::min(std::max(first, 0), n);
+	last  = std::min(std::max(last,  0), n);
+}
+
+/**********************************************************************************//**
+ * \brief projects the elements along axis onto a resolution x resolution grid
+ * \param box element boxes, 6 values per element (min xyz, max xyz)
+ * \param skip elements to leave out where nonzero, or NULL
+ * \param domainMin lower corner of the projected domain
+ * \param domainMax upper corner of the projected domain
+ *************************************************************************************/
+void DensityMap::build(const double *box, long nElements, const char *skip, int axis, Mode mode,
+                       const double *domainMin, const double *domainMax, int resolution) {
+	this->axis = axis;
+	this->mode = mode;
+	res = resolution;
+	int    u  = (axis+1)%3;
+	int    v  = (axis+2)%3;
+	double hu = (domainMax[u] - domainMin[u]) / res;
+	double hv = (domainMax[v] - domainMin[v]) / res;
+	double extent[3];
+	for(int d=0; d<3; d++)
+		extent[d] = domainMax[d] - domainMin[d];
+
+	// each block of elements fills its own grid. Depths are spread as difference arrays,
+	// with a second grid counting the elements behind every cell
+	int    w      = (mode == COUNT) ? res : res+1;
+	size_t cells  = (size_t) w*w;
+	long   blocks = std::min((long) TaskPool::shared().threads(), std::max(1L, nElements/65536));
+	vector<vector<double> > sum(blocks);
+	vector<vector<double> > hits(blocks);
+	TaskGroup binning;
+	for(long b=0; b<blocks; b++) {
+		binning.run([&, b]() {
+			vector<double> &s = sum[b];
+			vector<double> &c = hits[b];
+			s.assign(cells, 0.0);
+			if(mode == DEPTH)
+				c.assign(cells, 0.0);
+			long first = nElements* b   /blocks;
+			long last  = nElements*(b+1)/blocks;
+			for(long e=first; e<last; e++) {
+				if(skip && skip[e])
+					continue;
+				const double *bx = box + 6*e;
+				if(mode == COUNT) {
+					int i = (int) floor(((bx[u]+bx[u+3])/2 - domainMin[u]) / hu);
+					int j = (int) floor(((bx[v]+bx[v+3])/2 - domainMin[v]) / hv);
+					i = std::min(std::max(i, 0), res-1);
+					j = std::min(std::max(j, 0), res-1);
+					s[(size_t) j*w + i] += 1;
+					continue;
+				}
+				double level = 0;
+				bool   flat  = false;
+				for(int d=0; d<3; d++) {
+					double size = bx[d+3] - bx[d];
+					flat  |= (size <= 0);
+					level += (size > 0) ? log2(extent[d] / size) / 3 : 0;
+				}
+				int i0, i1, j0, j1;
+				cellRange(bx[u], bx[u+3], domainMin[u], hu, res, i0, i1);
+				cellRange(bx[v], bx[v+3], domainMin[v], hv, res, j0, j1);
+				if(flat || i0 >= i1 || j0 >= j1)
+					continue;
+				s[(size_t) j0*w + i0] += level;   c[(size_t) j0*w + i0] += 1;
+				s[(size_t) j0*w + i1] -= level;   c[(size_t) j0*w + i1] -= 1;
+				s[(size_t) j1*w + i0] -= level;   c[(size_t) j1*w + i0] -= 1;
+				s[(size_t) j1*w + i1] += level;   c[(size_t) j1*w + i1] += 1;
+			}
+		});
+	}
+	binning.wait();
+
+	// sum the block grids, and integrate the difference arrays along i and then j
+	vector<double> &s = sum[0];
+	vector<double> &c = hits[0];
+	parallelFor(0, w, [&](long begin, long end) {
+		for(long j=begin; j<end; j++) {
+			size_t row = (size_t) j*w;
+			for(long b=1; b<blocks; b++) {
+				for(int i=0; i<w; i++)
+					s[row+i] += sum[b][row+i];
+				if(mode == DEPTH)
+					for(int i=0; i<w; i++)
+						c[row+i] += hits[b][row+i];
+			}
+			if(mode == DEPTH)
+				for(int i=1; i<w; i++) {
+					s[row+i] += s[row+i-1];
+					c[row+i] += c[row+i-1];
+				}
+		}
+	}, 16);
+	if(mode == DEPTH) {
+		parallelFor(0, w, [&](long begin, long end) {
+			for(int j=1; j<w; j++)
+				for(long i=begin; i<end; i++) {
+					s[(size_t) j*w + i] += s[(size_t) (j-1)*w + i];
+					c[(size_t) j*w + i] += c[(size_t) (j-1)*w + i];
+				}
+		}, 16);
+	}
+
+	grid.resize((size_t) res*res);
+	for(int j=0; j<res; j++)
+		for(int i=0; i<res; i++) {
+			size_t k = (size_t) j*w + i;
+			if(mode == COUNT)
+				grid[(size_t) j*res + i] = s[k];
+			else
+				grid[(size_t) j*res + i] = (c[k] > 0.5) ? s[k] / c[k] : 0.0;
+		}
+	minValue = *min_element(grid.begin(), grid.end());
+	maxValue = *max_element(grid.begin(), grid.end());
+}
@@ -0,0 +1,138 @@
+// shader entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "EdgeShader.h"
+
+// standard c++ headers
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static const char *vertexSource =
+	"#version 120\n"
+	"uniform bool lighting;\n"
+	"varying vec3 corner;\n"
+	"varying vec4 color;\n"
+	"void main() {\n"
+	"	gl_Position = ftransform();\n"
+	"	corner = gl_MultiTexCoord0.xyz;\n"
+	"	color  = gl_Color;\n"
+	"	if(lighting) {\n"
+	"		vec3 n   = normalize(gl_NormalMatrix * gl_Normal);\n"
+	"		vec3 p   = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
+	"		vec3 lit = gl_LightModel.ambient.rgb * gl_Color.rgb;\n"
+	"		for(int i=0; i<2; i++) {\n"
+	"			vec4 light = gl_LightSource[i].position;\n"
+	"			vec3 l     = normalize(light.xyz - p*light.w);\n"
+	"			lit += gl_Color.rgb * gl_LightSource[i].diffuse.rgb * max(dot(n, l), 0.0);\n"
+	"		}\n"
+	"		color.rgb = min(lit, vec3(1.0));\n"
+	"	}\n"
+	"}\n";
+
+static const char *fragmentSource =
+	"#version 120\n"
+	"uniform vec3  edgeColor;\n"
+	"uniform float edgeWidth;\n"
+	"varying vec3  corner;\n"
+	"varying vec4  color;\n"
+	"void main() {\n"
+	"	vec3 w = fwidth(corner);\n"
+	"	vec3 d = min(corner, 1.0-corner) / max(w, vec3(1e-12));\n"
+	"	// the coordinate which is constant over the face is no edge\n"
+	"	d += 1e12 * (1.0 - step(1e-12, w));\n"
+	"	float dist = min(min(d.x, d.y), d.z);\n"
+	"	float edge = clamp(0.5*edgeWidth + 0.5 - dist, 0.0, 1.0);\n"
+	"	gl_FragColor = vec4(mix(color.rgb, edgeColor, edge), color.a);\n"
+	"}\n";
+
+EdgeShader::EdgeShader() {
+	program     = 0;
+	lightingLoc = -1;
+	colorLoc    = -1;
+	widthLoc    = -1;
+}
+
+//! \brief compiles one stage, printing the log and returning 0 on failure
+static GLuint compile(const char *name, GLenum type, const char *source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	GLint ok = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if(!ok) {
+		GLint length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		vector<char> log(length+1, 0);
+		glGetShaderInfoLog(shader, length, NULL, &log[0]);
+		cerr << name << " shader does not compile: " << &log[0] << endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+/**********************************************************************************//**
+ * \brief compiles and links a program. Needs a current GL 2.0 context
+ * \param name what the program is, for the error messages
+ * \param bind called before linking, to bind attribute and output locations
+ * \return the program, or 0 if it could not be built
+ *************************************************************************************/
+GLuint buildProgram(const char *name, const char *vertexSource, const char *fragmentSource,
+                    const function<void(GLuint)> &bind) {
+	const char *version = (const char*) glGetString(GL_SHADING_LANGUAGE_VERSION);
+	if(!version) {
+		cerr << "No GLSL support for the " << name << " shader" << endl;
+		return 0;
+	}
+	GLuint vertex   = compile(name, GL_VERTEX_SHADER,   vertexSource);
+	GLuint fragment = compile(name, GL_FRAGMENT_SHADER, fragmentSource);
+	if(!vertex || !fragment) {
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return 0;
+	}
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	if(bind)
+		bind(program);
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	GLint ok = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if(!ok) {
+		cerr << name << " shader does not link" << endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+/**********************************************************************************//**
+ * \brief builds the program. Needs a current GL 2.0 context
+ * \return false if the shaders could not be built, in which case ready() stays false
+ *************************************************************************************/
+bool EdgeShader::init() {
+	if(program)
+		return true;
+	program = buildProgram("Edge", vertexSource, fragmentSource);
+	if(!program) {
+		cerr << "Faces and edges are drawn in separate passes" << endl;
+		return false;
+	}
+	lightingLoc = glGetUniformLocation(program, "lighting");
+	colorLoc    = glGetUniformLocation(program, "edgeColor");
+	widthLoc    = glGetUniformLocation(program, "edgeWidth");
+	return true;
+}
+
+//! \brief sets the uniforms of the bound program
+void EdgeShader::setUniforms(bool lighting, const GLfloat *edgeRgb, GLfloat edgeWidth) {
+	glUniform1i(lightingLoc, lighting);
+	glUniform3fv(colorLoc, 1, edgeRgb);
+	glUniform1f(widthLoc, edgeWidth);
+}
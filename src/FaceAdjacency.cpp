@@ -0,0 +1,195 @@
+// Viewer headers
+#include "FaceAdjacency.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <map>
+#include <math.h>
+
+using namespace std;
+
+namespace {
+	// one element face, seen as a rectangle in its plane
+	struct FaceRec {
+		double plane;
+		double u0, u1;
+		double v0, v1;
+		long   face;
+		int    side;
+	};
+
+	struct Event {
+		double u;
+		long   rec;
+		bool   insert;
+		bool operator<(const Event &other) const {
+			if(u != other.u)
+				return u < other.u;
+			return !insert && other.insert; // removals first: touching edges are no overlap
+		}
+	};
+}
+
+FaceAdjacency::FaceAdjacency() {
+	box = 0;
+	n   = 0;
+}
+
+/**********************************************************************************//**
+ * \brief builds the adjacency graph
+ * \param box element boxes, 6 values per element (min xyz, max xyz). The pointer is
+ *        kept for the area computations and must outlive this object
+ * \param nElements number of elements
+ *************************************************************************************/
+void FaceAdjacency::build(const double *box, long nElements) {
+	this->box = box;
+	n = nElements;
+
+	vector<long> pairs;
+	for(int d=0; d<3; d++)
+		sweepAxis(d, pairs);
+
+	// compress to one neighbour list per face
+	offset.assign(6*n+1, 0);
+	for(long face : pairs)
+		offset[face+1]++;
+	for(long i=0; i<6*n; i++)
+		offset[i+1] += offset[i];
+	adj.resize(pairs.size());
+	vector<long> fill(offset.begin(), offset.end()-1);
+	for(size_t i=0; i<pairs.size(); i+=2) {
+		adj[fill[pairs[i  ]]++] = pairs[i+1];
+		adj[fill[pairs[i+1]]++] = pairs[i  ];
+	}
+}
+
+/**********************************************************************************//**
+ * \brief finds all touching face pairs with normal along one axis
+ * The faces crossing the sweep line are bucketed by the binary order of magnitude of
+ * their length in v. Within a bucket at most two faces ending before v0 of a query
+ * can start after v0 minus the largest length of the bucket, so each query costs
+ * O(log n) per bucket in use, also on strongly graded meshes. Faces without area
+ * touch nothing and are left out.
+ * \param d the axis
+ * \param pairs face pairs are appended as consecutive entries
+ *************************************************************************************/
+void FaceAdjacency::sweepAxis(int d, vector<long> &pairs) const {
+	int u = (d+1)%3;
+	int v = (d+2)%3;
+
+	vector<FaceRec> rec(2*n);
+	for(long e=0; e<n; e++) {
+		for(int side=0; side<2; side++) {
+			FaceRec &r = rec[2*e+side];
+			r.plane = box[6*e + 3*side + d];
+			r.u0    = box[6*e + u];
+			r.u1    = box[6*e + 3 + u];
+			r.v0    = box[6*e + v];
+			r.v1    = box[6*e + 3 + v];
+			r.face  = 6*e + 2*d + side;
+			r.side  = side;
+		}
+	}
+	sort(rec.begin(), rec.end(), [](const FaceRec &a, const FaceRec &b) {
+		return a.plane < b.plane;
+	});
+
+	typedef multimap<double,long> Bucket;
+	vector<Event>            events;
+	vector<Bucket::iterator> where(rec.size());
+	vector<int>              bucketOf(rec.size());
+	for(size_t begin=0, end=0; begin<rec.size(); begin=end) {
+		// all faces in one plane, [begin,end)
+		bool bothSides[2] = {false, false};
+		for(end=begin; end<rec.size() && rec[end].plane == rec[begin].plane; end++)
+			bothSides[rec[end].side] = true;
+		if(!bothSides[0] || !bothSides[1])
+			continue;
+
+		events.clear();
+		for(size_t i=begin; i<end; i++) {
+			if(rec[i].u1 <= rec[i].u0 || rec[i].v1 <= rec[i].v0)
+				continue;
+			Event e;
+			e.rec    = i;
+			e.u      = rec[i].u0;
+			e.insert = true;
+			events.push_back(e);
+			e.u      = rec[i].u1;
+			e.insert = false;
+			events.push_back(e);
+		}
+		sort(events.begin(), events.end());
+
+		// faces on each side crossing the sweep line, by length and ordered on v0. A
+		// bucket holds the lengths in [2^b, 2^(b+1))
+		map<int,Bucket> active[2];
+		for(const Event &e : events) {
+			const FaceRec &r = rec[e.rec];
+			if(!e.insert) {
+				map<int,Bucket>::iterator b = active[r.side].find(bucketOf[e.rec]);
+				b->second.erase(where[e.rec]);
+				if(b->second.empty())
+					active[r.side].erase(b);
+				continue;
+			}
+			for(pair<const int,Bucket> &b : active[1 - r.side]) {
+				Bucket::iterator it = b.second.lower_bound(r.v0 - ldexp(1.0, b.first+1));
+				for(; it != b.second.end() && it->first < r.v1; ++it) {
+					if(rec[it->second].v1 > r.v0) {
+						pairs.push_back(r.face);
+						pairs.push_back(rec[it->second].face);
+					}
+				}
+			}
+			bucketOf[e.rec] = ilogb(r.v1 - r.v0);
+			where[e.rec]    = active[r.side][bucketOf[e.rec]].insert(make_pair(r.v0, e.rec));
+		}
+	}
+}
+
+double FaceAdjacency::faceArea(long face) const {
+	long e = face / 6;
+	int d = (face % 6) / 2;
+	int u = (d+1)%3;
+	int v = (d+2)%3;
+	return (box[6*e+3+u] - box[6*e+u]) * (box[6*e+3+v] - box[6*e+v]);
+}
+
+double FaceAdjacency::overlapArea(long faceA, long faceB) const {
+	long a = faceA / 6;
+	long b = faceB / 6;
+	int d = (faceA % 6) / 2;
+	double area = 1.0;
+	for(int j=1; j<3; j++) {
+		int k = (d+j)%3;
+		double lo = max(box[6*a  +k], box[6*b  +k]);
+		double hi = min(box[6*a+3+k], box[6*b+3+k]);
+		area *= (hi > lo) ? hi-lo : 0.0;
+	}
+	return area;
+}
+
+/**********************************************************************************//**
+ * \brief finds the faces of an element subset which are (partly) visible from outside
+ * A face is exposed unless the neighbouring faces belonging to the subset cover all of
+ * it. Runs in time proportional to the faces of the subset and their neighbours.
+ * \param elements the elements of the subset
+ * \param inSet membership flag for every element in the mesh
+ * \param faces exposed face numbers are appended to this vector
+ *************************************************************************************/
+void FaceAdjacency::exposedFaces(const vector<long> &elements, const vector<char> &inSet,
+                                 vector<long> &faces) const {
+	for(long e : elements) {
+		for(long f=6*e; f<6*e+6; f++) {
+			double area    = faceArea(f);
+			double covered = 0.0;
+			const long *nb = neighbours(f);
+			for(int i=0; i<neighbourCount(f); i++)
+				if(inSet[nb[i]/6])
+					covered += overlapArea(f, nb[i]);
+			if(covered < area*(1-1e-10))
+				faces.push_back(f);
+		}
+	}
+}
@@ -0,0 +1,224 @@
+// pixel buffer object entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "FrameCapture.h"
+
+// standard c++ headers
+#include <iostream>
+#include <string.h>
+
+#ifdef HAS_PNG
+#include <png.h>
+#endif
+
+using namespace std;
+
+FrameCapture::FrameCapture() {
+	head       = 0;
+	frameCount = 0;
+	width      = 0;
+	height     = 0;
+	fps        = 30;
+	running    = false;
+	done       = false;
+	raw        = NULL;
+}
+
+//! \brief Destructor, flushes all pending frames
+FrameCapture::~FrameCapture() {
+	stop();
+}
+
+/**********************************************************************************//**
+ * \brief starts recording
+ * \param target printf-style image name (i.e. "frame%05d.png") or a raw rgb24 stream
+ *        ("-" for stdout) if it contains no '%'
+ * \param width  width of the recorded area in pixels
+ * \param height height of the recorded area in pixels
+ * \param fps    frames per simulated second
+ * \return true if the capture was successfully started
+ *************************************************************************************/
+bool FrameCapture::start(const string &target, int width, int height, double fps) {
+	if(running)
+		stop();
+
+	pattern      = target;
+	this->width  = width;
+	this->height = height;
+	this->fps    = fps;
+	frameCount   = 0;
+	head         = 0;
+	done         = false;
+
+	if(pattern.find('%') == string::npos) {
+		raw = (pattern == "-") ? stdout : fopen(pattern.c_str(), "wb");
+		if(raw == NULL) {
+			cerr << "Unable to open capture stream \"" << pattern << "\"" << endl;
+			return false;
+		}
+		cerr << "Capturing raw video, play with: ffplay -f rawvideo -pixel_format rgb24 ";
+		cerr << "-video_size " << width << "x" << height << " -framerate " << fps << " " << pattern << endl;
+	}
+
+	glGenBuffers(ringSize, pbo);
+	for(int i=0; i<ringSize; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width*height*3, NULL, GL_STREAM_READ);
+		pboFrame[i] = -1;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	writer  = thread(&FrameCapture::writerLoop, this);
+	running = true;
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief queues a readback of the current back buffer
+ * Should be called when the frame is complete, before swapping buffers. The pixels of
+ * the frame issued ringSize-1 calls ago are collected and sent to the writer thread.
+ *************************************************************************************/
+void FrameCapture::capture() {
+	if(!running)
+		return;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_BACK);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[head]);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	pboFrame[head] = frameCount++;
+
+	head = (head+1) % ringSize;
+	collect(head);
+}
+
+//! \brief maps one pbo (if it holds a frame) and hands its pixels to the writer
+void FrameCapture::collect(int slot) {
+	if(pboFrame[slot] < 0)
+		return;
+
+	Frame *f = new Frame();
+	f->index = pboFrame[slot];
+	f->pixels.resize(width*height*3);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+	void *ptr = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if(ptr != NULL) {
+		memcpy(&f->pixels[0], ptr, f->pixels.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	pboFrame[slot] = -1;
+
+	// wait for the writer rather than dropping the frame
+	unique_lock<mutex> guard(lock);
+	cond.wait(guard, [this]() { return queue.size() < (size_t) maxQueued; });
+	queue.push_back(f);
+	cond.notify_all();
+}
+
+//! \brief collects the frames still in flight and waits for the writer to finish
+void FrameCapture::stop() {
+	if(!running)
+		return;
+
+	for(int i=1; i<=ringSize; i++)
+		collect((head+i) % ringSize);
+	glDeleteBuffers(ringSize, pbo);
+
+	{
+		lock_guard<mutex> guard(lock);
+		done = true;
+		cond.notify_all();
+	}
+	writer.join();
+
+	if(raw != NULL && raw != stdout)
+		fclose(raw);
+	else if(raw != NULL)
+		fflush(raw);
+	raw     = NULL;
+	running = false;
+	cerr << "Captured " << frameCount << " frames" << endl;
+}
+
+void FrameCapture::writerLoop() {
+	while(true) {
+		Frame *f;
+		{
+			unique_lock<mutex> guard(lock);
+			cond.wait(guard, [this]() { return done || !queue.empty(); });
+			if(queue.empty())
+				return;
+			f = queue.front();
+			queue.pop_front();
+			cond.notify_all();
+		}
+		write(f);
+		delete f;
+	}
+}
+
+void FrameCapture::write(Frame *f) {
+	int rowSize = width*3;
+	if(raw != NULL) {
+		// openGL rows run bottom-up
+		for(int i=height-1; i>=0; i--)
+			fwrite(&f->pixels[i*rowSize], 1, rowSize, raw);
+		return;
+	}
+
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), pattern.c_str(), (int) f->index);
+	size_t len = strlen(fileName);
+	bool ok;
+	if(len > 4 && strcmp(fileName+len-4, ".png") == 0)
+		ok = writePNG(fileName, f);
+	else
+		ok = writePPM(fileName, f);
+	if(!ok)
+		cerr << "Error writing \"" << fileName << "\"" << endl;
+}
+
+bool FrameCapture::writePPM(const char *fileName, Frame *f) {
+	FILE *out = fopen(fileName, "wb");
+	if(out == NULL)
+		return false;
+	int rowSize = width*3;
+	fprintf(out, "P6\n%d %d\n255\n", width, height);
+	for(int i=height-1; i>=0; i--)
+		fwrite(&f->pixels[i*rowSize], 1, rowSize, out);
+	fclose(out);
+	return true;
+}
+
+bool FrameCapture::writePNG(const char *fileName, Frame *f) {
+#ifdef HAS_PNG
+	FILE *out = fopen(fileName, "wb");
+	if(out == NULL)
+		return false;
+	png_structp png  = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop   info = png_create_info_struct(png);
+	if(setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		fclose(out);
+		return false;
+	}
+	png_init_io(png, out);
+	png_set_compression_level(png, 1); // favour speed, the frames are mostly flat
+	png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+	             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png, info);
+	for(int i=height-1; i>=0; i--)
+		png_write_row(png, &f->pixels[i*width*3]);
+	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
+	fclose(out);
+	return true;
+#else
+	// no libpng available, fall back to the uncompressed format
+	string name(fileName, strlen(fileName)-4);
+	return writePPM((name + ".ppm").c_str(), f);
+#endif
+}
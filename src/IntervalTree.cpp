@@ -0,0 +1,116 @@
+// Viewer headers
+#include "IntervalTree.h"
+
+// standard c++ headers
+#include <algorithm>
+
+using namespace std;
+
+IntervalTree::IntervalTree() {
+	n = 0;
+}
+
+void IntervalTree::clear() {
+	nodes.clear();
+	byLo.clear();
+	byHi.clear();
+	n = 0;
+}
+
+/**********************************************************************************//**
+ * \brief builds the tree from the intervals [lo[i], hi[i]]
+ * \param lo lower bound of all intervals
+ * \param hi upper bound of all intervals
+ *************************************************************************************/
+void IntervalTree::build(const vector<double> &lo, const vector<double> &hi) {
+	clear();
+	n = lo.size();
+	nodes.reserve(n/4 + 1);
+	byLo.reserve(n);
+	byHi.reserve(n);
+	vector<long> ids(n);
+	for(long i=0; i<n; i++)
+		ids[i] = i;
+	if(n > 0)
+		build(ids, lo, hi);
+}
+
+long IntervalTree::build(vector<long> &ids, const vector<double> &lo, const vector<double> &hi) {
+	if(ids.empty())
+		return -1;
+
+	// split on the median of the interval midpoints
+	vector<long>::iterator mid = ids.begin() + ids.size()/2;
+	nth_element(ids.begin(), mid, ids.end(), [&](long a, long b) {
+		return lo[a]+hi[a] < lo[b]+hi[b];
+	});
+	double center = (lo[*mid] + hi[*mid]) / 2.0;
+
+	vector<long> leftIds, rightIds;
+	long begin = byLo.size();
+	for(long i : ids) {
+		if(hi[i] < center) {
+			leftIds.push_back(i);
+		} else if(lo[i] > center) {
+			rightIds.push_back(i);
+		} else {
+			Entry e;
+			e.id  = i;
+			e.val = lo[i];
+			byLo.push_back(e);
+			e.val = hi[i];
+			byHi.push_back(e);
+		}
+	}
+	ids.clear();
+	ids.shrink_to_fit();
+	long count = byLo.size() - begin;
+	sort(byLo.begin()+begin, byLo.end(), [](const Entry &a, const Entry &b) { return a.val < b.val; });
+	sort(byHi.begin()+begin, byHi.end(), [](const Entry &a, const Entry &b) { return a.val > b.val; });
+
+	long me = nodes.size();
+	nodes.push_back(Node());
+	nodes[me].center = center;
+	nodes[me].begin  = begin;
+	nodes[me].count  = count;
+	long left  = build(leftIds,  lo, hi);
+	long right = build(rightIds, lo, hi);
+	nodes[me].left   = left;
+	nodes[me].right  = right;
+	return me;
+}
+
+/**********************************************************************************//**
+ * \brief finds all intervals overlapping [a,b]
+ * \param a lower query bound
+ * \param b upper query bound
+ * \param result interval indices are appended to this vector (not cleared)
+ *************************************************************************************/
+void IntervalTree::query(double a, double b, vector<long> &result) const {
+	if(n > 0)
+		query(0, a, b, result);
+}
+
+void IntervalTree::query(long node, double a, double b, vector<long> &result) const {
+	while(node >= 0) {
+		const Node &nd = nodes[node];
+		const Entry *lo = &byLo[nd.begin];
+		const Entry *hi = &byHi[nd.begin];
+		if(b < nd.center) {
+			// everything here ends past the query, only check the start
+			for(long i=0; i<nd.count && lo[i].val <= b; i++)
+				result.push_back(lo[i].id);
+			node = nd.left;
+		} else if(a > nd.center) {
+			// everything here starts before the query, only check the end
+			for(long i=0; i<nd.count && hi[i].val >= a; i++)
+				result.push_back(hi[i].id);
+			node = nd.right;
+		} else {
+			for(long i=0; i<nd.count; i++)
+				result.push_back(lo[i].id);
+			query(nd.left, a, b, result);
+			node = nd.right;
+		}
+	}
+}
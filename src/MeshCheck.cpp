@@ -0,0 +1,407 @@
+// Viewer headers
+#include "MeshCheck.h"
+#include "Parallel.h"
+#include "PointLocator.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <math.h>
+
+using namespace std;
+
+/**********************************************************************************//**
+ * \brief Range add and min/max over an array of cells
+ *************************************************************************************/
+class RangeTree {
+
+	public:
+		void reset(int cells) {
+			n = cells;
+			lo.assign(4*n, 0);
+			hi.assign(4*n, 0);
+			lazy.assign(4*n, 0);
+		}
+		void add(int first, int last, long long value) {
+			if(first < last)
+				add(1, 0, n, first, last, value);
+		}
+		long long min() const { return lo[1]; };
+		long long max() const { return hi[1]; };
+
+		//! \brief the cells with a positive value, or nonzero unless positiveOnly
+		void collect(bool positiveOnly, vector<int> &cells) {
+			cells.clear();
+			collect(1, 0, n, positiveOnly, cells);
+		}
+
+	private:
+		void apply(int node, long long value) {
+			lo[node]   += value;
+			hi[node]   += value;
+			lazy[node] += value;
+		}
+		void push(int node) {
+			if(lazy[node] != 0) {
+				apply(2*node,   lazy[node]);
+				apply(2*node+1, lazy[node]);
+				lazy[node] = 0;
+			}
+		}
+		void add(int node, int l, int r, int first, int last, long long value) {
+			if(last <= l || r <= first)
+				return;
+			if(first <= l && r <= last) {
+				apply(node, value);
+				return;
+			}
+			push(node);
+			int m = (l+r)/2;
+			add(2*node,   l, m, first, last, value);
+			add(2*node+1, m, r, first, last, value);
+			lo[node] = std::min(lo[2*node], lo[2*node+1]);
+			hi[node] = std::max(hi[2*node], hi[2*node+1]);
+		}
+		void collect(int node, int l, int r, bool positiveOnly, vector<int> &cells) {
+			if(hi[node] <= 0 && (positiveOnly || lo[node] >= 0))
+				return;
+			if(r - l == 1) {
+				cells.push_back(l);
+				return;
+			}
+			push(node);
+			int m = (l+r)/2;
+			collect(2*node,   l, m, positiveOnly, cells);
+			collect(2*node+1, m, r, positiveOnly, cells);
+		}
+
+		int n;
+		vector<long long> lo;
+		vector<long long> hi;
+		vector<long long> lazy;
+};
+
+// element faces count this much against the meshrectangles on them
+static const long long covered = 1LL << 32;
+
+MeshCheck::MeshCheck() {
+	for(int d=0; d<3; d++) {
+		mismatchArea[d] = 0;
+		danglingArea[d] = 0;
+	}
+	elementVolume   = 0;
+	domainVolume    = 0;
+	overlapVolume   = 0;
+	uncoveredVolume = 0;
+	seconds         = 0;
+	elBox   = rectBox  = domain = NULL;
+	elSkip  = rectSkip = NULL;
+	nEl     = nRect    = nDomain = 0;
+}
+
+//! \brief the normal of the meshrectangle box b, or -1 if it is not flat along exactly one axis
+static int rectNormal(const double *b) {
+	int normal = -1;
+	for(int d=0; d<3; d++) {
+		if(b[d] == b[d+3]) {
+			if(normal >= 0)
+				return -1;
+			normal = d;
+		}
+	}
+	return normal;
+}
+
+//! \brief the volume of the box b
+static double volume(const double *b) {
+	return (b[3]-b[0]) * (b[4]-b[1]) * (b[5]-b[2]);
+}
+
+/**********************************************************************************//**
+ * \brief checks the planes normal to axis
+ * Items are numbered as the lower element faces [0,n), the upper element faces
+ * [n,2n), the meshrectangles [2n,2n+r), and the lower and upper domain faces after
+ * those. Starting faces count +1 and ending ones -1 in the signed tree; the element
+ * faces cover the meshrectangles in the other one. The planes are swept in parallel.
+ * \param badElements receives the elements at a mismatch
+ * \param badRects receives the meshrectangles not on element faces
+ *************************************************************************************/
+void MeshCheck::checkAxis(int axis, vector<long> &badElements, vector<long> &badRects) {
+	int  u         = (axis+1)%3;
+	int  v         = (axis+2)%3;
+	long rectBegin = 2*nEl;
+	long domBegin  = rectBegin + nRect;
+	auto box = [&](long item) -> const double* {
+		if(item < nEl)       return elBox   + 6*item;
+		if(item < rectBegin) return elBox   + 6*(item-nEl);
+		if(item < domBegin)  return rectBox + 6*(item-rectBegin);
+		return domain + 6*((item-domBegin)%nDomain);
+	};
+	// upper element faces end an element, and lower domain faces the outside
+	auto ending = [&](long item) {
+		return (item >= nEl && item < rectBegin) || (item >= domBegin && item < domBegin+nDomain);
+	};
+
+	// every face in the plane of its normal coordinate
+	vector<pair<double, long> > faces;
+	faces.reserve(2*nEl + 2*nDomain);
+	for(long e=0; e<nEl; e++) {
+		if(elSkip && elSkip[e])
+			continue;
+		faces.push_back(make_pair(elBox[6*e+axis],   e));
+		faces.push_back(make_pair(elBox[6*e+3+axis], e+nEl));
+	}
+	for(long r=0; r<nRect; r++)
+		if(!(rectSkip && rectSkip[r]) && rectNormal(rectBox + 6*r) == axis)
+			faces.push_back(make_pair(rectBox[6*r+axis], rectBegin+r));
+	for(long p=0; p<nDomain; p++) {
+		faces.push_back(make_pair(domain[6*p+axis],   domBegin+p));
+		faces.push_back(make_pair(domain[6*p+3+axis], domBegin+nDomain+p));
+	}
+	sort(faces.begin(), faces.end());
+
+	vector<size_t> planes;   // first face of every plane, and the end
+	for(size_t f=0; f<faces.size(); f++)
+		if(f == 0 || faces[f].first != faces[f-1].first)
+			planes.push_back(f);
+	planes.push_back(faces.size());
+
+	struct Event {
+		double u;
+		int    face;   // in the plane
+		int    sign;   // +1 where the face starts along u, -1 where it ends
+		bool operator<(const Event &e) const { return u < e.u; };
+	};
+	struct Change {
+		int       first;   // cells
+		int       last;
+		long long sum;
+		long long cover;
+		bool operator<(const Change &c) const { return first < c.first || (first == c.first && last < c.last); };
+	};
+	mutex found;
+	parallelFor(0, planes.size()-1, [&](long firstPlane, long lastPlane) {
+		vector<Event>  events;
+		vector<Change> changes;
+		vector<double> vs;
+		vector<int>    cellLo, cellHi;
+		vector<int>    activeEl, activeRect, position;
+		vector<int>    cells;
+		vector<long>   elements, rects;
+		double         mismatch = 0;
+		double         off      = 0;
+		RangeTree signedSum, rectCover;
+
+		// the active faces of the plane at a overlapping the cells, which are sorted
+		auto offenders = [&](const vector<int> &active, size_t a, long offset, vector<long> &bad) {
+			for(int f : active) {
+				vector<int>::iterator c = lower_bound(cells.begin(), cells.end(), cellLo[f]);
+				if(c != cells.end() && *c < cellHi[f])
+					bad.push_back(faces[a+f].second - offset);
+			}
+		};
+
+		for(long plane=firstPlane; plane<lastPlane; plane++) {
+			// the faces [a,b), swept along u with cells along v
+			size_t a = planes[plane];
+			size_t b = planes[plane+1];
+			events.clear();
+			vs.clear();
+			for(size_t f=a; f<b; f++) {
+				const double *bx = box(faces[f].second);
+				if(bx[u] >= bx[u+3] || bx[v] >= bx[v+3])
+					continue;
+				Event start = {bx[u],   (int) (f-a),  1};
+				Event stop  = {bx[u+3], (int) (f-a), -1};
+				events.push_back(start);
+				events.push_back(stop);
+				vs.push_back(bx[v]);
+				vs.push_back(bx[v+3]);
+			}
+			if(events.empty())
+				continue;
+			sort(vs.begin(), vs.end());
+			vs.erase(unique(vs.begin(), vs.end()), vs.end());
+			cellLo.assign(b-a, 0);
+			cellHi.assign(b-a, 0);
+			for(size_t f=a; f<b; f++) {
+				const double *bx = box(faces[f].second);
+				cellLo[f-a] = lower_bound(vs.begin(), vs.end(), bx[v])   - vs.begin();
+				cellHi[f-a] = lower_bound(vs.begin(), vs.end(), bx[v+3]) - vs.begin();
+			}
+			sort(events.begin(), events.end());
+			signedSum.reset(vs.size()-1);
+			rectCover.reset(vs.size()-1);
+			activeEl.clear();
+			activeRect.clear();
+			position.assign(b-a, -1);
+
+			for(size_t i=0, j=0; i<events.size(); i=j) {
+				changes.clear();
+				for(j=i; j<events.size() && events[j].u == events[i].u; j++) {
+					const Event &e = events[j];
+					int  f    = e.face;
+					long item = faces[a+f].second;
+					bool rect = (item >= rectBegin && item < domBegin);
+					Change c  = {cellLo[f], cellHi[f], 0, 0};
+					if(rect)
+						c.cover = e.sign;
+					else
+						c.sum = (ending(item) ? -1 : 1) * e.sign;
+					if(item < rectBegin)
+						c.cover = -covered * e.sign;
+					changes.push_back(c);
+					if(item >= domBegin)
+						continue;
+					vector<int> &active = rect ? activeRect : activeEl;
+					if(e.sign > 0) {
+						position[f] = active.size();
+						active.push_back(f);
+					} else {
+						active[position[f]] = active.back();
+						position[active.back()] = position[f];
+						active.pop_back();
+					}
+				}
+				// faces ending where others start over the same cells cancel out
+				sort(changes.begin(), changes.end());
+				for(size_t k=0, l=0; k<changes.size(); k=l) {
+					Change c = changes[k];
+					for(l=k+1; l<changes.size() && !(c < changes[l]); l++) {
+						c.sum   += changes[l].sum;
+						c.cover += changes[l].cover;
+					}
+					if(c.sum != 0)
+						signedSum.add(c.first, c.last, c.sum);
+					if(c.cover != 0)
+						rectCover.add(c.first, c.last, c.cover);
+				}
+				if(j == events.size())
+					break;
+				// the slab [u, next u) is uniform along u
+				double width = events[j].u - events[i].u;
+				if(signedSum.min() < 0 || signedSum.max() > 0) {
+					signedSum.collect(false, cells);
+					for(int c : cells)
+						mismatch += width * (vs[c+1] - vs[c]);
+					offenders(activeEl, a, 0, elements);
+				}
+				if(rectCover.max() > 0) {
+					rectCover.collect(true, cells);
+					for(int c : cells)
+						off += width * (vs[c+1] - vs[c]);
+					offenders(activeRect, a, rectBegin, rects);
+				}
+			}
+		}
+
+		lock_guard<mutex> lock(found);
+		for(long e : elements)
+			badElements.push_back((e >= nEl) ? e-nEl : e);
+		badRects.insert(badRects.end(), rects.begin(), rects.end());
+		mismatchArea[axis] += mismatch;
+		danglingArea[axis] += off;
+	}, 1);
+}
+
+/**********************************************************************************//**
+ * \brief checks the mesh
+ * \param elBox element boxes, 6 values per element (min xyz, max xyz)
+ * \param elSkip elements to leave out where nonzero (i.e. free slots), or NULL
+ * \param rectBox meshrectangle boxes, 6 values each and flat along their normal
+ * \param rectSkip meshrectangles to leave out where nonzero, or NULL
+ * \param domains the box of every patch, 6 values each
+ *************************************************************************************/
+void MeshCheck::run(const double *elBox, long nElements, const char *elSkip,
+                    const double *rectBox, long nRect, const char *rectSkip,
+                    const vector<double> &domains) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	*this = MeshCheck();
+	this->elBox    = elBox;
+	this->elSkip   = elSkip;
+	this->nEl      = nElements;
+	this->rectBox  = rectBox;
+	this->rectSkip = rectSkip;
+	this->nRect    = nRect;
+	this->domain   = domains.empty() ? NULL : &domains[0];
+	this->nDomain  = domains.size() / 6;
+
+	vector<long> badElements[3];
+	vector<long> badRects[3];
+	TaskGroup axes;
+	for(int d=0; d<3; d++)
+		axes.run([this, d, &badElements, &badRects]() { checkAxis(d, badElements[d], badRects[d]); });
+	axes.run([this]() {
+		for(long e=0; e<nEl; e++)
+			if(!(this->elSkip && this->elSkip[e]))
+				elementVolume += volume(this->elBox + 6*e);
+		for(long p=0; p<nDomain; p++)
+			domainVolume += volume(domain + 6*p);
+	});
+	axes.wait();
+
+	for(int d=0; d<3; d++) {
+		mismatched.insert(mismatched.end(), badElements[d].begin(), badElements[d].end());
+		dangling.insert(dangling.end(), badRects[d].begin(), badRects[d].end());
+	}
+	sort(mismatched.begin(), mismatched.end());
+	mismatched.erase(unique(mismatched.begin(), mismatched.end()), mismatched.end());
+	sort(dangling.begin(), dangling.end());
+	dangling.erase(unique(dangling.begin(), dangling.end()), dangling.end());
+
+	// every overlap has an element at a mismatch, but the other one may be whole (i.e.
+	// an element inside another), so the flagged elements are tested against all of them
+	if(!mismatched.empty()) {
+		PointLocator tree;
+		tree.build(elBox, nEl, elSkip);
+		vector<long> found;
+		for(long e : mismatched) {
+			tree.overlapping(elBox + 6*e, found);
+			for(long o : found)
+				if(o != e)
+					overlaps.push_back(make_pair(std::min(e, o), std::max(e, o)));
+		}
+		sort(overlaps.begin(), overlaps.end());
+		overlaps.erase(unique(overlaps.begin(), overlaps.end()), overlaps.end());
+		for(const pair<long, long> &o : overlaps) {
+			const double *a = elBox + 6*o.first;
+			const double *b = elBox + 6*o.second;
+			double common = 1;
+			for(int d=0; d<3; d++)
+				common *= std::min(a[d+3], b[d+3]) - std::max(a[d], b[d]);
+			overlapVolume += common;
+		}
+	}
+
+	// negative where the overlaps do not explain the element volume, i.e. elements
+	// outside the domain
+	uncoveredVolume = domainVolume - elementVolume + overlapVolume;
+	if(fabs(uncoveredVolume) < 1e-12 * domainVolume)
+		uncoveredVolume = 0;
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**********************************************************************************//**
+ * \brief writes a summary of the findings
+ * \param elId   the ids the elements are known by, if not their index here (or NULL)
+ * \param rectId the same for the meshrectangles
+ *************************************************************************************/
+void MeshCheck::report(ostream &out, const long *elId, const long *rectId) const {
+	out << "Mesh check of " << nEl << " elements and " << nRect << " meshrectangles in " << seconds << " s" << endl;
+	out << "  mismatched faces: " << mismatched.size() << " elements, area normal to x/y/z "
+	    << mismatchArea[0] << " / " << mismatchArea[1] << " / " << mismatchArea[2] << endl;
+	out << "  overlaps: " << overlaps.size() << " element pairs, volume " << overlapVolume << endl;
+	out << "  uncovered volume: " << uncoveredVolume << " (elements " << elementVolume
+	    << " of domain " << domainVolume << ")" << endl;
+	if(uncoveredVolume < 0)
+		out << "    the elements exceed the domain by more than their overlaps" << endl;
+	out << "  dangling meshrectangles: " << dangling.size() << ", area off element faces "
+	    << danglingArea[0] + danglingArea[1] + danglingArea[2] << endl;
+	for(size_t i=0; i<overlaps.size() && i<10; i++)
+		out << "    elements " << (elId ? elId[overlaps[i].first]  : overlaps[i].first) << " and "
+		    << (elId ? elId[overlaps[i].second] : overlaps[i].second) << " overlap" << endl;
+	for(size_t i=0; i<dangling.size() && i<10; i++)
+		out << "    meshrectangle " << (rectId ? rectId[dangling[i]] : dangling[i]) << " is off the element faces" << endl;
+	out << (valid() ? "  the mesh is consistent" : "  the mesh is NOT consistent") << endl;
+}
@@ -0,0 +1,306 @@
+// Viewer headers
+#include "MeshExport.h"
+#include "Attribute.h"
+
+// standard c++ headers
+#include <iostream>
+#include <sstream>
+#include <math.h>
+#include <stdint.h>
+#include <ctype.h>
+
+using namespace std;
+
+static const size_t bufferSize = 4 << 20;
+
+// the 8 corners of a hexahedron in VTK order, as (x,y,z) bits of the element box
+static const int hexCorner[8] = {0, 1, 3, 2, 4, 5, 7, 6};
+
+// the 6 faces of a hexahedron, in VTK corner numbers, oriented outwards
+static const int hexFace[6][4] = {{0,3,2,1}, {4,5,6,7}, {0,4,7,3}, {1,2,6,5}, {0,1,5,4}, {3,7,6,2}};
+
+static bool littleEndian() {
+	uint16_t one = 1;
+	return *((const char*) &one) == 1;
+}
+
+//! \brief the attribute file name without directories, safe to put in a header
+static string attributeName(const Attribute *a) {
+	string name = a->getName();
+	size_t slash = name.rfind('/');
+	if(slash != string::npos)
+		name = name.substr(slash+1);
+	for(char &c : name)
+		if(c == '"' || c == '<' || c == '>' || c == '&' || isspace(c))
+			c = '_';
+	return name;
+}
+
+MeshExport::MeshExport(const ExportScene &scene) : scene(scene) {
+	file   = NULL;
+	used   = 0;
+	failed = false;
+}
+
+MeshExport::~MeshExport() {
+	if(file)
+		fclose(file);
+}
+
+void MeshExport::flush() {
+	if(used > 0 && fwrite(&buffer[0], 1, used, file) != used)
+		failed = true;
+	used = 0;
+}
+
+void MeshExport::putText(const string &text) {
+	for(char c : text)
+		put(c);
+}
+
+//! \brief the constDirection of a meshrectangle, being the axis along which it is flat
+int MeshExport::direction(long rect) const {
+	// corners 0 and 2 are opposite
+	const double *c = scene.rectCoord + 12*rect;
+	for(int d=0; d<3; d++)
+		if(c[d] == c[6+d])
+			return d;
+	return 0;
+}
+
+void MeshExport::elementCorner(long e, int corner, double *p) const {
+	int bits = hexCorner[corner];
+	for(int d=0; d<3; d++)
+		p[d] = scene.elBox[6*e + ((bits & (1<<d)) ? 3 : 0) + d];
+}
+
+void MeshExport::elementColorBytes(long e, unsigned char *rgb) const {
+	const double *c = scene.elColor(e);
+	for(int j=0; j<3; j++)
+		rgb[j] = (unsigned char) (c[j]*255 + 0.5);
+}
+
+void MeshExport::rectColorBytes(long rect, unsigned char *rgb) const {
+	const double *c = scene.rectColor + 16*rect;
+	for(int j=0; j<3; j++)
+		rgb[j] = (unsigned char) (c[j]*255 + 0.5);
+}
+
+/**********************************************************************************//**
+ * \brief writes the scene, as VTK unstructured grid if the name ends in .vtu and as
+ *        PLY otherwise
+ * \return true if the whole file was written
+ *************************************************************************************/
+bool MeshExport::write(const string &fileName) {
+	// PLY has no 64 bit integers, so its vertex indices must fit in 32 bits
+	bool vtu = fileName.size() >= 4 && fileName.compare(fileName.size()-4, 4, ".vtu") == 0;
+	if(!vtu && 8*scene.nEl + 4*scene.nRect > (long) UINT32_MAX + 1) {
+		cerr << "Too many vertices for \"" << fileName << "\": PLY indices are 32 bit, export to .vtu instead" << endl;
+		return false;
+	}
+	file = fopen(fileName.c_str(), "wb");
+	if(!file) {
+		cerr << "Unable to open \"" << fileName << "\" for writing" << endl;
+		return false;
+	}
+	buffer.resize(bufferSize);
+	used   = 0;
+	failed = false;
+
+	if(vtu)
+		writeVTU();
+	else
+		writePLY();
+	flush();
+	if(fclose(file) != 0)
+		failed = true;
+	file = NULL;
+	buffer.clear();
+	buffer.shrink_to_fit();
+
+	if(failed)
+		cerr << "Error writing \"" << fileName << "\"" << endl;
+	else
+		cout << "Exported " << scene.nEl << " elements and " << scene.nRect << " meshrectangles to " << fileName << endl;
+	return !failed;
+}
+
+/**********************************************************************************//**
+ * \brief VTK XML unstructured grid with all arrays appended as raw binary
+ * The offsets of the appended arrays follow from the item counts, so the header is
+ * written first and the arrays are then generated one after the other.
+ *************************************************************************************/
+void MeshExport::writeVTU() {
+	long nEl    = scene.nEl;
+	long nRect  = scene.nRect;
+	long nPts   = 8*nEl + 4*nRect;
+	long nCells = nEl + nRect;
+	int  nAttr  = scene.attributes.size();
+
+	// byte size of every appended array, in the order they are written
+	vector<uint64_t> bytes;
+	bytes.push_back(nPts*3*sizeof(double));   // points
+	bytes.push_back(nPts*sizeof(int64_t));    // connectivity
+	bytes.push_back(nCells*sizeof(int64_t));  // offsets
+	bytes.push_back(nCells);                  // types
+	bytes.push_back(nCells);                  // constDirection
+	bytes.push_back(nCells);                  // boundary
+	bytes.push_back(nCells*3);                // color
+	for(int a=0; a<nAttr; a++)
+		bytes.push_back(nCells*sizeof(double));
+	vector<uint64_t> offset(1, 0);
+	for(uint64_t b : bytes)
+		offset.push_back(offset.back() + sizeof(uint64_t) + b);
+
+	ostringstream xml;
+	xml << "<?xml version=\"1.0\"?>\n";
+	xml << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\""
+	    << (littleEndian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n";
+	xml << "  <UnstructuredGrid>\n";
+	xml << "    <Piece NumberOfPoints=\"" << nPts << "\" NumberOfCells=\"" << nCells << "\">\n";
+	xml << "      <Points>\n";
+	xml << "        <DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offset[0] << "\"/>\n";
+	xml << "      </Points>\n";
+	xml << "      <Cells>\n";
+	xml << "        <DataArray type=\"Int64\" Name=\"connectivity\" format=\"appended\" offset=\"" << offset[1] << "\"/>\n";
+	xml << "        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\"" << offset[2] << "\"/>\n";
+	xml << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << offset[3] << "\"/>\n";
+	xml << "      </Cells>\n";
+	xml << "      <CellData>\n";
+	xml << "        <DataArray type=\"Int8\" Name=\"constDirection\" format=\"appended\" offset=\"" << offset[4] << "\"/>\n";
+	xml << "        <DataArray type=\"UInt8\" Name=\"boundary\" format=\"appended\" offset=\"" << offset[5] << "\"/>\n";
+	xml << "        <DataArray type=\"UInt8\" Name=\"color\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offset[6] << "\"/>\n";
+	for(int a=0; a<nAttr; a++)
+		xml << "        <DataArray type=\"Float64\" Name=\"" << attributeName(scene.attributes[a])
+		    << "\" format=\"appended\" offset=\"" << offset[7+a] << "\"/>\n";
+	xml << "      </CellData>\n";
+	xml << "    </Piece>\n";
+	xml << "  </UnstructuredGrid>\n";
+	xml << "  <AppendedData encoding=\"raw\">\n   _";
+	putText(xml.str());
+
+	// points
+	put(bytes[0]);
+	double p[3];
+	for(long e=0; e<nEl; e++)
+		for(int c=0; c<8; c++) {
+			elementCorner(e, c, p);
+			put(p[0]);  put(p[1]);  put(p[2]);
+		}
+	for(long i=0; i<nRect*12; i++)
+		put(scene.rectCoord[i]);
+
+	// cells, with the points of every cell numbered consecutively
+	put(bytes[1]);
+	for(int64_t i=0; i<nPts; i++)
+		put(i);
+	put(bytes[2]);
+	for(int64_t e=1; e<=nEl; e++)
+		put(8*e);
+	for(int64_t i=1; i<=nRect; i++)
+		put(8*nEl + 4*i);
+	put(bytes[3]);
+	for(long e=0; e<nEl; e++)
+		put((uint8_t) 12);  // VTK_HEXAHEDRON
+	for(long i=0; i<nRect; i++)
+		put((uint8_t) 9);   // VTK_QUAD
+
+	// cell data
+	put(bytes[4]);
+	for(long e=0; e<nEl; e++)
+		put((int8_t) -1);
+	for(long i=0; i<nRect; i++)
+		put((int8_t) direction(i));
+	put(bytes[5]);
+	for(long e=0; e<nEl; e++)
+		put((uint8_t) (scene.boundary ? scene.boundary[e] : 0));
+	for(long i=0; i<nRect; i++)
+		put((uint8_t) 0);
+	put(bytes[6]);
+	unsigned char rgb[3];
+	for(long e=0; e<nEl; e++) {
+		elementColorBytes(e, rgb);
+		put(rgb[0]);  put(rgb[1]);  put(rgb[2]);
+	}
+	for(long i=0; i<nRect; i++) {
+		rectColorBytes(i, rgb);
+		put(rgb[0]);  put(rgb[1]);  put(rgb[2]);
+	}
+	for(int a=0; a<nAttr; a++) {
+		put(bytes[7+a]);
+		for(long e=0; e<nEl; e++)
+			put(scene.attributes[a]->value(e));
+		for(long i=0; i<nRect; i++)
+			put((double) NAN);
+	}
+	putText("\n  </AppendedData>\n</VTKFile>\n");
+}
+
+/**********************************************************************************//**
+ * \brief binary PLY with the element boxes as 6 faces each and the meshrectangles as
+ *        single faces. Vertex colors are the item colors, other data is per face
+ *************************************************************************************/
+void MeshExport::writePLY() {
+	long nEl   = scene.nEl;
+	long nRect = scene.nRect;
+	int  nAttr = scene.attributes.size();
+
+	ostringstream header;
+	header << "ply\n";
+	header << "format " << (littleEndian() ? "binary_little_endian" : "binary_big_endian") << " 1.0\n";
+	header << "comment LR spline elements and meshrectangles\n";
+	header << "element vertex " << 8*nEl + 4*nRect << "\n";
+	header << "property double x\n";
+	header << "property double y\n";
+	header << "property double z\n";
+	header << "property uchar red\n";
+	header << "property uchar green\n";
+	header << "property uchar blue\n";
+	header << "element face " << 6*nEl + nRect << "\n";
+	header << "property list uchar uint vertex_indices\n";
+	header << "property char const_direction\n";
+	header << "property uchar boundary\n";
+	for(int a=0; a<nAttr; a++)
+		header << "property double " << attributeName(scene.attributes[a]) << "\n";
+	header << "end_header\n";
+	putText(header.str());
+
+	double        p[3];
+	unsigned char rgb[3];
+	for(long e=0; e<nEl; e++) {
+		elementColorBytes(e, rgb);
+		for(int c=0; c<8; c++) {
+			elementCorner(e, c, p);
+			put(p[0]);    put(p[1]);    put(p[2]);
+			put(rgb[0]);  put(rgb[1]);  put(rgb[2]);
+		}
+	}
+	for(long i=0; i<nRect; i++) {
+		rectColorBytes(i, rgb);
+		for(int c=0; c<4; c++) {
+			const double *q = scene.rectCoord + 12*i + 3*c;
+			put(q[0]);    put(q[1]);    put(q[2]);
+			put(rgb[0]);  put(rgb[1]);  put(rgb[2]);
+		}
+	}
+
+	for(long e=0; e<nEl; e++)
+		for(int f=0; f<6; f++) {
+			put((uint8_t) 4);
+			for(int c=0; c<4; c++)
+				put((uint32_t) (8*e + hexFace[f][c]));
+			put((int8_t) -1);
+			put((uint8_t) (scene.boundary ? scene.boundary[e] : 0));
+			for(int a=0; a<nAttr; a++)
+				put(scene.attributes[a]->value(e));
+		}
+	for(long i=0; i<nRect; i++) {
+		put((uint8_t) 4);
+		for(int c=0; c<4; c++)
+			put((uint32_t) (8*nEl + 4*i + c));
+		put((int8_t) direction(i));
+		put((uint8_t) 0);
+		for(int a=0; a<nAttr; a++)
+			put((double) NAN);
+	}
+}
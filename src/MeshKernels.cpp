@@ -0,0 +1,259 @@
+// Viewer headers
+#include "MeshKernels.h"
+#include "Camera.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace std;
+
+// bottom, top, right, left, front and back face, where face f is in normal set f/2
+static const int faceCorner[6][4] = {{0,1,3,2}, {4,5,7,6}, {1,3,7,5}, {0,2,6,4}, {0,1,5,4}, {2,3,7,6}};
+
+//! \brief vertex number of corner c in normal set s of element e, within its chunk
+GLuint ElementLayout::localVertex(long e, int s, int c) const {
+	long first = chunkOf(e)*chunkElements;
+	long size  = min(chunkElements, nEl-first);
+	return s*size*8 + (e-first)*8 + c;
+}
+
+//! \brief vertex number of corner c in normal set s of element e, in the whole buffer
+size_t ElementLayout::globalVertex(long e, int s, int c) const {
+	return (size_t) chunkOf(e)*chunkElements*24 + localVertex(e, s, c);
+}
+
+/**********************************************************************************//**
+ * \brief writes the vertices, normals, colors and indices of element e
+ * \param box the element box (min xyz, max xyz) in scene coordinates
+ * \param rgb color of the element
+ * \param alpha initial opacity
+ *************************************************************************************/
+void tessellateElement(const ElementBuffers &b, long e, const double *box, const double *rgb, double alpha) {
+	double x1 = box[0];
+	double y1 = box[1];
+	double z1 = box[2];
+	double x2 = box[3];
+	double y2 = box[4];
+	double z2 = box[5];
+	double *elCoord  = b.coord;
+	double *elCoord2 = b.coord2;
+
+	size_t first = 3*b.layout.globalVertex(e, 0, 0);
+	size_t k = first;
+	size_t n = first;
+	if(x1<=y1) elCoord[k++] = x1; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z1;
+	if(x2<=y1) elCoord[k++] = x2; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z1;
+	if(x1<=y2) elCoord[k++] = x1; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z1;
+	if(x2<=y2) elCoord[k++] = x2; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z1;
+	if(x1<=y1) elCoord[k++] = x1; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z2;
+	if(x2<=y1) elCoord[k++] = x2; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z2;
+	if(x1<=y2) elCoord[k++] = x1; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z2;
+	if(x2<=y2) elCoord[k++] = x2; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z2;
+
+	if(x1>=y1) elCoord2[n++] = x1; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z1;
+	if(x2>=y1) elCoord2[n++] = x2; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z1;
+	if(x1>=y2) elCoord2[n++] = x1; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z1;
+	if(x2>=y2) elCoord2[n++] = x2; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z1;
+	if(x1>=y1) elCoord2[n++] = x1; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z2;
+	if(x2>=y1) elCoord2[n++] = x2; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z2;
+	if(x1>=y2) elCoord2[n++] = x1; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z2;
+	if(x2>=y2) elCoord2[n++] = x2; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z2;
+
+	// trust me... it's right. Completely unreadable, but right.
+	// the idea is to make 3 sets of complete cube coordinates. Corresponding to
+	// each set is a normal vector pointing in one of the three cardinal directions
+	for(int normalDir=0; normalDir<3; normalDir++) {
+		size_t j = 3*b.layout.globalVertex(e, normalDir, 0);
+		size_t l = 4*b.layout.globalVertex(e, normalDir, 0);
+		if(normalDir > 0) {
+			copy(elCoord  + first, elCoord  + first + 8*3, elCoord  + j);
+			copy(elCoord2 + first, elCoord2 + first + 8*3, elCoord2 + j);
+		}
+		if(normalDir == 0) // up-down normals
+			for(int i=0; i<3*8; i++)
+				b.normal[j++] = -(2*(i>11)-1)*(i%3==2) ;
+		else if(normalDir == 1) // left-right normals
+			for(int i=0; i<3*8; i++)
+				b.normal[j++] = -(2*(i%2)-1)*(i%3==0) ;
+		else if(normalDir == 2) // front-back normals
+			for(int i=0; i<3*8; i++)
+				b.normal[j++] = -((i&2)-1)*(i%3==1) ;
+		// set color
+		for(int component=0; component<8; component++) {
+			b.color[l++] = rgb[0];
+			b.color[l++] = rgb[1];
+			b.color[l++] = rgb[2];
+			b.color[l++] = alpha;
+		}
+	}
+	writeElementIndices(b, e);
+}
+
+/**********************************************************************************//**
+ * \brief writes the line and face indices of element e, local to its chunk
+ *************************************************************************************/
+void writeElementIndices(const ElementBuffers &b, long e) {
+	GLuint *lines = b.lines + (size_t) e*24;
+	GLuint *faces = b.faces + (size_t) e*24;
+	GLuint  v     = b.layout.localVertex(e, 0, 0);
+
+	// bottom lines, top lines and in-between-lines
+	static const int lineCorner[24] = {0,1, 0,2, 1,3, 2,3,  4,5, 4,6, 5,7, 6,7,  0,4, 1,5, 2,6, 3,7};
+	for(int j=0; j<24; j++)
+		lines[j] = v + lineCorner[j];
+
+	// bottom, top, right, left, front and back face
+	for(int f=0; f<6; f++) {
+		GLuint set = b.layout.localVertex(e, f/2, 0);
+		for(int k=0; k<4; k++)
+			faces[4*f+k] = set + faceCorner[f][k];
+	}
+}
+
+//! \brief appends the 6 faces of element e, to be depth sorted by sortFaces()
+void pushElementFaces(const ElementLayout &layout, long e, double *coord, double midTime,
+                      vector<Rect> &out) {
+	size_t ind[4];
+	for(int f=0; f<6; f++) {
+		for(int k=0; k<4; k++)
+			ind[k] = layout.globalVertex(e, f/2, faceCorner[f][k]);
+		Rect r(ind, coord);
+		r.midTime = midTime;
+		r.initI = e;
+		out.push_back(r);
+	}
+}
+
+//! \brief appends meshrectangle i, to be depth sorted by sortFaces()
+void pushRectFace(long i, double *coord, double midTime, vector<Rect> &out) {
+	size_t ind[] = {(size_t) i*4, (size_t) i*4+1, (size_t) i*4+2, (size_t) i*4+3};
+	Rect r(ind, coord);
+	r.midTime = midTime;
+	r.initI = i;
+	out.push_back(r);
+}
+
+/**********************************************************************************//**
+ * \brief starts blinking up to count random elements among the first nEl
+ * Elements already showing or rejected by accept are skipped.
+ * \return the number of elements added
+ *************************************************************************************/
+int spawnElementBlinks(const ElementLayout &layout, long nEl, int count, vector<bool> &showing,
+                       const function<bool(long)> &accept, double *coord, double midTime,
+                       vector<Rect> &out) {
+	if(nEl == 0)
+		return 0;
+	int added = 0;
+	for(int i=0; i<count; i++) {
+		long j = rand() % nEl;
+		if(showing[j] || !accept(j))
+			continue;
+		pushElementFaces(layout, j, coord, midTime, out);
+		showing[j] = true;
+		added++;
+	}
+	return added;
+}
+
+//! \brief as spawnElementBlinks, for meshrectangles
+int spawnRectBlinks(long nRect, int count, vector<bool> &showing,
+                    const function<bool(long)> &accept, double *coord, double midTime,
+                    vector<Rect> &out) {
+	if(nRect == 0)
+		return 0;
+	int added = 0;
+	for(int i=0; i<count; i++) {
+		long j = rand() % nRect;
+		if(showing[j] || !accept(j))
+			continue;
+		pushRectFace(j, coord, midTime, out);
+		showing[j] = true;
+		added++;
+	}
+	return added;
+}
+
+/**********************************************************************************//**
+ * \brief sets the opacity of every blinking face at time mtime, and drops the faces
+ *        whose life is over
+ * \param color the color buffer the faces index into
+ *************************************************************************************/
+void fadeBlinks(vector<Rect> &faces, vector<bool> &showing, double *color, double mtime,
+                const BlinkParams &params) {
+	size_t kept = 0;
+	for(size_t i=0; i<faces.size(); i++) {
+		Rect &r = faces[i];
+		if(fabs(r.midTime - mtime) > params.lifeLength/2.0) {
+			showing[r.initI] = false;
+			continue;
+		}
+		double t2    = (mtime-r.midTime)*(mtime-r.midTime);
+		double alpha = exp(-t2/params.sigma) * (params.maxAlpha-params.minAlpha) + params.minAlpha;
+		for(int j=0; j<4; j++)
+			color[ 4*r.i[j] + 3 ] = alpha;
+		if(kept != i)
+			faces[kept] = r;
+		kept++;
+	}
+	faces.erase(faces.begin() + kept, faces.end());
+}
+
+/**********************************************************************************//**
+ * \brief sorts the faces back to front as seen by cam
+ * Faces are ordered on the distance of their farthest corner, which is computed once
+ * per face.
+ *************************************************************************************/
+void sortFaces(vector<Rect> &faces, Camera &cam) {
+	Go::Point eye = cam.getPos();
+	vector<pair<double, long> > order(faces.size());
+	for(size_t k=0; k<faces.size(); k++) {
+		const Rect &r = faces[k];
+		double far = -1;
+		for(int j=0; j<4; j++) {
+			const double *c = r.coords + 3*r.i[j];
+			double dx = c[0]-eye[0], dy = c[1]-eye[1], dz = c[2]-eye[2];
+			far = max(far, dx*dx + dy*dy + dz*dz);
+		}
+		order[k] = make_pair(-far, (long) k);
+	}
+	sort(order.begin(), order.end());
+	vector<Rect> sorted;
+	sorted.reserve(faces.size());
+	for(pair<double, long> &o : order)
+		sorted.push_back(faces[o.second]);
+	faces.swap(sorted);
+}
+
+/**********************************************************************************//**
+ * \brief copies the corners of the faces of items first to last-1 into small arrays
+ *************************************************************************************/
+void gatherFaces(const vector<Rect> &faces, long first, long last, const double *coord,
+                 const double *normal, const double *color, vector<double> &outCoord,
+                 vector<double> &outNormal, vector<double> &outColor) {
+	outCoord.clear();
+	outNormal.clear();
+	outColor.clear();
+	for(const Rect &r : faces) {
+		if(r.initI < first || r.initI >= last)
+			continue;
+		for(int j=0; j<4; j++) {
+			size_t v = r.i[j];
+			outCoord.insert(outCoord.end(),   coord  + 3*v, coord  + 3*v+3);
+			outNormal.insert(outNormal.end(), normal + 3*v, normal + 3*v+3);
+			outColor.insert(outColor.end(),   color  + 4*v, color  + 4*v+4);
+		}
+	}
+}
+
+//! \brief the vertex indices of the faces of items first to last-1
+void gatherFaceIndices(const vector<Rect> &faces, long first, long last, vector<GLuint> &out) {
+	out.clear();
+	for(const Rect &r : faces) {
+		if(r.initI < first || r.initI >= last)
+			continue;
+		for(int j=0; j<4; j++)
+			out.push_back(r.i[j]);
+	}
+}
@@ -0,0 +1,227 @@
+// Viewer headers
+#include "PointLocator.h"
+#include "Parallel.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+static const long leafSize = 4;
+
+PointLocator::PointLocator() {
+	box = NULL;
+	n   = 0;
+	for(int d=0; d<3; d++)
+		top[d] = 0;
+}
+
+/**********************************************************************************//**
+ * \brief builds the tree
+ * \param box element boxes, 6 values per element (min xyz, max xyz). The pointer is
+ *        kept for the queries and must outlive this object
+ * \param skip elements to leave out where nonzero (i.e. free slots), or NULL
+ * \param domains the box of every patch, 6 values each. Elements are closed at the
+ *        upper end of the patch holding them, or of all elements if this is empty
+ *************************************************************************************/
+void PointLocator::build(const double *box, long nElements, const char *skip, const vector<double> &domains) {
+	this->box = box;
+	n = nElements;
+	nodes.clear();
+	items.clear();
+	closed.clear();
+	long nDomains = domains.size() / 6;
+	if(nDomains > 0) {
+		closed.assign(n, 0);
+		for(long e=0; e<n; e++) {
+			if(skip && skip[e])
+				continue;
+			for(long p=0; p<nDomains; p++) {
+				const double *dom = &domains[6*p];
+				bool inside = true;
+				for(int d=0; d<3; d++) {
+					double c = (box[6*e+d] + box[6*e+3+d]) / 2;
+					inside &= (dom[d] <= c && c <= dom[d+3]);
+				}
+				if(!inside)
+					continue;
+				for(int d=0; d<3; d++)
+					if(box[6*e+3+d] >= dom[d+3])
+						closed[e] |= 1 << d;
+				break;
+			}
+		}
+	}
+	for(long e=0; e<n; e++)
+		if(!skip || !skip[e])
+			items.push_back(e);
+	for(int d=0; d<3; d++)
+		top[d] = -1e300;
+	center.resize(3*n);
+	for(long e : items)
+		for(int d=0; d<3; d++) {
+			center[3*e+d] = (box[6*e+d] + box[6*e+3+d]) / 2;
+			top[d] = max(top[d], box[6*e+3+d]);
+		}
+	if(!items.empty()) {
+		nodes.reserve(2*items.size()/leafSize + 1);
+		buildNode(0, items.size());
+	}
+	vector<double>().swap(center);
+}
+
+//! \brief builds the subtree over items[first,last), returning the index of its root
+long PointLocator::buildNode(long first, long last) {
+	long index = nodes.size();
+	nodes.push_back(Node());
+	Node node;
+	for(int d=0; d<3; d++) {
+		node.lo[d] =  1e300;
+		node.hi[d] = -1e300;
+	}
+	for(long i=first; i<last; i++)
+		for(int d=0; d<3; d++) {
+			node.lo[d] = min(node.lo[d], box[6*items[i]+d]);
+			node.hi[d] = max(node.hi[d], box[6*items[i]+3+d]);
+		}
+	node.first = first;
+	node.count = last - first;
+	node.right = -1;
+	if(last - first > leafSize) {
+		int axis = 0;
+		for(int d=1; d<3; d++)
+			if(node.hi[d]-node.lo[d] > node.hi[axis]-node.lo[axis])
+				axis = d;
+		long mid = first + (last-first)/2;
+		const vector<double> &c = center;
+		nth_element(items.begin()+first, items.begin()+mid, items.begin()+last,
+		            [&c, axis](long a, long b) { return c[3*a+axis] < c[3*b+axis]; });
+		node.count = 0;
+		buildNode(first, mid);
+		node.right = buildNode(mid, last);
+	}
+	nodes[index] = node;
+	return index;
+}
+
+//! \brief true if point is in the half open box of element
+bool PointLocator::contains(long element, const double *point) const {
+	const double *b = box + 6*element;
+	for(int d=0; d<3; d++) {
+		if(point[d] < b[d] || point[d] > b[3+d])
+			return false;
+		bool open = closed.empty() ? (b[3+d] < top[d]) : !(closed[element] & (1 << d));
+		if(point[d] == b[3+d] && open)
+			return false;
+	}
+	return true;
+}
+
+//! \brief the element containing point, or -1 if it is outside the mesh
+long PointLocator::locate(const double *point) const {
+	if(nodes.empty())
+		return -1;
+	for(int d=0; d<3; d++)
+		if(!isfinite(point[d]))
+			return -1;
+	long stack[128];
+	int  size = 0;
+	stack[size++] = 0;
+	while(size > 0) {
+		long i = stack[--size];
+		const Node &node = nodes[i];
+		bool outside = false;
+		for(int d=0; d<3; d++)
+			outside |= point[d] < node.lo[d] || point[d] > node.hi[d];
+		if(outside)
+			continue;
+		if(node.count > 0) {
+			for(long k=node.first; k<node.first+node.count; k++)
+				if(contains(items[k], point))
+					return items[k];
+			continue;
+		}
+		stack[size++] = node.right;
+		stack[size++] = i+1;
+	}
+	return -1;
+}
+
+/**********************************************************************************//**
+ * \brief the elements overlapping a box with some volume, so not just touching it
+ * \param box min xyz, max xyz
+ *************************************************************************************/
+void PointLocator::overlapping(const double *box, vector<long> &elements) const {
+	elements.clear();
+	if(nodes.empty())
+		return;
+	auto apart = [box](const double *lo, const double *hi) {
+		for(int d=0; d<3; d++)
+			if(hi[d] <= box[d] || lo[d] >= box[d+3])
+				return true;
+		return false;
+	};
+	long stack[128];
+	int  size = 0;
+	stack[size++] = 0;
+	while(size > 0) {
+		long i = stack[--size];
+		const Node &node = nodes[i];
+		if(apart(node.lo, node.hi))
+			continue;
+		if(node.count > 0) {
+			for(long k=node.first; k<node.first+node.count; k++) {
+				const double *b = this->box + 6*items[k];
+				if(!apart(b, b+3))
+					elements.push_back(items[k]);
+			}
+			continue;
+		}
+		stack[size++] = node.right;
+		stack[size++] = i+1;
+	}
+}
+
+//! \brief interleaves the low 21 bits of x with two zero bits after each
+static unsigned long long spread(unsigned long long x) {
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x <<  8) & 0x100f00f00f00f00fULL;
+	x = (x | x <<  4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x <<  2) & 0x1249249249249249ULL;
+	return x;
+}
+
+/**********************************************************************************//**
+ * \brief locates a batch of points in parallel
+ * The points are visited in Morton order of their position in the mesh, so that
+ * consecutive queries walk the same part of the tree whatever order they come in.
+ * \param points 3 coordinates per point
+ * \param elements the element of every point, -1 for points outside the mesh
+ *************************************************************************************/
+void PointLocator::locate(const double *points, long nPoints, long *elements) const {
+	if(nodes.empty()) {
+		fill(elements, elements+nPoints, -1L);
+		return;
+	}
+	const Node &root = nodes[0];
+	vector<pair<unsigned long long, long> > order(nPoints);
+	parallelFor(0, nPoints, [&](long begin, long end) {
+		for(long i=begin; i<end; i++) {
+			unsigned long long key = 0;
+			for(int d=0; d<3; d++) {
+				double t = (points[3*i+d] - root.lo[d]) / (root.hi[d] - root.lo[d]);
+				t = !(t >= 0) ? 0 : (t > 1) ? 1 : t;   // NaN to 0, it is not cast
+				key |= spread((unsigned long long) (t * 0x1fffff)) << d;
+			}
+			order[i] = make_pair(key, i);
+		}
+	});
+	sort(order.begin(), order.end());
+	parallelFor(0, nPoints, [&](long begin, long end) {
+		for(long k=begin; k<end; k++)
+			elements[order[k].second] = locate(points + 3*order[k].second);
+	});
+}
@@ -0,0 +1,173 @@
+// framebuffer object entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "Poster.h"
+
+// standard c++ headers
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+
+#ifdef HAS_PNG
+#include <png.h>
+#endif
+
+using namespace std;
+
+Poster::Poster() {
+	fbo      = 0;
+	color    = 0;
+	depth    = 0;
+	tileSize = 2048;
+	width    = 0;
+	file     = NULL;
+	png      = NULL;
+	info     = NULL;
+}
+
+Poster::~Poster() {
+	if(fbo) {
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(1, &color);
+		glDeleteRenderbuffers(1, &depth);
+	}
+	if(file)
+		closeOutput();
+}
+
+//! \brief binds the tileSize x tileSize offscreen target, creating it on first use
+bool Poster::bindTarget() {
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+	if(maxSize > 0 && tileSize > maxSize)
+		tileSize = maxSize;
+	if(fbo == 0) {
+		glGenFramebuffers(1, &fbo);
+		glGenRenderbuffers(1, &color);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, tileSize, tileSize);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, tileSize, tileSize);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depth);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		cerr << "Offscreen tile of " << tileSize << "x" << tileSize << " is incomplete" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Poster::openOutput(const string &fileName, int width, int height) {
+	this->width = width;
+	file = fopen(fileName.c_str(), "wb");
+	if(!file) {
+		cerr << "Unable to open \"" << fileName << "\" for writing" << endl;
+		return false;
+	}
+#ifdef HAS_PNG
+	if(fileName.size() > 4 && fileName.compare(fileName.size()-4, 4, ".png") == 0) {
+		png_structp p = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		png_infop   i = png_create_info_struct(p);
+		png  = p;
+		info = i;
+		if(setjmp(png_jmpbuf(p)))
+			return false;
+		png_init_io(p, file);
+		png_set_IHDR(p, i, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+		             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_write_info(p, i);
+		return true;
+	}
+#endif
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	return true;
+}
+
+//! \brief appends count scanlines, top to bottom
+bool Poster::writeRows(const unsigned char *rgb, int count) {
+#ifdef HAS_PNG
+	if(png) {
+		png_structp p = (png_structp) png;
+		if(setjmp(png_jmpbuf(p)))
+			return false;
+		for(int i=0; i<count; i++)
+			png_write_row(p, (png_bytep) rgb + (size_t) i*width*3);
+		return true;
+	}
+#endif
+	size_t bytes = (size_t) count*width*3;
+	return fwrite(rgb, 1, bytes, file) == bytes;
+}
+
+bool Poster::closeOutput() {
+	bool ok = true;
+#ifdef HAS_PNG
+	if(png) {
+		png_structp p = (png_structp) png;
+		png_infop   i = (png_infop) info;
+		if(setjmp(png_jmpbuf(p)))
+			ok = false;
+		else
+			png_write_end(p, NULL);
+		png_destroy_write_struct(&p, &i);
+		png  = NULL;
+		info = NULL;
+	}
+#endif
+	if(fclose(file) != 0)
+		ok = false;
+	file = NULL;
+	return ok;
+}
+
+/**********************************************************************************//**
+ * \brief renders and writes the image
+ * \param fileName output image
+ * \param width width of the image in pixels
+ * \param height height of the image in pixels
+ * \param drawTile draws the tile (x,y,width,height), counted from the lower left of the
+ *        image, into the lower left corner of the current viewport
+ * \return true if the whole image was written
+ *************************************************************************************/
+bool Poster::render(const string &fileName, int width, int height, DrawTile drawTile) {
+	if(!bindTarget() || !openOutput(fileName, width, height)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if(file)
+			closeOutput();
+		return false;
+	}
+
+	bool ok = true;
+	vector<unsigned char> tile((size_t) tileSize*tileSize*3);
+	vector<unsigned char> row;
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	// the file is written from the top, GL counts from the bottom
+	for(int top=height; top>0 && ok; top-=tileSize) {
+		int y = max(0, top - tileSize);
+		int h = top - y;
+		row.resize((size_t) width*h*3);
+		for(int x=0; x<width; x+=tileSize) {
+			int w = min(tileSize, width - x);
+			drawTile(x, y, w, h);
+			glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, &tile[0]);
+			for(int j=0; j<h; j++)
+				memcpy(&row[((size_t) (h-1-j)*width + x)*3], &tile[(size_t) j*w*3], (size_t) w*3);
+		}
+		ok = writeRows(&row[0], h);
+		cout << "Poster: " << (height-y) * 100 / height << "%\r" << flush;
+	}
+	cout << endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if(!closeOutput())
+		ok = false;
+	if(ok)
+		cout << "Wrote " << width << "x" << height << " poster to " << fileName << endl;
+	else
+		cerr << "Error writing poster \"" << fileName << "\"" << endl;
+	return ok;
+}
@@ -0,0 +1,362 @@
+// framebuffer object entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "RemoteView.h"
+
+// standard c++ headers
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+static const uint32_t frameMagic = 0x4c524656;  // "LRFV"
+static const int      eventSize  = 6*sizeof(int32_t);
+
+enum Encoding {
+	ENCODE_RLE  = 0,
+	ENCODE_ZLIB = 1
+};
+
+//! \brief writes all bytes, returns false if the connection is gone
+static bool sendAll(int fd, const void *data, size_t bytes) {
+	const char *p = (const char*) data;
+	while(bytes > 0) {
+		ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+		if(n <= 0)
+			return false;
+		p     += n;
+		bytes -= n;
+	}
+	return true;
+}
+
+//! \brief reads exactly the given number of bytes, returns false if the connection is gone
+static bool recvAll(int fd, void *data, size_t bytes) {
+	char *p = (char*) data;
+	while(bytes > 0) {
+		ssize_t n = recv(fd, p, bytes, 0);
+		if(n <= 0)
+			return false;
+		p     += n;
+		bytes -= n;
+	}
+	return true;
+}
+
+static void push16(vector<unsigned char> &out, size_t v) {
+	out.push_back(v & 0xff);
+	out.push_back(v >> 8);
+}
+
+/**********************************************************************************//**
+ * \brief run-length encodes a frame difference
+ * The stream is a sequence of (zero count, literal count, literals) with 16 bit
+ * little-endian counts. Unchanged pixels XOR to zero and vanish in the zero runs.
+ *************************************************************************************/
+static void encodeRLE(const unsigned char *in, size_t n, vector<unsigned char> &out) {
+	out.clear();
+	size_t i = 0;
+	while(i < n) {
+		size_t zeros = 0;
+		while(i+zeros < n && in[i+zeros] == 0 && zeros < 65535)
+			zeros++;
+		i += zeros;
+		// literals run until the next pair of zeros
+		size_t lits = 0;
+		while(i+lits < n && lits < 65535 && !(in[i+lits] == 0 && i+lits+1 < n && in[i+lits+1] == 0))
+			lits++;
+		push16(out, zeros);
+		push16(out, lits);
+		out.insert(out.end(), in+i, in+i+lits);
+		i += lits;
+	}
+}
+
+//! \brief applies a run-length encoded frame difference to frame
+static bool decodeRLE(const vector<unsigned char> &in, vector<unsigned char> &frame) {
+	size_t pos = 0;
+	size_t p   = 0;
+	while(p+4 <= in.size()) {
+		size_t zeros = in[p] | (in[p+1] << 8);
+		size_t lits  = in[p+2] | (in[p+3] << 8);
+		p   += 4;
+		pos += zeros;
+		if(pos + lits > frame.size() || p + lits > in.size())
+			return false;
+		for(size_t j=0; j<lits; j++)
+			frame[pos++] ^= in[p++];
+	}
+	return true;
+}
+
+FrameServer::FrameServer() {
+	server = -1;
+	client = -1;
+	fbo    = 0;
+	color  = 0;
+	depth  = 0;
+	width  = 0;
+	height = 0;
+}
+
+FrameServer::~FrameServer() {
+	disconnect();
+	if(server >= 0)
+		close(server);
+}
+
+/**********************************************************************************//**
+ * \brief opens the listening socket. Clients are accepted in poll()
+ * \param port TCP port
+ * \param address local address to listen on. The default only accepts clients on this
+ *        host (i.e. through an ssh tunnel); 0.0.0.0 or :: accepts anyone who can reach it
+ *************************************************************************************/
+bool FrameServer::listen(int port, const string &address) {
+	struct addrinfo hints, *result;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags    = AI_PASSIVE;
+	string service = to_string(port);
+	if(getaddrinfo(address.c_str(), service.c_str(), &hints, &result) != 0) {
+		cerr << "Unable to resolve \"" << address << "\"" << endl;
+		return false;
+	}
+	for(struct addrinfo *a = result; a != NULL; a = a->ai_next) {
+		server = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if(server < 0)
+			continue;
+		int yes = 1;
+		setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if(bind(server, a->ai_addr, a->ai_addrlen) == 0 && ::listen(server, 1) == 0)
+			break;
+		close(server);
+		server = -1;
+	}
+	freeaddrinfo(result);
+	if(server < 0) {
+		cerr << "Unable to listen on " << address << ":" << port << endl;
+		return false;
+	}
+	fcntl(server, F_SETFL, O_NONBLOCK);
+	return true;
+}
+
+void FrameServer::disconnect() {
+	if(client >= 0)
+		close(client);
+	client = -1;
+	input.clear();
+	previous.clear();
+}
+
+/**********************************************************************************//**
+ * \brief accepts a waiting client and reads whatever input has arrived, without blocking
+ * \return true if a new client was just connected
+ *************************************************************************************/
+bool FrameServer::poll() {
+	bool accepted = false;
+	if(client < 0 && server >= 0) {
+		client = accept(server, NULL, NULL);
+		if(client < 0)
+			return false;
+		int yes = 1;
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+		previous.clear();
+		accepted = true;
+	}
+
+	unsigned char buffer[4096];
+	while(client >= 0) {
+		ssize_t n = recv(client, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if(n > 0) {
+			input.insert(input.end(), buffer, buffer+n);
+			continue;
+		}
+		if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+			disconnect();
+		break;
+	}
+	return accepted;
+}
+
+//! \brief pops the next complete event sent by the client
+bool FrameServer::nextEvent(RemoteEvent &ev) {
+	if(input.size() < (size_t) eventSize)
+		return false;
+	int32_t v[6];
+	memcpy(v, &input[0], eventSize);
+	input.erase(input.begin(), input.begin()+eventSize);
+	ev.type = ntohl(v[0]);
+	ev.a    = ntohl(v[1]);
+	ev.b    = ntohl(v[2]);
+	ev.c    = ntohl(v[3]);
+	ev.d    = ntohl(v[4]);
+	ev.e    = ntohl(v[5]);
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief directs rendering to the offscreen target, (re)allocating it on size changes
+ *************************************************************************************/
+void FrameServer::bindTarget(int width, int height) {
+	if(fbo == 0) {
+		glGenFramebuffers(1, &fbo);
+		glGenRenderbuffers(1, &color);
+		glGenRenderbuffers(1, &depth);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	if(width == this->width && height == this->height)
+		return;
+
+	this->width  = width;
+	this->height = height;
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depth);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		cerr << "Offscreen framebuffer of " << width << "x" << height << " is incomplete" << endl;
+	previous.clear();
+}
+
+/**********************************************************************************//**
+ * \brief reads back the rendered frame and sends it as a compressed difference
+ *************************************************************************************/
+void FrameServer::sendFrame() {
+	if(client < 0 || width <= 0 || height <= 0)
+		return;
+	size_t n = (size_t) width*height*3;
+	pixels.resize(n);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	// turn previous into the difference, and keep this frame for the next one
+	if(previous.size() != n)
+		previous.assign(n, 0);
+	for(size_t i=0; i<n; i++)
+		previous[i] ^= pixels[i];
+
+	uint32_t encoding = ENCODE_RLE;
+#ifdef HAS_ZLIB
+	uLongf packed = compressBound(n);
+	packet.resize(packed);
+	if(compress2(&packet[0], &packed, &previous[0], n, 1) == Z_OK) {
+		packet.resize(packed);
+		encoding = ENCODE_ZLIB;
+	} else
+#endif
+	encodeRLE(&previous[0], n, packet);
+	previous.swap(pixels);
+
+	uint32_t header[] = {htonl(frameMagic), htonl(width), htonl(height), htonl(encoding), htonl(packet.size())};
+	if(!sendAll(client, header, sizeof(header)) || !sendAll(client, &packet[0], packet.size())) {
+		cerr << "Client disconnected" << endl;
+		disconnect();
+	}
+}
+
+FrameClient::FrameClient() {
+	socket = -1;
+}
+
+FrameClient::~FrameClient() {
+	if(socket >= 0)
+		close(socket);
+}
+
+bool FrameClient::connect(const string &host, int port) {
+	struct addrinfo hints, *result;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	string service = to_string(port);
+	if(getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0) {
+		cerr << "Unable to resolve \"" << host << "\"" << endl;
+		return false;
+	}
+	for(struct addrinfo *a = result; a != NULL; a = a->ai_next) {
+		socket = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if(socket < 0)
+			continue;
+		if(::connect(socket, a->ai_addr, a->ai_addrlen) == 0)
+			break;
+		close(socket);
+		socket = -1;
+	}
+	freeaddrinfo(result);
+	if(socket < 0) {
+		cerr << "Unable to connect to " << host << ":" << port << endl;
+		return false;
+	}
+	int yes = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief waits for the next frame and applies it
+ * \param rgb the previous frame on input, which is updated in place
+ * \return false if the connection is closed or the stream is corrupt
+ *************************************************************************************/
+bool FrameClient::receiveFrame(vector<unsigned char> &rgb, int &width, int &height) {
+	uint32_t header[5];
+	if(!recvAll(socket, header, sizeof(header)) || ntohl(header[0]) != frameMagic)
+		return false;
+	int      w        = ntohl(header[1]);
+	int      h        = ntohl(header[2]);
+	uint32_t encoding = ntohl(header[3]);
+	packet.resize(ntohl(header[4]));
+	if(!packet.empty() && !recvAll(socket, &packet[0], packet.size()))
+		return false;
+
+	// the server starts over from a black frame whenever the size changes
+	size_t n = (size_t) w*h*3;
+	if(w != width || h != height || rgb.size() != n)
+		rgb.assign(n, 0);
+	width  = w;
+	height = h;
+
+	if(encoding == ENCODE_RLE)
+		return decodeRLE(packet, rgb);
+#ifdef HAS_ZLIB
+	if(encoding == ENCODE_ZLIB) {
+		uLongf size = n;
+		delta.resize(n);
+		if(uncompress(&delta[0], &size, &packet[0], packet.size()) != Z_OK || size != n)
+			return false;
+		for(size_t i=0; i<n; i++)
+			rgb[i] ^= delta[i];
+		return true;
+	}
+#endif
+	cerr << "Unsupported frame encoding " << encoding << endl;
+	return false;
+}
+
+void FrameClient::sendEvent(const RemoteEvent &ev) {
+	int32_t v[] = {(int32_t) htonl(ev.type), (int32_t) htonl(ev.a), (int32_t) htonl(ev.b),
+	               (int32_t) htonl(ev.c),    (int32_t) htonl(ev.d), (int32_t) htonl(ev.e)};
+	sendAll(socket, v, sizeof(v));
+}
+
+//! \brief ends the connection, so that a blocked receiveFrame() returns false
+void FrameClient::shutdown() {
+	if(socket >= 0)
+		::shutdown(socket, SHUT_RDWR);
+}
@@ -0,0 +1,328 @@
+// buffer object and shader entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "RenderBackend.h"
+
+// standard c++ headers
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+//! \brief the backend called name ("legacy" or "shader"), or NULL if there is none
+RenderBackend *RenderBackend::create(const string &name) {
+	if(name == "legacy")
+		return new LegacyBackend();
+	if(name == "shader")
+		return new ShaderBackend();
+	return NULL;
+}
+
+void LegacyBackend::beginFrame() {
+	// the background pass has changed lighting and depth testing behind the cache
+	state.invalidate();
+	state.clientState(GL_VERTEX_ARRAY, true);
+}
+
+void LegacyBackend::setPass(const RenderPass &p, GLfloat lineScale) {
+	bool outline = p.edge && edges.ready();
+	state.useProgram(outline ? edges.id() : 0);
+	state.enable(GL_POLYGON_OFFSET_FILL, outline);
+	state.clientState(GL_TEXTURE_COORD_ARRAY, outline);
+	if(outline) {
+		state.texCoordPointer(p.edge);
+		edges.setUniforms(p.lighting, p.edgeRgb, p.lineWidth * lineScale);
+	}
+	state.enable(GL_LIGHTING,   p.lighting);
+	state.enable(GL_DEPTH_TEST, p.depthTest);
+	state.enable(GL_BLEND,      p.blend);
+	state.clientState(GL_NORMAL_ARRAY, p.normal != NULL);
+	state.clientState(GL_COLOR_ARRAY,  p.color  != NULL);
+	state.vertexPointer(p.vertex);
+	if(p.normal)
+		state.normalPointer(p.normal);
+	if(p.color)
+		state.colorPointer(p.color);
+	else
+		glColor3fv(p.rgb);
+	if(p.lineWidth > 0)
+		state.lineWidth(p.lineWidth * lineScale);
+}
+
+void LegacyBackend::bindArrays(const GLvoid *vertex, const GLvoid *normal, const GLvoid *color) {
+	state.vertexPointer(vertex);
+	if(normal)
+		state.normalPointer(normal);
+	if(color)
+		state.colorPointer(color);
+}
+
+void LegacyBackend::endFrame() {
+	// the rest of the frame is drawn by the fixed function pipeline
+	state.useProgram(0);
+	state.enable(GL_BLEND, true);
+	state.enable(GL_POLYGON_OFFSET_FILL, false);
+	state.clientState(GL_TEXTURE_COORD_ARRAY, false);
+}
+
+void LegacyBackend::report(ostream &out) const {
+	out << "GL state changes: " << state.issued() << " issued, " << state.skipped() << " skipped" << endl;
+}
+
+// generic attribute locations
+enum { POSITION, NORMAL, COLOR, CORNER };
+
+static const char *vertexSource =
+	"#version 130\n"
+	"uniform mat4 modelViewProjection;\n"
+	"uniform mat4 modelView;\n"
+	"uniform mat3 normalMatrix;\n"
+	"uniform bool lighting;\n"
+	"uniform bool colorArray;\n"
+	"uniform vec4 flatColor;\n"
+	"uniform vec4 ambient;\n"
+	"uniform vec4 lightPosition[2];\n"
+	"uniform vec4 lightDiffuse[2];\n"
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"in vec3 corner;\n"
+	"out vec3 edgeCoord;\n"
+	"out vec4 shade;\n"
+	"void main() {\n"
+	"	vec4 p = vec4(position, 1.0);\n"
+	"	gl_Position = modelViewProjection * p;\n"
+	"	edgeCoord = corner;\n"
+	"	shade = colorArray ? color : flatColor;\n"
+	"	if(lighting) {\n"
+	"		vec3 n   = normalize(normalMatrix * normal);\n"
+	"		vec3 e   = vec3(modelView * p);\n"
+	"		vec3 lit = ambient.rgb * shade.rgb;\n"
+	"		for(int i=0; i<2; i++) {\n"
+	"			vec3 l = normalize(lightPosition[i].xyz - e*lightPosition[i].w);\n"
+	"			lit += shade.rgb * lightDiffuse[i].rgb * max(dot(n, l), 0.0);\n"
+	"		}\n"
+	"		shade.rgb = min(lit, vec3(1.0));\n"
+	"	}\n"
+	"}\n";
+
+static const char *fragmentSource =
+	"#version 130\n"
+	"uniform bool  outline;\n"
+	"uniform vec3  edgeColor;\n"
+	"uniform float edgeWidth;\n"
+	"in vec3 edgeCoord;\n"
+	"in vec4 shade;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	fragColor = shade;\n"
+	"	if(outline) {\n"
+	"		vec3 w = fwidth(edgeCoord);\n"
+	"		vec3 d = min(edgeCoord, 1.0-edgeCoord) / max(w, vec3(1e-12));\n"
+	"		d += 1e12 * (1.0 - step(1e-12, w));\n"
+	"		float dist = min(min(d.x, d.y), d.z);\n"
+	"		float edge = clamp(0.5*edgeWidth + 0.5 - dist, 0.0, 1.0);\n"
+	"		fragColor.rgb = mix(shade.rgb, edgeColor, edge);\n"
+	"	}\n"
+	"}\n";
+
+ShaderBackend::ShaderBackend() {
+	program     = 0;
+	bufferBytes = 0;
+	for(int i=0; i<16; i++)
+		modelView[i] = projection[i] = (i%5 == 0);
+	GLfloat none[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	setLights(none, none, none);
+}
+
+bool ShaderBackend::init() {
+	if(program)
+		return true;
+	program = buildProgram("Shader renderer", vertexSource, fragmentSource, [](GLuint p) {
+		glBindAttribLocation(p, POSITION, "position");
+		glBindAttribLocation(p, NORMAL,   "normal");
+		glBindAttribLocation(p, COLOR,    "color");
+		glBindAttribLocation(p, CORNER,   "corner");
+		glBindFragDataLocation(p, 0, "fragColor");
+	});
+	if(!program)
+		return false;
+	mvpLoc           = glGetUniformLocation(program, "modelViewProjection");
+	modelViewLoc     = glGetUniformLocation(program, "modelView");
+	normalMatrixLoc  = glGetUniformLocation(program, "normalMatrix");
+	lightingLoc      = glGetUniformLocation(program, "lighting");
+	colorArrayLoc    = glGetUniformLocation(program, "colorArray");
+	flatColorLoc     = glGetUniformLocation(program, "flatColor");
+	ambientLoc       = glGetUniformLocation(program, "ambient");
+	lightPositionLoc = glGetUniformLocation(program, "lightPosition");
+	lightDiffuseLoc  = glGetUniformLocation(program, "lightDiffuse");
+	outlineLoc       = glGetUniformLocation(program, "outline");
+	edgeColorLoc     = glGetUniformLocation(program, "edgeColor");
+	edgeWidthLoc     = glGetUniformLocation(program, "edgeWidth");
+	return true;
+}
+
+void ShaderBackend::setView(const GLdouble *modelView, const GLdouble *projection) {
+	copy(modelView,  modelView+16,  this->modelView);
+	copy(projection, projection+16, this->projection);
+}
+
+void ShaderBackend::setLights(const GLfloat *ambient, const GLfloat *position, const GLfloat *diffuse) {
+	copy(ambient,  ambient+4,  this->ambient);
+	copy(position, position+8, lightPosition);
+	copy(diffuse,  diffuse+8,  lightDiffuse);
+}
+
+/**********************************************************************************//**
+ * \brief binds the program and uploads the matrices and lights given by Camera
+ *************************************************************************************/
+void ShaderBackend::beginFrame() {
+	const GLfloat *mv = modelView;
+	GLfloat mvp[16], normal[9];
+	for(int c=0; c<4; c++)
+		for(int r=0; r<4; r++) {
+			mvp[4*c+r] = 0;
+			for(int k=0; k<4; k++)
+				mvp[4*c+r] += projection[4*k+r] * mv[4*c+k];
+		}
+	// inverse transpose of the upper 3x3 modelview: the cofactors over the determinant
+	for(int c=0; c<3; c++)
+		for(int r=0; r<3; r++) {
+			int c1 = (c+1)%3, c2 = (c+2)%3;
+			int r1 = (r+1)%3, r2 = (r+2)%3;
+			normal[3*c+r] = mv[4*c1+r1]*mv[4*c2+r2] - mv[4*c2+r1]*mv[4*c1+r2];
+		}
+	GLfloat det = mv[0]*normal[0] + mv[4]*normal[3] + mv[8]*normal[6];
+	for(int i=0; i<9; i++)
+		normal[i] /= det;
+
+	// the background pass has changed state behind the cache. Nothing of the fixed
+	// function state is used by the passes
+	state.invalidate();
+	state.enable(GL_LIGHTING, false);
+	state.clientState(GL_VERTEX_ARRAY,        false);
+	state.clientState(GL_NORMAL_ARRAY,        false);
+	state.clientState(GL_COLOR_ARRAY,         false);
+	state.clientState(GL_TEXTURE_COORD_ARRAY, false);
+
+	state.useProgram(program);
+	glUniformMatrix4fv(mvpLoc,          1, GL_FALSE, mvp);
+	glUniformMatrix4fv(modelViewLoc,    1, GL_FALSE, mv);
+	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normal);
+	glUniform4fv(ambientLoc,       1, ambient);
+	glUniform4fv(lightPositionLoc, 2, lightPosition);
+	glUniform4fv(lightDiffuseLoc,  2, lightDiffuse);
+	state.attribArray(POSITION, true);
+}
+
+//! \brief points attribute index at data, in its buffer object if it is kept there
+void ShaderBackend::attribute(GLuint index, GLint size, GLenum type, const GLvoid *data) {
+	const char *p = (const char*) data;
+	map<const char*, Buffer>::iterator it = buffers.upper_bound(p);
+	if(it != buffers.begin() && p < (--it)->first + it->second.bytes)
+		state.attribPointer(index, size, type, it->second.id, (const GLvoid*) (p - it->first));
+	else
+		state.attribPointer(index, size, type, 0, data);
+}
+
+void ShaderBackend::setPass(const RenderPass &p, GLfloat lineScale) {
+	state.enable(GL_DEPTH_TEST, p.depthTest);
+	state.enable(GL_BLEND,      p.blend);
+	state.uniform(lightingLoc, p.lighting);
+	attribute(POSITION, 3, GL_DOUBLE, p.vertex);
+	state.attribArray(NORMAL, p.normal != NULL);
+	if(p.normal)
+		attribute(NORMAL, 3, GL_DOUBLE, p.normal);
+	state.uniform(colorArrayLoc, p.color != NULL);
+	state.attribArray(COLOR, p.color != NULL);
+	if(p.color) {
+		attribute(COLOR, 4, GL_DOUBLE, p.color);
+	} else {
+		GLfloat flat[] = {p.rgb[0], p.rgb[1], p.rgb[2], 1.0f};
+		state.uniform(flatColorLoc, 4, flat);
+	}
+	state.uniform(outlineLoc, p.edge != NULL);
+	state.attribArray(CORNER, p.edge != NULL);
+	state.enable(GL_POLYGON_OFFSET_FILL, p.edge != NULL);
+	if(p.edge) {
+		GLfloat width = p.lineWidth * lineScale;
+		attribute(CORNER, 3, GL_SHORT, p.edge);
+		state.uniform(edgeColorLoc, 3, p.edgeRgb);
+		state.uniform(edgeWidthLoc, 1, &width);
+	}
+	if(p.lineWidth > 0)
+		state.lineWidth(p.lineWidth * lineScale);
+}
+
+void ShaderBackend::bindArrays(const GLvoid *vertex, const GLvoid *normal, const GLvoid *color) {
+	attribute(POSITION, 3, GL_DOUBLE, vertex);
+	if(normal)
+		attribute(NORMAL, 3, GL_DOUBLE, normal);
+	if(color)
+		attribute(COLOR, 4, GL_DOUBLE, color);
+}
+
+void ShaderBackend::endFrame() {
+	// the rest of the frame is drawn by the fixed function pipeline
+	for(GLuint i=POSITION; i<=CORNER; i++)
+		state.attribArray(i, false);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	state.enable(GL_POLYGON_OFFSET_FILL, false);
+	state.enable(GL_BLEND, true);
+	state.useProgram(0);
+	state.clientState(GL_VERTEX_ARRAY, true);
+}
+
+bool ShaderBackend::keepArray(const GLvoid *data, size_t bytes) {
+	const char *p = (const char*) data;
+	map<const char*, Buffer>::iterator it = buffers.find(p);
+	if(it != buffers.end() && it->second.bytes == bytes) {
+		glBindBuffer(GL_ARRAY_BUFFER, it->second.id);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return true;
+	}
+	if(it != buffers.end()) {
+		glDeleteBuffers(1, &it->second.id);
+		bufferBytes -= it->second.bytes;
+		buffers.erase(it);
+	}
+	// errors left over from before, so that only those of the upload are seen
+	while(glGetError() != GL_NO_ERROR)
+		;
+	Buffer b;
+	b.bytes = bytes;
+	glGenBuffers(1, &b.id);
+	glBindBuffer(GL_ARRAY_BUFFER, b.id);
+	glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if(glGetError() == GL_OUT_OF_MEMORY) {
+		glDeleteBuffers(1, &b.id);
+		return false;
+	}
+	buffers[p]   = b;
+	bufferBytes += bytes;
+	return true;
+}
+
+void ShaderBackend::updateArray(const GLvoid *data, size_t offset, size_t bytes) {
+	map<const char*, Buffer>::iterator it = buffers.find((const char*) data);
+	if(it == buffers.end() || offset + bytes > it->second.bytes)
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, it->second.id);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, (const char*) data + offset);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ShaderBackend::releaseArrays() {
+	for(auto &b : buffers)
+		glDeleteBuffers(1, &b.second.id);
+	buffers.clear();
+	bufferBytes = 0;
+}
+
+void ShaderBackend::report(ostream &out) const {
+	out << "Buffer objects: " << buffers.size() << " (" << bufferBytes << " bytes)" << endl;
+	out << "GL state changes: " << state.issued() << " issued, " << state.skipped() << " skipped" << endl;
+}
@@ -0,0 +1,208 @@
+// shader entry points
+#define GL_GLEXT_PROTOTYPES
+
+// Viewer headers
+#include "RenderPass.h"
+#include "RenderBackend.h"
+
+// standard c++ headers
+#include <algorithm>
+
+using namespace std;
+
+StateCache::StateCache() {
+	nIssued  = 0;
+	nSkipped = 0;
+	invalidate();
+}
+
+void StateCache::invalidate() {
+	caps.clear();
+	arrays.clear();
+	attribs.clear();
+	pointers.clear();
+	uniforms.clear();
+	arrayBuffer = -1;
+	vertex = NULL;
+	normal = NULL;
+	color  = NULL;
+	texCoord = NULL;
+	program  = -1;
+	width  = -1;
+}
+
+//! \brief counts the call and returns true if it has to be sent to GL
+bool StateCache::changed(bool same) {
+	if(same)
+		nSkipped++;
+	else
+		nIssued++;
+	return !same;
+}
+
+void StateCache::enable(GLenum cap, bool on) {
+	map<GLenum,bool>::iterator it = caps.find(cap);
+	if(!changed(it != caps.end() && it->second == on))
+		return;
+	caps[cap] = on;
+	if(on)
+		glEnable(cap);
+	else
+		glDisable(cap);
+}
+
+void StateCache::clientState(GLenum array, bool on) {
+	map<GLenum,bool>::iterator it = arrays.find(array);
+	if(!changed(it != arrays.end() && it->second == on))
+		return;
+	arrays[array] = on;
+	if(on)
+		glEnableClientState(array);
+	else
+		glDisableClientState(array);
+}
+
+void StateCache::vertexPointer(const GLvoid *coord) {
+	if(!changed(coord == vertex))
+		return;
+	vertex = coord;
+	glVertexPointer(3, GL_DOUBLE, 0, coord);
+}
+
+void StateCache::normalPointer(const GLvoid *normal) {
+	if(!changed(normal == this->normal))
+		return;
+	this->normal = normal;
+	glNormalPointer(GL_DOUBLE, 0, normal);
+}
+
+void StateCache::colorPointer(const GLvoid *color) {
+	if(!changed(color == this->color))
+		return;
+	this->color = color;
+	glColorPointer(4, GL_DOUBLE, 0, color);
+}
+
+void StateCache::texCoordPointer(const GLvoid *coord) {
+	if(!changed(coord == texCoord))
+		return;
+	texCoord = coord;
+	glTexCoordPointer(3, GL_SHORT, 0, coord);
+}
+
+void StateCache::useProgram(GLuint program) {
+	if(!changed(this->program == (GLint) program))
+		return;
+	this->program = program;
+	uniforms.clear();
+	glUseProgram(program);
+}
+
+void StateCache::lineWidth(GLfloat width) {
+	if(!changed(width == this->width))
+		return;
+	this->width = width;
+	glLineWidth(width);
+}
+
+void StateCache::attribArray(GLuint index, bool on) {
+	map<GLuint,bool>::iterator it = attribs.find(index);
+	if(!changed(it != attribs.end() && it->second == on))
+		return;
+	attribs[index] = on;
+	if(on)
+		glEnableVertexAttribArray(index);
+	else
+		glDisableVertexAttribArray(index);
+}
+
+//! \brief points a generic attribute at data, an offset into buffer if that is not 0
+void StateCache::attribPointer(GLuint index, GLint size, GLenum type, GLuint buffer, const GLvoid *data) {
+	map<GLuint,Attrib>::iterator it = pointers.find(index);
+	if(!changed(it != pointers.end() && it->second.buffer == buffer && it->second.data == data))
+		return;
+	Attrib a = {buffer, data};
+	pointers[index] = a;
+	if(arrayBuffer != (GLint) buffer) {
+		arrayBuffer = buffer;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	}
+	glVertexAttribPointer(index, size, type, GL_FALSE, 0, data);
+}
+
+void StateCache::uniform(GLint location, GLint value) {
+	GLfloat v = value;
+	map<GLint,vector<GLfloat> >::iterator it = uniforms.find(location);
+	if(!changed(it != uniforms.end() && it->second.size() == 1 && it->second[0] == v))
+		return;
+	uniforms[location].assign(1, v);
+	glUniform1i(location, value);
+}
+
+//! \brief sets a float, vec3 or vec4 uniform of the program in use
+void StateCache::uniform(GLint location, int n, const GLfloat *value) {
+	map<GLint,vector<GLfloat> >::iterator it = uniforms.find(location);
+	if(!changed(it != uniforms.end() && it->second.size() == (size_t) n &&
+	               equal(value, value+n, it->second.begin())))
+		return;
+	uniforms[location].assign(value, value+n);
+	if(n == 1)
+		glUniform1fv(location, 1, value);
+	else if(n == 3)
+		glUniform3fv(location, 1, value);
+	else
+		glUniform4fv(location, 1, value);
+}
+
+RenderPass::RenderPass(const char *name, int phase, const GLvoid *vertex) {
+	this->name   = name;
+	this->phase  = phase;
+	this->vertex = vertex;
+	clearDepth   = false;
+	lighting     = false;
+	depthTest    = true;
+	blend        = true;
+	normal       = NULL;
+	color        = NULL;
+	edge         = NULL;
+	rgb[0]       = 0;
+	rgb[1]       = 0;
+	rgb[2]       = 0;
+	edgeRgb[0]   = 0;
+	edgeRgb[1]   = 0;
+	edgeRgb[2]   = 0;
+	lineWidth    = 0;
+}
+
+//! \brief orders passes on phase first, and then on the cost of switching between them
+static bool passLess(const RenderPass &a, const RenderPass &b) {
+	if(a.phase != b.phase)                  return a.phase < b.phase;
+	if((a.edge==NULL) != (b.edge==NULL))     return a.edge != NULL;
+	if(a.lighting != b.lighting)            return a.lighting < b.lighting;
+	if(a.depthTest != b.depthTest)          return a.depthTest < b.depthTest;
+	if(a.blend != b.blend)                  return a.blend < b.blend;
+	if((a.normal==NULL) != (b.normal==NULL)) return a.normal == NULL;
+	if((a.color==NULL)  != (b.color==NULL))  return a.color  == NULL;
+	if(a.vertex != b.vertex)                return a.vertex < b.vertex;
+	return a.lineWidth < b.lineWidth;
+}
+
+/**********************************************************************************//**
+ * \brief draws all passes through backend, in phase and state order
+ *************************************************************************************/
+void RenderQueue::execute(RenderBackend &backend) {
+	stable_sort(passes.begin(), passes.end(), passLess);
+	backend.beginFrame();
+	for(RenderPass &p : passes) {
+		if(p.clearDepth)
+			glClear(GL_DEPTH_BUFFER_BIT);
+		if(!p.draw)
+			continue;
+		GLfloat scale = lineScale;
+		if(maxLineWidth > 0 && p.lineWidth*scale > maxLineWidth)
+			scale = maxLineWidth / p.lineWidth;
+		backend.setPass(p, scale);
+		p.draw();
+	}
+	backend.endFrame();
+}
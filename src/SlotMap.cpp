@@ -0,0 +1,74 @@
+// Viewer headers
+#include "SlotMap.h"
+
+using namespace std;
+
+SlotMap::SlotMap() {
+	nSlots = 0;
+}
+
+//! \brief puts item k in slot k
+void SlotMap::assign(const vector<const void*> &keys) {
+	nSlots = keys.size();
+	byKey.clear();
+	freeList.clear();
+	freeSlot.assign(nSlots, 0);
+	slotOf.resize(nSlots);
+	for(long k=0; k<nSlots; k++) {
+		byKey[keys[k]] = k;
+		slotOf[k]      = k;
+	}
+}
+
+/**********************************************************************************//**
+ * \brief matches the current items against the previous ones
+ * \param keys the current items
+ * \param added slots given to items which were not there before (reused or new)
+ * \param freed slots of items which are gone, and which were not reused
+ *************************************************************************************/
+void SlotMap::update(const vector<const void*> &keys, vector<long> &added, vector<long> &freed) {
+	added.clear();
+	freed.clear();
+
+	// the items still there keep their slot, the rest is freed
+	unordered_map<const void*, long> next;
+	next.reserve(keys.size());
+	slotOf.assign(keys.size(), -1);
+	vector<long> newItems;
+	for(long k=0; k<(long) keys.size(); k++) {
+		auto it = byKey.find(keys[k]);
+		if(it == byKey.end()) {
+			newItems.push_back(k);
+			continue;
+		}
+		slotOf[k] = it->second;
+		next[keys[k]] = it->second;
+		byKey.erase(it);
+	}
+	vector<long> gone;
+	for(auto &item : byKey) {
+		gone.push_back(item.second);
+		freeList.push_back(item.second);
+		freeSlot[item.second] = 1;
+	}
+
+	// new items fill the freed slots first
+	for(long k : newItems) {
+		long s;
+		if(!freeList.empty()) {
+			s = freeList.back();
+			freeList.pop_back();
+			freeSlot[s] = 0;
+		} else {
+			s = nSlots++;
+			freeSlot.push_back(0);
+		}
+		slotOf[k] = s;
+		next[keys[k]] = s;
+		added.push_back(s);
+	}
+	for(long s : gone)
+		if(freeSlot[s])
+			freed.push_back(s);
+	byKey.swap(next);
+}
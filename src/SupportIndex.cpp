@@ -0,0 +1,97 @@
+// Viewer headers
+#include "SupportIndex.h"
+#include "Parallel.h"
+
+// LR spline headers
+#include "LRSpline/LRSplineVolume.h"
+#include "LRSpline/Element.h"
+#include "LRSpline/Basisfunction.h"
+
+// standard c++ headers
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+using namespace LR;
+
+SupportIndex::SupportIndex() {
+	elOffset.assign(1, 0);
+	basisOffset.assign(1, 0);
+}
+
+/**********************************************************************************//**
+ * \brief builds both directions of the incidence
+ * The element rows are gathered straight from the element supports and the basis
+ * rows by a parallel counting transpose of those. All rows are sorted.
+ * \param patches the LR splines in scene order
+ * \param slots if given, element k (in scene order) is numbered slots[k]
+ * \param nSlots the number of element numbers when slots are given
+ *************************************************************************************/
+void SupportIndex::build(const vector<LRSplineVolume*> &patches, const vector<long> *slots, long nSlots) {
+	vector<Element*> elements;
+	vector<int>      firstBasis;  // global number of basis function 0 in the element's patch
+	int nB = 0;
+	for(LRSplineVolume *lr : patches) {
+		for(Element *el : lr->getAllElements()) {
+			elements.push_back(el);
+			firstBasis.push_back(nB);
+		}
+		nB += lr->nBasisFunctions();
+	}
+	if(slots) {
+		vector<Element*> bySlot(nSlots, NULL);
+		vector<int>      firstBySlot(nSlots, 0);
+		for(size_t k=0; k<elements.size(); k++) {
+			bySlot[(*slots)[k]]      = elements[k];
+			firstBySlot[(*slots)[k]] = firstBasis[k];
+		}
+		elements.swap(bySlot);
+		firstBasis.swap(firstBySlot);
+	}
+	long nE = elements.size();
+
+	// element -> basis functions
+	elOffset.assign(nE+1, 0);
+	parallelFor(0, nE, [&](long begin, long end) {
+		for(long e=begin; e<end; e++)
+			elOffset[e+1] = (elements[e]) ? elements[e]->nBasisFunctions() : 0;
+	});
+	for(long e=0; e<nE; e++)
+		elOffset[e+1] += elOffset[e];
+	elBasis.resize(elOffset[nE]);
+	parallelFor(0, nE, [&](long begin, long end) {
+		for(long e=begin; e<end; e++) {
+			long j = elOffset[e];
+			if(!elements[e])
+				continue;
+			for(Basisfunction *b : elements[e]->support())
+				elBasis[j++] = firstBasis[e] + b->getId();
+			sort(elBasis.begin()+elOffset[e], elBasis.begin()+j);
+		}
+	});
+
+	// basis function -> elements, by transposing the above
+	unique_ptr<atomic<long>[]> cursor(new atomic<long>[nB+1]);
+	for(int b=0; b<=nB; b++)
+		cursor[b] = 0;
+	parallelFor(0, elBasis.size(), [&](long begin, long end) {
+		for(long j=begin; j<end; j++)
+			cursor[elBasis[j]+1].fetch_add(1, memory_order_relaxed);
+	});
+	basisOffset.assign(nB+1, 0);
+	for(int b=0; b<nB; b++) {
+		basisOffset[b+1] = basisOffset[b] + cursor[b+1];
+		cursor[b] = basisOffset[b];
+	}
+	basisEl.resize(basisOffset[nB]);
+	parallelFor(0, nE, [&](long begin, long end) {
+		for(long e=begin; e<end; e++)
+			for(long j=elOffset[e]; j<elOffset[e+1]; j++)
+				basisEl[cursor[elBasis[j]].fetch_add(1, memory_order_relaxed)] = e;
+	});
+	parallelFor(0, nB, [&](long begin, long end) {
+		for(long b=begin; b<end; b++)
+			sort(basisEl.begin()+basisOffset[b], basisEl.begin()+basisOffset[b+1]);
+	});
+}
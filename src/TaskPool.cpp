@@ -0,0 +1,191 @@
+// Viewer headers
+#include "TaskPool.h"
+
+// standard c++ headers
+#include <algorithm>
+
+using namespace std;
+
+// the queue of the pool worker running on this thread, -1 on other threads
+static thread_local int workerIndex = -1;
+
+//! \brief the pool of the application. Never destroyed, as detached threads may use it until exit
+TaskPool &TaskPool::shared() {
+	static TaskPool *pool = new TaskPool();
+	return *pool;
+}
+
+TaskPool::TaskPool() : queued(0) {
+	nThreads = max(1u, thread::hardware_concurrency());
+	stopping = false;
+	start();
+}
+
+TaskPool::~TaskPool() {
+	stop();
+}
+
+/**********************************************************************************//**
+ * \brief sets the number of threads working at once, including the thread waiting for
+ *        the work. Call while no tasks are queued or running
+ *************************************************************************************/
+void TaskPool::setThreads(int threads) {
+	stop();
+	nThreads = max(1, threads);
+	start();
+}
+
+void TaskPool::start() {
+	lock_guard<mutex> guard(startLock);
+	int nWorkers = nThreads - 1;
+	queues.clear();
+	for(int i=0; i<=nWorkers; i++)
+		queues.push_back(unique_ptr<Queue>(new Queue()));
+	for(int i=0; i<nWorkers; i++)
+		workers.push_back(thread(&TaskPool::workerLoop, this, i));
+}
+
+void TaskPool::stop() {
+	lock_guard<mutex> guard(startLock);
+	{
+		lock_guard<mutex> lock(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(thread &w : workers)
+		w.join();
+	workers.clear();
+	stopping = false;
+}
+
+void TaskPool::submit(const Task &task, TaskGroup *group) {
+	group->pending++;
+	group->queued++;
+	Queue &q = (workerIndex >= 0) ? *queues[workerIndex] : *queues.back();
+	{
+		lock_guard<mutex> lock(q.lock);
+		Item item = {task, group};
+		q.items.push_back(item);
+	}
+	queued++;
+	{
+		lock_guard<mutex> lock(sleepLock);
+	}
+	wake.notify_all();
+}
+
+//! \brief takes a task from q, only of the given group unless it is NULL
+bool TaskPool::take(Queue &q, bool back, const TaskGroup *only, Item &out) {
+	lock_guard<mutex> lock(q.lock);
+	if(q.items.empty())
+		return false;
+	if(only == NULL) {
+		if(back) {
+			out = q.items.back();
+			q.items.pop_back();
+		} else {
+			out = q.items.front();
+			q.items.pop_front();
+		}
+	} else {
+		auto it = find_if(q.items.begin(), q.items.end(), [only](const Item &i) { return i.group == only; });
+		if(it == q.items.end())
+			return false;
+		out = *it;
+		q.items.erase(it);
+	}
+	queued--;
+	out.group->queued--;
+	return true;
+}
+
+/**********************************************************************************//**
+ * \brief runs one queued task: from the own queue of worker index if there is one,
+ *        else stolen from the others
+ * \return false if no task was found
+ *************************************************************************************/
+bool TaskPool::runOne(int index, const TaskGroup *only) {
+	Item item;
+	bool found = (index >= 0) && take(*queues[index], true, only, item);
+	int  n     = queues.size();
+	for(int i=1; i<=n && !found; i++)
+		found = take(*queues[(max(index, 0) + i) % n], false, only, item);
+	if(!found)
+		return false;
+	item.task();
+	finished(item.group);
+	return true;
+}
+
+void TaskPool::finished(TaskGroup *group) {
+	// the waiting thread may destroy the group as soon as pending reaches zero
+	if(--group->pending == 0) {
+		lock_guard<mutex> lock(sleepLock);
+		wake.notify_all();
+	}
+}
+
+//! \brief returns when every task of group is done, running queued tasks meanwhile
+void TaskPool::wait(TaskGroup *group) {
+	int index = workerIndex;
+	const TaskGroup *only = (index >= 0) ? NULL : group;
+	while(group->pending > 0) {
+		if(runOne(index, only))
+			continue;
+		unique_lock<mutex> lock(sleepLock);
+		wake.wait(lock, [&]() {
+			return group->pending == 0 || ((only == NULL) ? queued > 0 : group->queued > 0);
+		});
+	}
+}
+
+void TaskPool::workerLoop(int index) {
+	workerIndex = index;
+	while(true) {
+		if(runOne(index, NULL))
+			continue;
+		unique_lock<mutex> lock(sleepLock);
+		wake.wait(lock, [&]() { return stopping || queued > 0; });
+		if(stopping && queued == 0)
+			return;
+	}
+}
+
+TaskGroup::TaskGroup(TaskPool &pool) : pool(pool), pending(0), queued(0) {
+}
+
+/**********************************************************************************//**
+ * \brief adds a task to be run once all tasks in after are done
+ * \return the node to name when adding tasks that depend on this one
+ *************************************************************************************/
+TaskGraph::Node TaskGraph::add(const TaskPool::Task &task, initializer_list<Node> after) {
+	Node n = items.size();
+	Item item;
+	item.task         = task;
+	item.dependencies = after.size();
+	items.push_back(item);
+	for(Node a : after)
+		items[a].next.push_back(n);
+	return n;
+}
+
+//! \brief runs all tasks, returning when they are done
+void TaskGraph::run() {
+	remaining.reset(new atomic<int>[items.size()]);
+	for(size_t i=0; i<items.size(); i++)
+		remaining[i] = items[i].dependencies;
+	TaskGroup group(pool);
+	for(size_t i=0; i<items.size(); i++)
+		if(items[i].dependencies == 0)
+			start(i, group);
+	group.wait();
+}
+
+void TaskGraph::start(Node n, TaskGroup &group) {
+	group.run([this, n, &group]() {
+		items[n].task();
+		for(Node m : items[n].next)
+			if(--remaining[m] == 0)
+				start(m, group);
+	});
+}
@@ -1,4 +1,7 @@
 
+// multi-draw entry points
+#define GL_GLEXT_PROTOTYPES
+
 // standard c++ headers
 #include <iostream>
 #include <stdlib.h>
@@ -7,7 +10,15 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <string.h>
 #include <sys/time.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <unistd.h>
+#include <sstream>
+#include <deque>
+#include <sys/stat.h>
 
 // LR spline headers
 #include "LRSpline/LRSplineVolume.h"
@@ -18,6 +29,26 @@
 // ViewLR headers
 #include "Camera.h"
 #include "Rect.h"
+#include "IntervalTree.h"
+#include "Arena.h"
+#include "FrameCapture.h"
+#include "FaceAdjacency.h"
+#include "SupportIndex.h"
+#include "BrickStore.h"
+#include "RenderPass.h"
+#include "AdaptiveQuality.h"
+#include "Attribute.h"
+#include "Parallel.h"
+#include "TaskPool.h"
+#include "RemoteView.h"
+#include "MeshExport.h"
+#include "Poster.h"
+#include "MeshKernels.h"
+#include "DensityMap.h"
+#include "SlotMap.h"
+#include "RenderBackend.h"
+#include "PointLocator.h"
+#include "MeshCheck.h"
 
 // openGL headers
 #include <GL/glut.h>
@@ -71,18 +102,39 @@ double lifeLength  = 4.0;
 double min_alpha   = 0.0;
 double max_alpha   = 1.0;
 
+// frame capture
+FrameCapture capture;
+string captureTarget = "capture%05d.png";
+FILE  *statusFile    = stdout;   // stderr when the video goes to stdout
+double captureFps    = 30;
+long   captureFrames = 0;    // quit after this many frames, 0 runs until stopped
+bool   captureAtStart = false;
+double captureStart  = 0.0;  // animation time when the capture started
+
+// tiled rendering of images beyond the framebuffer size
+Poster poster;
+string posterFile    = "poster.png";
+int    posterWidth   = 16384;
+bool   posterAtStart = false;   // render once the mesh is loaded, then quit
+
+// remote rendering: serve frames to a thin client, or be one
+FrameServer server;
+int    servePort = 0;     // 0 when not serving
+string serveAddress = "127.0.0.1";
+string connectTo;         // host:port of the server when running as a client
+
+// memory management
+Arena arena;
+bool showStats    = false;
+bool releaseModel = false;
+string exportFile;    // write the mesh here and quit instead of opening a window
+
 // data buffers
-int nRect, nEl, nRectX, nRectY, nRectZ;
+long nRect, nEl;
 GLuint *elLines;
 GLuint *elFaces;
 GLuint *rectLines;
-GLuint *rectLinesX;
-GLuint *rectLinesY;
-GLuint *rectLinesZ;
 GLuint *rectFaces;
-GLuint *rectFacesX;
-GLuint *rectFacesY;
-GLuint *rectFacesZ;
 double *rectCoord;
 double *rectNormal;
 double *rectColor;
@@ -90,25 +142,662 @@ double *elCoord;
 double *elCoord2;
 double *elNormal;
 double *elColor;
-vector<GLuint> shellEl;
-vector<GLuint> sparseEl;
 vector<GLuint> sparseRect;
+vector<long> rectSource;      // index of each meshrectangle in getAllMeshRectangles() over all patches
+vector<double> blinkCoord;    // corners of the blinking element faces, back to front
+vector<double> blinkNormal;
+vector<double> blinkColor;
 vector<bool> showingElement;
 vector<bool> showingRectangle;
 
+// elements are stored in chunks (see ElementLayout). Draws move the array pointers to
+// each chunk in turn
+ElementLayout elLayout;
+const long chunkElements = ElementLayout::chunkElements;
+const long maxDrawCount  = 1<<30;   // indices per range handed to a single draw
+
+//! \brief the chunk holding element e
+long chunkOf(long e) {
+	return ElementLayout::chunkOf(e);
+}
+
+//! \brief vertex number of corner c in normal set s of element e, within its chunk
+GLuint localVertex(long e, int s, int c) {
+	return elLayout.localVertex(e, s, c);
+}
+
+//! \brief vertex number of corner c in normal set s of element e, in the whole buffer
+size_t globalVertex(long e, int s, int c) {
+	return elLayout.globalVertex(e, s, c);
+}
+
+//! \brief the element buffers, as handed to the tessellation kernels
+ElementBuffers elementBuffers() {
+	ElementBuffers b = {elLayout, elCoord, elCoord2, elNormal, elColor, elLines, elFaces};
+	return b;
+}
+
+// multi-patch scene. All patches share the buffers below, stacked along z
+struct Range {
+	long begin;
+	long end;
+};
+struct Patch {
+	LRSplineVolume *lr;
+	double offset;        // z-translation of the patch in the scene
+	double bbMin[3];
+	double bbMax[3];
+	Range  el;            // elements
+	Range  rect;          // meshrectangles
+	Range  rectAxis[3];   // meshrectangles with constDirection 0, 1, 2 (sub-ranges of rect)
+	Range  shell;         // indices in shellEl.index
+};
+vector<Patch> patches;
+vector<bool>  patchVisible;
+
+// draws the render passes, fixed function or with buffers and shaders (--renderer)
+RenderBackend *backend      = NULL;
+string         rendererName = "legacy";
+bool           buffersKept  = false;   // the large arrays have been handed to the backend
+
+// index ranges from all visible patches, drawn in a single call (per element chunk)
+struct DrawList {
+	vector<GLsizei>       count;
+	vector<const GLvoid*> first;
+	vector<long>          chunk;   // element chunk of each range, 0 for meshrectangles
+
+	void clear() {
+		count.clear();
+		first.clear();
+		chunk.clear();
+	}
+	void add(const GLuint *indices, size_t n, long c = 0) {
+		while(n > 0) {
+			GLsizei m = min(n, (size_t) maxDrawCount);
+			if(!count.empty() && chunk.back() == c && count.back() + m <= maxDrawCount &&
+			   (const GLuint*) first.back() + count.back() == indices) {
+				count.back() += m;
+			} else {
+				count.push_back(m);
+				first.push_back(indices);
+				chunk.push_back(c);
+			}
+			indices += m;
+			n       -= m;
+		}
+	}
+	void draw(GLenum mode) const {
+		if(!count.empty())
+			glMultiDrawElements(mode, &count[0], GL_UNSIGNED_INT, &first[0], count.size());
+	}
+
+	/**********************************************************************************//**
+	 * \brief draws element ranges, with the arrays pointing to the chunk of each run
+	 * \param vertex the element coordinates
+	 * \param normal the element normals, or NULL if the normal array is not in use
+	 * \param color the element colors, or NULL if the color array is not in use
+	 *************************************************************************************/
+	void draw(GLenum mode, const double *vertex, const double *normal, const double *color = NULL) const {
+		for(size_t i=0, j=0; i<count.size(); i=j) {
+			while(j < count.size() && chunk[j] == chunk[i])
+				j++;
+			size_t base = (size_t) chunk[i]*chunkElements*24;
+			backend->bindArrays(vertex + 3*base, normal ? normal + 3*base : NULL, color ? color + 4*base : NULL);
+			glMultiDrawElements(mode, &count[i], GL_UNSIGNED_INT, &first[i], j-i);
+		}
+		// leave the arrays where the pass has put them
+		backend->bindArrays(vertex, normal, color);
+	}
+};
+DrawList batch;
+
+// element face quads in element order, and where the quads of each chunk begin
+struct QuadList {
+	vector<GLuint> index;
+	vector<size_t> chunkStart;   // the quads of chunk c begin at index[chunkStart[c]]
+
+	void clear() {
+		index.clear();
+		chunkStart.clear();
+	}
+	size_t size() const {
+		return index.size();
+	}
+	//! \brief to be called when all quads are pushed
+	void finish() {
+		chunkStart.resize(chunkOf(nEl-1) + 2, index.size());
+	}
+	void push(long element, const GLuint *quad) {
+		for(long c=chunkStart.size(); c<=chunkOf(element); c++)
+			chunkStart.push_back(index.size());
+		index.insert(index.end(), quad, quad+4);
+	}
+	//! \brief adds the quads begin to end, split where they cross into the next chunk
+	void addTo(DrawList &list, size_t begin, size_t end) const {
+		long c = upper_bound(chunkStart.begin(), chunkStart.end(), begin) - chunkStart.begin() - 1;
+		while(begin < end) {
+			size_t next = min(end, chunkStart[c+1]);
+			list.add(&index[begin], next-begin, c);
+			begin = next;
+			c++;
+		}
+	}
+};
+QuadList shellEl;
+
+// the passes of the current frame, and what GL state they have set
+RenderQueue passes;
+
+// faces drawn together with their outlines by a shader, instead of as faces and lines
+bool            edgeShading = false;
+vector<GLshort> elEdge;     // box corner of the element vertices, repeating every 8
+vector<GLshort> rectEdge;   // box corner of the meshrectangle vertices, repeating every 4
+
+// side by side views of the same buffers. Linked views share one camera
+struct Viewport {
+	Camera *camera;
+	int     patch;            // only draw this patch, -1 for all of them
+	double  x0, y0, x1, y1;   // placement as fractions of the window, from the lower left
+	Camera  view;             // camera placed in the viewport, see placeCamera()
+};
+vector<Viewport> viewports;
+Camera           orthoCam[3];
+string           layout     = "single";
+int              activeView = 0;       // viewport receiving the mouse drag
+
+// external per-element data coloring the elements and filtering the solid view
+vector<string>     attributeFiles;
+vector<Attribute*> attributes;
+int    currentAttribute = -1;   // -1 for the random colors
+double filterLo         = 0.0;  // shown part of the attribute range, as fractions
+double filterHi         = 1.0;
+
+// cheaper rendering while the view is moved, with a decimated wireframe on request
+AdaptiveQuality quality;
+vector<GLuint>  coarseElLines;    // lines of every coarseStride-th element
+vector<GLuint>  coarseRectLines;  // lines of every coarseStride-th meshrectangle
+int             coarseStride = 1;
+
+// slicing (sliceAxis = -1 is off, otherwise the normal of the slice plane)
+int    sliceAxis   = -1;
+double slicePos    = 0.5;
+double sliceWidth  = 0.0;    // zero gives plane cross-sections, otherwise a slab
+bool   dragSlice   = false;
+int    lastDragY   = 0;
+double domainMin[3];
+double domainMax[3];
+double *elBox;               // raw parametric element boxes (min xyz, max xyz)
+IntervalTree elTree[3];
+IntervalTree rectTree[3];
+vector<long>   sliceHits;
+vector<double> sliceCoord;
+vector<double> sliceNormal;
+vector<double> sliceColor;
+vector<GLuint> sliceFaces;
+vector<GLuint> sliceLines;
+QuadList       sliceShell;   // exposed faces of the slab, drawn in solid mode
+vector<char>   sliceMask;
+
+// overview of large meshes: the elements projected along an axis onto a color mapped
+// grid, drawn instead of the mesh (overviewMode -1 is off, otherwise a DensityMap::Mode)
+DensityMap     densityMaps[3];          // one per axis, so an orbiting view switches without rebuilds
+bool           densityDirty[3] = {true, true, true};
+int            overviewMode   = -1;
+int            overviewAxis   = -1;     // parametric axis, -1 follows the view direction
+int            overviewSize   = 512;    // cells along each side
+bool           overviewDirty  = true;   // the elements have changed since the last build
+bool           overviewRaised = false;  // the grid is drawn as a heightfield
+int            overviewShown  = -1;     // the axis of the grid geometry
+vector<double> overviewCoord;
+vector<double> overviewColor;
+vector<GLuint> overviewQuads;
+
+// element face adjacency, used to find exposed faces of any element subset
+FaceAdjacency adjacency;
+
+// basis function support highlighting (-1 is no selection)
+SupportIndex support;
+int      selectedBasis   = -1;
+long     selectedElement = -1;
+DrawList highlightFaces;
+DrawList highlightLines;
+
+// batch point location (--locate). The located elements are highlighted with 'l'
+PointLocator locator;
+bool         locatorDirty = true;   // the elements have changed since the last build
+string       locateFile;            // "x y z [patch]" per line, "-" for stdin
+string       locateOut;             // write the element of every point here and quit
+vector<long> located;               // elements holding at least one point
+bool         showLocated = false;
+bool         highlightPending = false;   // found while loading, shown once the mesh is up
+
+// mesh consistency check (--check). The offending items are highlighted with 'i'
+MeshCheck      meshCheck;
+bool           checkAtLoad = false;
+bool           checkDirty  = true;   // the mesh has changed since the last check
+bool           showCheck   = false;
+vector<GLuint> checkRectLines;       // outlines of the dangling meshrectangles
+
+// live refinement of a single patch. Buffer slots outlive the refinement steps, and
+// slots of removed items are collapsed (dead) until they are handed out again
+bool         refineMode = false;
+SlotMap      elSlots;
+SlotMap      rectSlots;
+long         elCapacity   = 0;   // allocated slots
+long         rectCapacity = 0;
+vector<char> deadEl;
+vector<char> deadRect;
+vector<long> rectAt;                 // slot drawn by each item of the meshrectangle index buffers
+vector<long> rectPos;                // and the item drawing each slot
+bool         adjacencyDirty = false; // the indices below are rebuilt when next used
+bool         treeDirty[3]   = {false, false, false};
+bool         supportDirty   = false;
+
+// out-of-core mode, streaming bricks from disk
+BrickStore bricks;
+bool   outOfCore   = false;
+string brickFile;
+size_t brickBudget = 512;  // MB
+
+// progressive loading. The loader thread publishes its progress through these
+enum LoadStage {
+	LOAD_PARSING,   // nothing to show yet
+	LOAD_BUILDING,  // domain known, buffers filling up to elReady/rectReady
+	LOAD_DONE       // everything built
+};
+atomic<int> loadStage(LOAD_PARSING);
+thread      *loader = NULL;        // never destroyed, so other exits do not need to join it
+atomic<bool> loadCancel(false);      // asks the loader to stop at the next item chunk
+atomic<long> elReady(0);
+atomic<long> rectReady(0);
+const long   loadChunk   = 4096;
+bool         cameraReady = false;
+
 // debug stuff
 bool printed_err  = false;
 
+//! \brief true when the complete in-memory buffers are available
+bool meshReady() {
+	return !outOfCore && loadStage.load(memory_order_acquire) == LOAD_DONE;
+}
 
-void drawScene() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+/**********************************************************************************//**
+ * \brief stops the loader thread and exits, so the buffers are not torn down under it
+ * A file being parsed can not be interrupted. The loader only ever touches the
+ * buffers after parsing, so then the process ends without running the destructors.
+ *************************************************************************************/
+void quit(int code) {
+	loadCancel.store(true);
+	if(loader && loader->joinable()) {
+		if(loadStage.load(memory_order_acquire) == LOAD_PARSING) {
+			cout.flush();
+			fflush(NULL);
+			_exit(code);
+		}
+		loader->join();
+	}
+	exit(code);
+}
 
-	glEnableClientState(GL_VERTEX_ARRAY);
+//! \brief the part of the item range r which has been published
+Range readyPart(Range r, long ready) {
+	r.end   = min(r.end, ready);
+	r.begin = min(r.begin, r.end);
+	return r;
+}
+
+
+/**********************************************************************************//**
+ * \brief draws one index buffer over all visible patches as a single multi-draw
+ * \param mode primitive type
+ * \param indices the index buffer, laid out as perItem indices per item
+ * \param perItem number of indices per element/meshrectangle
+ * \param rangeOf gives the item range in the index buffer belonging to a patch
+ *************************************************************************************/
+template<class RangeOf>
+void drawBatched(GLenum mode, const GLuint *indices, int perItem, RangeOf rangeOf) {
+	batch.clear();
+	for(uint p=0; p<patches.size(); p++) {
+		if(!patchVisible[p])
+			continue;
+		Range r = rangeOf(patches[p]);
+		batch.add(indices + r.begin*perItem, (r.end-r.begin)*perItem);
+	}
+	batch.draw(mode);
+}
+
+/**********************************************************************************//**
+ * \brief as drawBatched, for index buffers over the element vertices
+ * \param stride item k of the index buffer belongs to element k*stride
+ * \param vertex the element coordinates
+ * \param normal the element normals, or NULL
+ *************************************************************************************/
+template<class RangeOf>
+void drawChunked(GLenum mode, const GLuint *indices, int perItem, int stride, RangeOf rangeOf,
+                 const double *vertex, const double *normal) {
+	batch.clear();
+	for(uint p=0; p<patches.size(); p++) {
+		if(!patchVisible[p])
+			continue;
+		Range r = rangeOf(patches[p]);
+		for(long k=r.begin; k<r.end; ) {
+			long c    = chunkOf(k*stride);
+			long next = min(r.end, ((c+1)*chunkElements + stride-1) / stride);
+			batch.add(indices + k*perItem, (next-k)*perItem, c);
+			k = next;
+		}
+	}
+	batch.draw(mode, vertex, normal);
+}
+
+/**********************************************************************************//**
+ * \brief arranges the viewports
+ * \param name "single" for one perspective view, "quad" for the perspective view next
+ *        to orthographic views along x, y and z, or "compare" for linked perspective
+ *        views with one patch each
+ *************************************************************************************/
+void setLayout(const string &name) {
+	viewports.clear();
+	if(name == "quad") {
+		Viewport quad[] = {{&cam,         -1, 0.5, 0.5, 1.0, 1.0},
+		                   {&orthoCam[2], -1, 0.0, 0.5, 0.5, 1.0},
+		                   {&orthoCam[1], -1, 0.0, 0.0, 0.5, 0.5},
+		                   {&orthoCam[0], -1, 0.5, 0.0, 1.0, 0.5}};
+		viewports.assign(quad, quad+4);
+	} else if(name == "compare" && patches.size() > 1) {
+		int n = patches.size();
+		for(int p=0; p<n; p++) {
+			Viewport v = {&cam, p, (double) p/n, 0.0, (double) (p+1)/n, 1.0};
+			viewports.push_back(v);
+		}
+	} else {
+		Viewport single = {&cam, -1, 0.0, 0.0, 1.0, 1.0};
+		viewports.push_back(single);
+	}
+	layout     = name;
+	activeView = 0;
+}
+
+/**********************************************************************************//**
+ * \brief updates the camera of a viewport for this frame
+ * Placed in the viewport, and for patch views moved to the patch so that linked
+ * views see their patches from the same spot. It lives in the viewport, so anything
+ * holding on to it stays valid until the layout changes.
+ *************************************************************************************/
+Camera &placeCamera(Viewport &v) {
+	v.view = *v.camera;
+	int x = v.x0*window_width;
+	int y = v.y0*window_height;
+	v.view.handleResize(x, y, (int) (v.x1*window_width) - x, (int) (v.y1*window_height) - y);
+	if(v.patch > 0)
+		v.view.translate(0, 0, patches[v.patch].bbMin[2] - patches[0].bbMin[2]);
+	return v.view;
+}
+
+//! \brief index of the viewport under a GLUT window position
+int viewportAt(int x, int y) {
+	for(uint i=0; i<viewports.size(); i++)
+		if(placeCamera(viewports[i]).contains(x, y, window_height))
+			return i;
+	return 0;
+}
+
+//! \brief points the camera at the scene domain, once it is known
+void initCamera() {
+	double size = 0;
+	for(int d=0; d<3; d++)
+		size = max(size, domainMax[d]-domainMin[d]);
+	cam_dist *= size;
+	cam.setPos(cam_dist,phi,theta);
+	cam.setLookAt((domainMin[0]+domainMax[0])/2.0,
+	              (domainMin[1]+domainMax[1])/2.0,
+	              (domainMin[2]+domainMax[2])/2.0);
+	for(int d=0; d<3; d++) {
+		orthoCam[d].setOrthographic(d);
+		orthoCam[d].setLookAt((domainMin[0]+domainMax[0])/2.0,
+		                      (domainMin[1]+domainMax[1])/2.0,
+		                      (domainMin[2]+domainMax[2])/2.0);
+		orthoCam[d].setPos(cam_dist, phi, theta);
+	}
+	setLayout(layout);
+	cameraReady = true;
+}
+
+//! \brief the items of range r (of the full mesh) in the buffers decimated by stride
+Range coarseRange(Range r, int stride) {
+	r.begin = (r.begin + stride-1) / stride;
+	r.end   = (r.end   + stride-1) / stride;
+	return r;
+}
+
+/**********************************************************************************//**
+ * \brief rebuilds the decimated wireframes if the stride has changed
+ * Keeps every stride-th element and meshrectangle, so the patch ranges map through
+ * coarseRange()
+ *************************************************************************************/
+void updateCoarseLines(int stride) {
+	if(stride == coarseStride)
+		return;
+	coarseStride = stride;
+	coarseElLines.clear();
+	coarseRectLines.clear();
+	for(long i=0; i<nEl; i+=stride)
+		coarseElLines.insert(coarseElLines.end(), elLines + i*24, elLines + (i+1)*24);
+	for(long i=0; i<nRect; i+=stride)
+		coarseRectLines.insert(coarseRectLines.end(), rectLines + i*8, rectLines + (i+1)*8);
+}
+
+//! \brief draws the outline of the scene domain
+void drawDomainBox() {
+	glLineWidth(1);
+	glColor3d(0.5, 0.5, 0.5);
+	glBegin(GL_LINES);
+	for(int c=0; c<8; c++)
+		for(int d=0; d<3; d++) {
+			if(c & (1<<d))
+				continue;
+			int c2 = c | (1<<d);
+			glVertex3d((c &1) ? domainMax[0] : domainMin[0], (c &2) ? domainMax[1] : domainMin[1], (c &4) ? domainMax[2] : domainMin[2]);
+			glVertex3d((c2&1) ? domainMax[0] : domainMin[0], (c2&2) ? domainMax[1] : domainMin[1], (c2&4) ? domainMax[2] : domainMin[2]);
+		}
+	glEnd();
+}
+
+void makeSparseIndices(int patch) {
+	Range el   = {0, nEl};
+	Range rect = {0, nRect};
+	// the meshrectangle slots of a refined patch are not in index order
+	if(patch >= 0 && !refineMode) {
+		el   = patches[patch].el;
+		rect = patches[patch].rect;
+	}
+	// the few blinking element faces are copied out, as they may come from any chunk
+	gatherFaces(viewEl, el.begin, el.end, elCoord, elNormal, elColor, blinkCoord, blinkNormal, blinkColor);
+	gatherFaceIndices(viewRect, rect.begin, rect.end, sparseRect);
+}
+
+/**********************************************************************************//**
+ * \brief extends the edge shader corner arrays to cover the vertex buffers
+ * The element corners only need to cover one chunk, as the draw calls of every chunk
+ * start at a multiple of 8 vertices.
+ *************************************************************************************/
+void updateEdgeCoords() {
+	size_t nE = (size_t) min(elLayout.nEl, chunkElements)*8*3;
+	for(size_t v=elEdge.size()/3; v<nE; v++)
+		for(int d=0; d<3; d++)
+			elEdge.push_back((v%8 >> d) & 1);
+	// meshrectangle corners go around the rectangle, with the last coordinate unused
+	static const GLshort corner[4][3] = {{0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}};
+	for(size_t v=rectEdge.size()/3; v<(size_t) nRect*4; v++)
+		rectEdge.insert(rectEdge.end(), corner[v%4], corner[v%4]+3);
+}
+
+/**********************************************************************************//**
+ * \brief sorts the blinking faces back to front as seen by view and rebuilds their indices
+ * \param view the camera of the viewport about to be drawn
+ * \param patch only keep faces of this patch, -1 for all
+ *************************************************************************************/
+void sortBlinks(Camera &view, int patch) {
+	TaskGroup sorting;
+	sorting.run([&view]() { sortFaces(viewEl,   view); });
+	sorting.run([&view]() { sortFaces(viewRect, view); });
+	sorting.wait();
+	makeSparseIndices(patch);
+}
+
+//! \brief blue-cyan-green-yellow-red color of t in [0,1]
+void colormap(double t, double *rgb) {
+	t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+	rgb[0] = min(max(4*t - 2, 0.0), 1.0);
+	rgb[1] = (t < 0.25) ? 4*t : (t > 0.75) ? 4 - 4*t : 1.0;
+	rgb[2] = min(max(2 - 4*t, 0.0), 1.0);
+}
+
+//! \brief the parametric axis closest to the viewing direction of view
+int viewAxis(Camera &view) {
+	Go::Point eye = view.getPos();
+	Go::Point at  = view.getLookAt();
+	int axis = 0;
+	for(int d=1; d<3; d++)
+		if(fabs(eye[d]-at[d]) > fabs(eye[axis]-at[axis]))
+			axis = d;
+	return axis;
+}
+
+/**********************************************************************************//**
+ * \brief rebuilds the density map and its grid geometry if anything has changed
+ * The maps are kept for all three axes, and only the one along the projection is
+ * rebuilt, when the elements or the mode have changed since it was built. The grid
+ * has a vertex at every cell center, colored by the value: log scaled counts, or
+ * depths between the smallest and largest. It lies flat in the middle of the domain,
+ * or rises from the bottom as a heightfield while the camera orbits. Unless an axis
+ * is chosen, the projection is along the axis closest to the view direction of the
+ * main camera.
+ *************************************************************************************/
+void updateOverview() {
+	int  axis   = (overviewAxis >= 0) ? overviewAxis : viewAxis(cam);
+	bool raised = doRotation;
+	if(overviewDirty) {
+		for(int d=0; d<3; d++)
+			densityDirty[d] = true;
+		overviewDirty = false;
+	}
+	DensityMap &density = densityMaps[axis];
+	if(densityDirty[axis] || overviewMode != density.getMode() || density.size() == 0) {
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		density.build(elBox, nEl, deadEl.empty() ? NULL : &deadEl[0], axis,
+		              (DensityMap::Mode) overviewMode, domainMin, domainMax, overviewSize);
+		gettimeofday(&end, NULL);
+		densityDirty[axis] = false;
+		cout << "Overview of " << nEl << " elements along axis " << axis << " in "
+		     << (end.tv_sec-start.tv_sec)*1000 + (end.tv_usec-start.tv_usec)/1000 << " ms" << endl;
+	} else if(axis == overviewShown && raised == overviewRaised && !overviewCoord.empty()) {
+		return;
+	}
+	overviewShown  = axis;
+	overviewRaised = raised;
+
+	int    n  = density.size();
+	int    u  = (axis+1)%3;
+	int    v  = (axis+2)%3;
+	double hu = (domainMax[u] - domainMin[u]) / n;
+	double hv = (domainMax[v] - domainMin[v]) / n;
+	double lo = density.min();
+	double hi = density.max();
+	overviewCoord.resize((size_t) n*n*3);
+	overviewColor.resize((size_t) n*n*4);
+	parallelFor(0, n, [&](long begin, long end) {
+		for(long j=begin; j<end; j++)
+			for(int i=0; i<n; i++) {
+				double value = density.value(i, j);
+				double t;
+				if(density.getMode() == DensityMap::COUNT)
+					t = (hi > 0) ? log(1 + value) / log(1 + hi) : 0.0;
+				else
+					t = (hi > lo) ? (value - lo) / (hi - lo) : 0.0;
+				size_t k = (size_t) j*n + i;
+				double *p = &overviewCoord[3*k];
+				p[u]    = domainMin[u] + (i+0.5)*hu;
+				p[v]    = domainMin[v] + (j+0.5)*hv;
+				p[axis] = raised ? domainMin[axis] + t*(domainMax[axis]-domainMin[axis])
+				                 : (domainMin[axis] + domainMax[axis]) / 2;
+				colormap(t, &overviewColor[4*k]);
+				overviewColor[4*k+3] = 1.0;
+			}
+	}, 16);
+
+	overviewQuads.clear();
+	for(int j=0; j+1<n; j++)
+		for(int i=0; i+1<n; i++) {
+			GLuint k = j*n + i;
+			GLuint quad[] = {k, k+1, k+n+1, k+n};
+			overviewQuads.insert(overviewQuads.end(), quad, quad+4);
+		}
+}
+
+/**********************************************************************************//**
+ * \brief draws one viewport. Culling and blink sorting are done for its camera
+ * \param view the camera of v, placed in the window (or set up for a poster tile)
+ *************************************************************************************/
+void drawView(Camera &view, const Viewport &v, int stage) {
+	view.setViewport();
 
 	if(!whiteBG)
-		cam.paintBackground();
-	cam.setProjection();
-	cam.setModelView();
+		view.paintBackground();
+
+	view.setProjection();
+	view.setModelView();
+	backend->setView(view.getModelView(), view.getProjection());
+
+	// cull each patch against the view frustum
+	view.updateFrustum();
+	for(uint p=0; p<patches.size(); p++)
+		patchVisible[p] = (v.patch < 0 || v.patch == (int) p) &&
+		                  view.boxInFrustum(patches[p].bbMin, patches[p].bbMax);
+
+	// while loading, show the domain and the part of the wireframe published so far
+	if(stage != LOAD_DONE) {
+		drawDomainBox();
+		long nR = rectReady.load(memory_order_acquire);
+		long nE = elReady.load(memory_order_acquire);
+		const double *elVertex = showInner ? elCoord : elCoord2;
+		passes.clear();
+		if(drawRectangles && nR > 0) {
+			RenderPass lines("loading meshrectangle lines", 0, rectCoord);
+			lines.lineWidth = 2;
+			lines.rgb[0]    = 0.1f;  lines.rgb[1] = 0.1f;  lines.rgb[2] = 0.1f;
+			lines.draw = [nR]() { drawBatched(GL_LINES, rectLines, 4*2, [nR](const Patch &p) { return readyPart(p.rect, nR); }); };
+			passes.add(lines);
+		}
+		if(drawElements && nE > 0) {
+			RenderPass lines("loading element lines", 1, elVertex);
+			lines.lineWidth = 2;
+			lines.draw = [nE,elVertex]() { drawChunked(GL_LINES, elLines, 12*2, 1, [nE](const Patch &p) { return readyPart(p.el, nE); }, elVertex, NULL); };
+			passes.add(lines);
+		}
+		passes.execute(*backend);
+		return;
+	}
+
+	// only the wireframes of resident bricks exist out-of-core. Paging follows the first view
+	if(outOfCore) {
+		if(&v == &viewports[0])
+			bricks.update(view);
+		glLineWidth(2);
+		glColor3d(0.0, 0.0, 0.0);
+		bricks.draw(drawElements, drawRectangles);
+		return;
+	}
+
+	// the overview replaces the mesh, which is too dense to see from afar. Its axis
+	// follows the main camera, so the views agree on it
+	bool overview = overviewMode >= 0;
+	if(overview)
+		updateOverview();
+
+	if((drawBlinkingEl || drawBlinkingRect) && !drawSolidEdges && !overview)
+		sortBlinks(view, v.patch);
 
 	// draw the axis cross
 	//glLineWidth(3);
@@ -121,98 +810,258 @@ void drawScene() {
 		//glVertex3f(0,0,0); glVertex3f(0,0,1);
 	//glEnd();
 
-	glEnable(GL_LIGHTING);
-	glEnable(GL_NORMAL_ARRAY);
-	if(drawX) {
-		glColor3f(0.8f, 0.67f, 0.2f);
-		glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-		glNormalPointer(   GL_DOUBLE, 0, rectNormal);
-		glDrawElements(GL_QUADS, nRectX*4, GL_UNSIGNED_INT, rectFacesX);
-	}
-	if(drawY) {
-		glColor3f(0.2f, 0.8f, 0.67f);
-		glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-		glNormalPointer(   GL_DOUBLE, 0, rectNormal);
-		glDrawElements(GL_QUADS, nRectY*4, GL_UNSIGNED_INT, rectFacesY);
-	}
-	if(drawZ) {
-		glColor3f(0.67f, 0.2f, 0.8f);
-		glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-		glNormalPointer(   GL_DOUBLE, 0, rectNormal);
-		glDrawElements(GL_QUADS, nRectZ*4, GL_UNSIGNED_INT, rectFacesZ);
-	}
-	glDisable(GL_NORMAL_ARRAY);
-	glDisable(GL_LIGHTING);
-
-	glColor3f(0, 0, 0);
-	glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-	if(drawX)
-		glDrawElements(GL_LINES, nRectX*4*2, GL_UNSIGNED_INT, rectLinesX);
-	if(drawY)
-		glDrawElements(GL_LINES, nRectY*4*2, GL_UNSIGNED_INT, rectLinesY);
-	if(drawZ)
-		glDrawElements(GL_LINES, nRectZ*4*2, GL_UNSIGNED_INT, rectLinesZ);
-
-	glClear(GL_DEPTH_BUFFER_BIT);
+	// describe the frame as passes. The queue orders them and skips redundant state
+	const double *elVertex = showInner ? elCoord : elCoord2;
+	static const GLfloat axisColor[3][3] = {{0.8f, 0.67f, 0.2f}, {0.2f, 0.8f, 0.67f}, {0.67f, 0.2f, 0.8f}};
+	bool    drawAxis[]  = {drawX, drawY, drawZ};
+	bool    outline     = edgeShading && backend->hasOutlines();
+	if(outline)
+		updateEdgeCoords();
+	passes.clear();
+	for(int d=0; d<3; d++) {
+		if(!drawAxis[d])
+			continue;
+		RenderPass faces("axis faces", 0, rectCoord);
+		faces.lighting = true;
+		faces.normal   = rectNormal;
+		copy(axisColor[d], axisColor[d]+3, faces.rgb);
+		faces.draw = [d]() { drawBatched(GL_QUADS, rectFaces, 4, [d](const Patch &p) { return p.rectAxis[d]; }); };
+		if(outline) {
+			faces.edge      = &rectEdge[0];
+			faces.lineWidth = 1;
+			passes.add(faces);
+			continue;
+		}
+		passes.add(faces);
+
+		RenderPass lines("axis lines", 1, rectCoord);
+		lines.draw = [d]() { drawBatched(GL_LINES, rectLines, 4*2, [d](const Patch &p) { return p.rectAxis[d]; }); };
+		passes.add(lines);
+	}
+
+	// the outlined faces are pushed back instead, so the lines below are not lost in them
+	if(!outline) {
+		RenderPass clearDepth("clear depth", 2, NULL);
+		clearDepth.clearDepth = true;
+		passes.add(clearDepth);
+	}
 
 	// draw surfaces
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_LIGHTING);
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-	if(drawBlinkingEl    && !drawSolidEdges) {
-		// glColor3f(0.6313726, 0.5058824, 0.3137255);
-		glVertexPointer(3, GL_DOUBLE, 0, elCoord);
-		glColorPointer(4 , GL_DOUBLE, 0, elColor);
-		glNormalPointer(   GL_DOUBLE, 0, elNormal);
-		glDrawElements(GL_QUADS, sparseEl.size(), GL_UNSIGNED_INT, &sparseEl[0]);
-	}
-
-	if(drawBlinkingRect    && !drawSolidEdges) {
-		// glColor3f(0.6313726, 0.5058824, 0.3137255);
-		glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-		glColorPointer(4 , GL_DOUBLE, 0, rectColor);
-		glNormalPointer(   GL_DOUBLE, 0, rectNormal);
-		glDrawElements(GL_QUADS, sparseRect.size(), GL_UNSIGNED_INT, &sparseRect[0]);
-	}
-	glDisableClientState(GL_COLOR_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisable(GL_LIGHTING);
-
-	glEnable(GL_DEPTH_TEST);
+	if(drawBlinkingEl    && !drawSolidEdges && !overview && !blinkCoord.empty()) {
+		RenderPass blink("blinking elements", 3, &blinkCoord[0]);
+		blink.lighting  = true;
+		blink.depthTest = false;
+		blink.normal    = &blinkNormal[0];
+		blink.color     = &blinkColor[0];
+		blink.draw = []() { glDrawArrays(GL_QUADS, 0, blinkCoord.size()/3); };
+		passes.add(blink);
+	}
+	if(drawBlinkingRect    && !drawSolidEdges && !overview) {
+		RenderPass blink("blinking meshrectangles", 4, rectCoord);
+		blink.lighting  = true;
+		blink.depthTest = false;
+		blink.normal    = rectNormal;
+		blink.color     = rectColor;
+		blink.draw = []() { glDrawElements(GL_QUADS, sparseRect.size(), GL_UNSIGNED_INT, &sparseRect[0]); };
+		passes.add(blink);
+	}
+
+	// draw the selected basis function support or element
+	if(!highlightFaces.count.empty()) {
+		RenderPass faces("highlight faces", 5, elVertex);
+		faces.lighting = true;
+		faces.normal   = elNormal;
+		faces.rgb[0]   = 1.0f;  faces.rgb[1] = 0.8f;  faces.rgb[2] = 0.1f;
+		faces.draw = [elVertex]() { highlightFaces.draw(GL_QUADS, elVertex, elNormal); };
+		passes.add(faces);
+
+		RenderPass lines("highlight lines", 6, elVertex);
+		lines.lineWidth = 3;
+		lines.rgb[0]    = 0.8f;  lines.rgb[1] = 0.1f;  lines.rgb[2] = 0.1f;
+		lines.draw = [elVertex]() { highlightLines.draw(GL_LINES, elVertex, NULL); };
+		passes.add(lines);
+	}
+	if(showCheck && !checkRectLines.empty()) {
+		RenderPass dangling("dangling meshrectangles", 6, rectCoord);
+		dangling.depthTest = false;
+		dangling.lineWidth = 3;
+		dangling.rgb[0]    = 0.9f;  dangling.rgb[1] = 0.1f;  dangling.rgb[2] = 0.9f;
+		dangling.draw = []() { glDrawElements(GL_LINES, checkRectLines.size(), GL_UNSIGNED_INT, &checkRectLines[0]); };
+		passes.add(dangling);
+	}
+
+	// draw the slice plane (or slab) instead of the full mesh
+	if(sliceAxis >= 0 && !sliceCoord.empty() && !sliceFaces.empty()) {
+		RenderPass faces("slice faces", 7, &sliceCoord[0]);
+		faces.lighting = true;
+		faces.normal   = &sliceNormal[0];
+		faces.color    = &sliceColor[0];
+		faces.draw = []() { glDrawElements(GL_QUADS, sliceFaces.size(), GL_UNSIGNED_INT, &sliceFaces[0]); };
+		passes.add(faces);
+	}
+	if(sliceAxis >= 0 && !sliceCoord.empty() && !sliceLines.empty()) {
+		RenderPass lines("slice lines", 8, &sliceCoord[0]);
+		lines.lineWidth = 2;
+		lines.draw = []() { glDrawElements(GL_LINES, sliceLines.size(), GL_UNSIGNED_INT, &sliceLines[0]); };
+		passes.add(lines);
+	}
+
 	// draw the ouline of the elements
-	if(drawRectangles) {
-		glLineWidth(2);
-		glColor3d(0.1, 0.1, 0.1);
-		glVertexPointer(3, GL_DOUBLE, 0, rectCoord);
-		glDrawElements(GL_LINES, nRect*4*2, GL_UNSIGNED_INT, rectLines);
+	int stride = quality.current().lineStride;
+	if(stride > 1 && (drawRectangles || drawElements))
+		updateCoarseLines(stride);
+	if(overview && !overviewQuads.empty()) {
+		RenderPass map("overview", 7, &overviewCoord[0]);
+		map.color = &overviewColor[0];
+		map.draw = []() { glDrawElements(GL_QUADS, overviewQuads.size(), GL_UNSIGNED_INT, &overviewQuads[0]); };
+		passes.add(map);
 	}
-	
-	if(drawElements) {
-		glLineWidth(2);
-		glColor3d(0.0, 0.0, 0.0);
-		if(showInner)
-			glVertexPointer(3, GL_DOUBLE, 0, elCoord);
+	if(drawRectangles && sliceAxis < 0 && !overview) {
+		RenderPass lines("meshrectangle lines", 8, rectCoord);
+		lines.lineWidth = 2;
+		lines.rgb[0]    = 0.1f;  lines.rgb[1] = 0.1f;  lines.rgb[2] = 0.1f;
+		if(stride > 1)
+			lines.draw = [stride]() { drawBatched(GL_LINES, &coarseRectLines[0], 4*2, [stride](const Patch &p) { return coarseRange(p.rect, stride); }); };
 		else
-			glVertexPointer(3, GL_DOUBLE, 0, elCoord2);
-		glDrawElements(GL_LINES, nEl*12*2, GL_UNSIGNED_INT, elLines);
+			lines.draw = []() { drawBatched(GL_LINES, rectLines, 4*2, [](const Patch &p) { return p.rect; }); };
+		passes.add(lines);
 	}
-
-	if(drawSolidEdges) {
-		glEnable(GL_LIGHTING);
-		glEnableClientState(GL_NORMAL_ARRAY);
-		glColor3f(0.6313726, 0.5058824, 0.3137255);
-		if(showInner)
-			glVertexPointer(3, GL_DOUBLE, 0, elCoord);
+	// an outlined solid shell shows the element edges on it, and hides the rest
+	if(drawElements && sliceAxis < 0 && !overview && !(drawSolidEdges && outline)) {
+		RenderPass lines("element lines", 8, elVertex);
+		lines.lineWidth = 2;
+		if(stride > 1)
+			lines.draw = [stride,elVertex]() { drawChunked(GL_LINES, &coarseElLines[0], 12*2, stride, [stride](const Patch &p) { return coarseRange(p.el, stride); }, elVertex, NULL); };
 		else
-			glVertexPointer(3, GL_DOUBLE, 0, elCoord2);
-		glNormalPointer(   GL_DOUBLE, 0, elNormal);
-		glDrawElements(GL_QUADS, shellEl.size(), GL_UNSIGNED_INT, &(shellEl[0]));
-		glDisableClientState(GL_NORMAL_ARRAY);
-		glDisable(GL_LIGHTING);
+			lines.draw = [elVertex]() { drawChunked(GL_LINES, elLines, 12*2, 1, [](const Patch &p) { return p.el; }, elVertex, NULL); };
+		passes.add(lines);
 	}
-	
-	// make things appear
+
+	if(drawSolidEdges && !overview) {
+		RenderPass shell("solid shell", 9, elVertex);
+		shell.lighting = true;
+		shell.normal   = elNormal;
+		shell.rgb[0]   = 0.6313726f;  shell.rgb[1] = 0.5058824f;  shell.rgb[2] = 0.3137255f;
+		// colored by the attribute, opaque whatever the blinking has done to the alpha
+		const double *color = (currentAttribute >= 0) ? elColor : NULL;
+		shell.color = color;
+		shell.blend = (color == NULL);
+		if(outline && drawElements) {
+			shell.edge      = &elEdge[0];
+			shell.lineWidth = 2;
+		}
+		shell.draw = [elVertex,color]() {
+			batch.clear();
+			if(sliceAxis >= 0)
+				sliceShell.addTo(batch, 0, sliceShell.size());
+			else
+				for(uint p=0; p<patches.size(); p++)
+					if(patchVisible[p])
+						shellEl.addTo(batch, patches[p].shell.begin, patches[p].shell.end);
+			batch.draw(GL_QUADS, elVertex, elNormal, color);
+		};
+		passes.add(shell);
+	}
+
+	passes.execute(*backend);
+}
+
+void drawView(Viewport &v, int stage) {
+	drawView(placeCamera(v), v, stage);
+}
+
+/**********************************************************************************//**
+ * \brief renders the active view to posterFile, posterWidth pixels wide
+ * Line widths are scaled with the image, so the poster looks like the window
+ * enlarged, as far as GL draws wide lines. It is always rendered at full quality.
+ * Nothing is animated between the tiles, so they all see the same blinking faces.
+ *************************************************************************************/
+void renderPoster() {
+	if(!meshReady())
+		return;
+	Viewport &v = viewports[activeView];
+	Camera view = placeCamera(v);   // resized to the poster below
+	int w      = (int) ((v.x1-v.x0) * window_width);
+	int h      = (int) ((v.y1-v.y0) * window_height);
+	int width  = posterWidth;
+	int height = (int) ((long) posterWidth * h / w);
+	view.handleResize(0, 0, width, height);
+
+	// full quality whatever the view is doing, with lines as wide as GL draws them
+	quality.full();
+	GLfloat scale = (GLfloat) width / w;
+	GLfloat aliased[2], smooth[2];
+	glGetFloatv(GL_ALIASED_LINE_WIDTH_RANGE, aliased);
+	glGetFloatv(GL_SMOOTH_LINE_WIDTH_RANGE,  smooth);
+	GLfloat widest = min(aliased[1], smooth[1]);
+	if(3*scale > widest)   // the widest lines of the passes
+		cerr << "Line widths are limited to " << widest << " pixels, thinner on the poster than in the window" << endl;
+	passes.setLineScale(scale);
+	passes.setMaxLineWidth(widest);
+
+	glEnable(GL_SCISSOR_TEST);
+	poster.render(posterFile, width, height, [&](int x, int y, int tw, int th) {
+		view.setTile(x, y, tw, th);
+		drawView(view, v, LOAD_DONE);
+	});
+	glDisable(GL_SCISSOR_TEST);
+	glViewport(0, 0, window_width, window_height);
+	passes.setMaxLineWidth(0);
+}
+
+/**********************************************************************************//**
+ * \brief hands the large vertex arrays to the backend, which may keep them on the GPU
+ * Called once the mesh is built, and again whenever the arrays have been written.
+ *************************************************************************************/
+void keepBuffers() {
+	size_t elBytes   = (size_t) elLayout.nEl*8*3*3*sizeof(double);
+	size_t rectBytes = (size_t) rectCapacity*4*3*sizeof(double);
+	backend->releaseArrays();
+	bool kept = backend->keepArray(elCoord,    elBytes)   &&
+	            backend->keepArray(elCoord2,   elBytes)   &&
+	            backend->keepArray(elNormal,   elBytes)   &&
+	            backend->keepArray(rectCoord,  rectBytes) &&
+	            backend->keepArray(rectNormal, rectBytes);
+	if(!kept) {
+		cerr << "Out of GPU memory for the vertex arrays, drawing them from client memory" << endl;
+		backend->releaseArrays();
+	}
+	buffersKept = true;
+}
+
+void drawScene() {
+	if(servePort)
+		server.bindTarget(window_width, window_height);
+	glDisable(GL_SCISSOR_TEST);
+	glViewport(0, 0, window_width, window_height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+
+	int stage = loadStage.load(memory_order_acquire);
+	if(stage == LOAD_PARSING) {
+		if(!whiteBG)
+			cam.paintBackground();
+		server.sendFrame();
+		glutSwapBuffers();
+		return;
+	}
+	if(!cameraReady)
+		initCamera();
+	if(!buffersKept && meshReady())
+		keepBuffers();
+	quality.update();
+	passes.setLineScale(quality.current().lineScale);
+
+	glEnable(GL_SCISSOR_TEST);
+	for(Viewport &v : viewports)
+		drawView(v, stage);
+	glDisable(GL_SCISSOR_TEST);
+	glViewport(0, 0, window_width, window_height);
+
+	// record the frame (read back asynchronously) and make things appear
+	server.sendFrame();
+	capture.capture();
 	glutSwapBuffers();
 
 	if(!printed_err) {
@@ -221,106 +1070,499 @@ void drawScene() {
 	}
 }
 
-void makeSparseIndices() {
-	sparseEl.clear();
-	sparseRect.clear();
-	for(uint i=0; i<viewEl.size(); i++)
-		for(int j=0; j<4; j++) 
-			sparseEl.push_back(viewEl[i].i[j]);
+/**********************************************************************************//**
+ * \brief appends the quads of adjacency face numbers to an index list
+ * \param out the quad list, referring to the element coordinates
+ * \param faces face numbers (6*element + 2*axis + side) from FaceAdjacency, in element order
+ *************************************************************************************/
+void pushFaceQuads(QuadList &out, const vector<long> &faces) {
+	// position of (x-min, x-max, y-min, y-max, z-min, z-max) among the 6 quads in elFaces
+	static const int quad[] = {3, 2, 4, 5, 0, 1};
+	for(long f : faces)
+		out.push(f/6, &elFaces[(size_t) (f/6)*24 + quad[f%6]*4]);
+}
 
-	for(uint i=0; i<viewRect.size(); i++)
-		for(int j=0; j<4; j++) 
-			sparseRect.push_back(viewRect[i].i[j]);
+//! \brief false for element slots which are free after a refinement
+bool elementLive(long e) {
+	return deadEl.empty() || !deadEl[e];
 }
 
-void pushRect(int i, double midTime) {
-	int ind[4];
+//! \brief false for meshrectangle slots which are free after a refinement
+bool rectLive(long i) {
+	return deadRect.empty() || !deadRect[i];
+}
 
-	// bottom face
-	int k=0;
-	ind[k++] = i*4 + 0;
-	ind[k++] = i*4 + 1;
-	ind[k++] = i*4 + 2;
-	ind[k++] = i*4 + 3;
-	Rect r(ind, rectCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewRect.push_back(r);
-	
-	showingRectangle[i] = true;
-}
-
-void pushElement(int i, double midTime) {
-	int ind[4];
-	int elementSetSize = nEl*8;
-
-	// bottom face
-	int k=0;
-	ind[k++] = i*8 + 0;
-	ind[k++] = i*8 + 1;
-	ind[k++] = i*8 + 3;
-	ind[k++] = i*8 + 2;
-	Rect r(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	// top face
-	k=0;
-	ind[k++] = i*8 + 4;
-	ind[k++] = i*8 + 5;
-	ind[k++] = i*8 + 7;
-	ind[k++] = i*8 + 6;
-	r = Rect(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	// right face
-	k=0;
-	ind[k++] = i*8 + 1 + elementSetSize;
-	ind[k++] = i*8 + 3 + elementSetSize;
-	ind[k++] = i*8 + 7 + elementSetSize;
-	ind[k++] = i*8 + 5 + elementSetSize;
-	r = Rect(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	// left face
-	k=0;
-	ind[k++] = i*8 + 0 + elementSetSize;
-	ind[k++] = i*8 + 2 + elementSetSize;
-	ind[k++] = i*8 + 6 + elementSetSize;
-	ind[k++] = i*8 + 4 + elementSetSize;
-	r = Rect(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	// front face
-	k=0;
-	ind[k++] = i*8 + 0 + elementSetSize*2;
-	ind[k++] = i*8 + 1 + elementSetSize*2;
-	ind[k++] = i*8 + 5 + elementSetSize*2;
-	ind[k++] = i*8 + 4 + elementSetSize*2;
-	r = Rect(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	// back face
-	k=0;
-	ind[k++] = i*8 + 2 + elementSetSize*2;
-	ind[k++] = i*8 + 3 + elementSetSize*2;
-	ind[k++] = i*8 + 7 + elementSetSize*2;
-	ind[k++] = i*8 + 6 + elementSetSize*2;
-	r = Rect(ind, elCoord, &cam);
-	r.midTime = midTime;
-	r.initI = i;
-	viewEl.push_back(r);
-
-	showingElement[i] = true;
+//! \brief true if element e passes the threshold filter of the current attribute
+bool elementShown(long e) {
+	if(!elementLive(e))
+		return false;
+	if(currentAttribute < 0)
+		return true;
+	const Attribute *a = attributes[currentAttribute];
+	double v     = a->value(e);
+	double range = a->max() - a->min();
+	return v >= a->min() + filterLo*range && v <= a->min() + filterHi*range;
+}
+
+//! \brief rebuilds the face adjacency if elements have changed since it was built
+void updateAdjacency() {
+	if(!adjacencyDirty)
+		return;
+	adjacency.build(elBox, nEl);
+	adjacencyDirty = false;
+}
+
+//! \brief builds the element and meshrectangle interval trees along axis d
+void buildTrees(int d) {
+	vector<double> lo(nEl), hi(nEl);
+	for(long i=0; i<nEl; i++) {
+		lo[i] = elBox[6*i  +d];
+		hi[i] = elBox[6*i+3+d];
+	}
+	elTree[d].build(lo, hi);
+
+	lo.resize(nRect);
+	hi.resize(nRect);
+	for(long i=0; i<nRect; i++) {
+		lo[i] = rectCoord[12*i  +d];
+		hi[i] = rectCoord[12*i+6+d];
+	}
+	rectTree[d].build(lo, hi);
+	treeDirty[d] = false;
+}
+
+/**********************************************************************************//**
+ * \brief rebuilds the solid shell: the faces of the elements in inSet which are not
+ *        covered by other elements in it
+ * The exposed faces are found in parallel, in blocks of elements which are then
+ * appended in element order.
+ *************************************************************************************/
+void buildShell(const vector<char> &inSet) {
+	const long block = 16384;
+	shellEl.clear();
+	for(Patch &p : patches) {
+		long nBlocks = (p.el.end - p.el.begin + block-1) / block;
+		vector<vector<long> > faces(nBlocks);
+		parallelFor(0, nBlocks, [&](long begin, long end) {
+			vector<long> elements;
+			for(long b=begin; b<end; b++) {
+				elements.clear();
+				for(long i=p.el.begin + b*block; i<min(p.el.end, p.el.begin + (b+1)*block); i++)
+					if(inSet[i])
+						elements.push_back(i);
+				adjacency.exposedFaces(elements, inSet, faces[b]);
+			}
+		}, 1);
+		p.shell.begin = shellEl.size();
+		for(vector<long> &f : faces)
+			pushFaceQuads(shellEl, f);
+		p.shell.end = shellEl.size();
+	}
+	shellEl.finish();
+}
+
+//! \brief rebuilds the solid shell from the elements passing the threshold filter
+void updateFilter() {
+	updateAdjacency();
+	vector<char> inSet(nEl);
+	parallelFor(0, nEl, [&](long begin, long end) {
+		for(long i=begin; i<end; i++)
+			inSet[i] = elementShown(i);
+	});
+	buildShell(inSet);
+}
+
+/**********************************************************************************//**
+ * \brief colors the elements by the current attribute, or randomly if there is none
+ *************************************************************************************/
+void applyAttribute() {
+	if(currentAttribute < 0) {
+		for(long e=0; e<nEl; e++) {
+			double rgb[] = {1.0*rand() / RAND_MAX, 1.0*rand() / RAND_MAX, 1.0*rand() / RAND_MAX};
+			for(int v=0; v<8*3; v++)
+				copy(rgb, rgb+3, elColor + 4*globalVertex(e, v/8, v%8));
+		}
+	} else {
+		const Attribute *a = attributes[currentAttribute];
+		double range = (a->max() > a->min()) ? a->max() - a->min() : 1.0;
+		parallelFor(0, nEl, [&](long begin, long end) {
+			double rgb[3];
+			for(long e=begin; e<end; e++) {
+				colormap((a->value(e) - a->min()) / range, rgb);
+				for(int v=0; v<8*3; v++)
+					copy(rgb, rgb+3, elColor + 4*globalVertex(e, v/8, v%8));
+			}
+		});
+	}
+	updateFilter();
+}
+
+/**********************************************************************************//**
+ * \brief collects the exposed faces of the slab elements, drawn when in solid mode
+ *************************************************************************************/
+void updateSliceShell(const vector<long> &elements) {
+	vector<long> faces;
+	vector<long> shown;
+	sliceMask.resize(nEl, 0);
+	for(long i : elements)
+		if(elementShown(i))
+			shown.push_back(i);
+	sort(shown.begin(), shown.end());
+	for(long i : shown)
+		sliceMask[i] = 1;
+	updateAdjacency();
+	adjacency.exposedFaces(shown, sliceMask, faces);
+	for(long i : shown)
+		sliceMask[i] = 0;
+	pushFaceQuads(sliceShell, faces);
+	sliceShell.finish();
+}
+
+/**********************************************************************************//**
+ * \brief appends the box [lo,hi] to the slice buffers as a wireframe
+ * Corners are numbered with x as bit 0, y as bit 1 and z as bit 2. Directions where
+ * the box is flat only get their lower corners connected, so a flat box becomes a
+ * rectangle outline and a doubly flat box a single line segment.
+ *************************************************************************************/
+void pushSliceWire(const double *lo, const double *hi) {
+	GLuint start = sliceCoord.size() / 3;
+	for(int c=0; c<8; c++)
+		for(int d=0; d<3; d++)
+			sliceCoord.push_back( (c & (1<<d)) ? hi[d] : lo[d] );
+	int flat = 0;
+	for(int d=0; d<3; d++)
+		if(hi[d] <= lo[d])
+			flat |= 1<<d;
+	for(int c=0; c<8; c++) {
+		if(c & flat)
+			continue;
+		for(int d=0; d<3; d++) {
+			if((c & (1<<d)) || (flat & (1<<d)))
+				continue;
+			sliceLines.push_back(start + c);
+			sliceLines.push_back(start + (c | (1<<d)));
+		}
+	}
+	sliceNormal.resize(sliceCoord.size(), 0.0);
+	sliceColor.resize(sliceCoord.size()/3*4, 0.0);
+}
+
+/**********************************************************************************//**
+ * \brief re-queries the interval trees and rebuilds the slice geometry
+ * In plane mode (sliceWidth == 0) every cut element gives a colored cross-section
+ * quad and every cut meshrectangle a line segment. A plane on an element boundary
+ * cuts the elements on both sides, so the items are taken as half-open [lo,hi) and
+ * only those above the plane are drawn, except at the top of their patch where
+ * nothing is above. In slab mode the elements and meshrectangles are drawn as
+ * wireframes clipped to the slab.
+ *************************************************************************************/
+void updateSlice() {
+	sliceCoord.clear();
+	sliceNormal.clear();
+	sliceColor.clear();
+	sliceFaces.clear();
+	sliceLines.clear();
+	sliceShell.clear();
+	if(sliceAxis < 0)
+		return;
+
+	int    d = sliceAxis;
+	int    u = (d+1)%3;
+	int    v = (d+2)%3;
+	double a = slicePos - sliceWidth/2.0;
+	double b = slicePos + sliceWidth/2.0;
+	double lo[3], hi[3];
+	if(treeDirty[d])
+		buildTrees(d);
+
+	// the patch of an element or meshrectangle, from the ends of their ranges (in the
+	// refinement mode slots may lie past the end, but there is only one patch)
+	vector<long> elEnd, rectEnd;
+	for(const Patch &p : patches) {
+		elEnd.push_back(p.el.end);
+		rectEnd.push_back(p.rect.end);
+	}
+	auto below = [&](const vector<long> &end, long i, double top) {
+		size_t k = upper_bound(end.begin(), end.end(), i) - end.begin();
+		const Patch &p = patches[min(k, patches.size()-1)];
+		return sliceWidth == 0 && top == slicePos && top < p.bbMax[d];
+	};
+
+	sliceHits.clear();
+	elTree[d].query(a, b, sliceHits);
+	for(long i : sliceHits) {
+		if(!elementLive(i))
+			continue;
+		for(int j=0; j<3; j++) {
+			lo[j] = elBox[6*i  +j];
+			hi[j] = elBox[6*i+3+j];
+		}
+		if(below(elEnd, i, hi[d]))
+			continue;
+		if(sliceWidth > 0) {
+			lo[d] = (lo[d] > a) ? lo[d] : a;
+			hi[d] = (hi[d] < b) ? hi[d] : b;
+			pushSliceWire(lo, hi);
+			continue;
+		}
+		GLuint start = sliceCoord.size() / 3;
+		for(int c=0; c<4; c++) {
+			double p[3];
+			p[d] = slicePos;
+			p[u] = (c==1 || c==2) ? hi[u] : lo[u];
+			p[v] = (c>=2)         ? hi[v] : lo[v];
+			for(int j=0; j<3; j++) {
+				sliceCoord.push_back(p[j]);
+				sliceNormal.push_back(j==d);
+			}
+			for(int j=0; j<3; j++)
+				sliceColor.push_back(elColor[4*globalVertex(i, 0, 0) + j]);
+			sliceColor.push_back(max_alpha);
+			sliceFaces.push_back(start + c);
+		}
+	}
+
+	if(sliceWidth > 0)
+		updateSliceShell(sliceHits);
+
+	sliceHits.clear();
+	rectTree[d].query(a, b, sliceHits);
+	for(long i : sliceHits) {
+		if(!rectLive(i))
+			continue;
+		for(int j=0; j<3; j++) {
+			lo[j] = rectCoord[12*i  +j];
+			hi[j] = rectCoord[12*i+6+j];
+		}
+		// in plane mode, rectangles in the slice plane coincide with the quads above
+		if(sliceWidth == 0 && hi[d] <= lo[d])
+			continue;
+		if(below(rectEnd, i, hi[d]))
+			continue;
+		lo[d] = (lo[d] > a) ? lo[d] : a;
+		hi[d] = (hi[d] < b) ? hi[d] : b;
+		pushSliceWire(lo, hi);
+	}
+}
+
+//! \brief rebuilds the basis function incidence if the spline has been refined since
+void updateSupport() {
+	if(!supportDirty)
+		return;
+	vector<LRSplineVolume*> models(1, patches[0].lr);
+	support.build(models, &elSlots.slots(), nEl);
+	supportDirty = false;
+}
+
+/**********************************************************************************//**
+ * \brief rebuilds the highlight draw lists from the current selection
+ * A selected basis function shows its support. A selected element is drawn solid with
+ * the combined support of its active basis functions as wireframe. Every element is
+ * a fixed range in elFaces/elLines, so this is just a list of pointers.
+ *************************************************************************************/
+void updateHighlight() {
+	highlightPending = false;
+	if(selectedBasis >= 0 || selectedElement >= 0)
+		updateSupport();
+	// element ids, drawn once each and in order so that neighbours merge into one range
+	vector<long> faces, lines;
+	if(selectedBasis >= 0) {
+		const long *el = support.support(selectedBasis);
+		faces.assign(el, el + support.supportSize(selectedBasis));
+		lines = faces;
+	} else if(selectedElement >= 0) {
+		faces.push_back(selectedElement);
+		const int *basis = support.active(selectedElement);
+		for(int i=0; i<support.activeCount(selectedElement); i++) {
+			const long *el = support.support(basis[i]);
+			lines.insert(lines.end(), el, el + support.supportSize(basis[i]));
+		}
+	}
+	if(showLocated) {
+		faces.insert(faces.end(), located.begin(), located.end());
+		lines.insert(lines.end(), located.begin(), located.end());
+	}
+	checkRectLines.clear();
+	if(showCheck) {
+		// with the elements holding others, which have no mismatched faces
+		vector<long> el = meshCheck.mismatched;
+		for(const pair<long, long> &o : meshCheck.overlaps) {
+			el.push_back(o.first);
+			el.push_back(o.second);
+		}
+		faces.insert(faces.end(), el.begin(), el.end());
+		lines.insert(lines.end(), el.begin(), el.end());
+		for(long r : meshCheck.dangling)
+			for(int c=0; c<4; c++) {
+				checkRectLines.push_back(r*4 + c);
+				checkRectLines.push_back(r*4 + (c+1)%4);
+			}
+	}
+	for(vector<long> *ids : {&faces, &lines}) {
+		sort(ids->begin(), ids->end());
+		ids->erase(unique(ids->begin(), ids->end()), ids->end());
+	}
+	highlightFaces.clear();
+	highlightLines.clear();
+	for(long e : faces)
+		highlightFaces.add(elFaces + (size_t) e*24, 24, chunkOf(e));
+	for(long e : lines)
+		highlightLines.add(elLines + (size_t) e*24, 24, chunkOf(e));
+}
+
+/**********************************************************************************//**
+ * \brief checks the mesh for overlaps, gaps and dangling meshrectangles
+ * The elements at an inconsistency are highlighted, and the dangling meshrectangles
+ * outlined, by the next updateHighlight(). From the loader thread that is in idle().
+ *************************************************************************************/
+void checkConsistency() {
+	vector<double> rectBox(6*nRect);
+	for(long r=0; r<nRect; r++)
+		for(int d=0; d<3; d++) {
+			rectBox[6*r+d  ] = min(rectCoord[12*r+d], rectCoord[12*r+6+d]);
+			rectBox[6*r+d+3] = max(rectCoord[12*r+d], rectCoord[12*r+6+d]);
+		}
+	vector<double> domains;
+	for(Patch &p : patches) {
+		domains.insert(domains.end(), p.bbMin, p.bbMin+3);
+		domains.insert(domains.end(), p.bbMax, p.bbMax+3);
+	}
+	meshCheck.run(elBox, nEl, deadEl.empty() ? NULL : &deadEl[0],
+	              rectBox.data(), nRect, deadRect.empty() ? NULL : &deadRect[0], domains);
+	// reported by their index in the spline, not by the buffer slots they are drawn at
+	vector<long> elSource;
+	if(refineMode) {
+		elSource.assign(nEl, -1);
+		for(long k=0; k<elSlots.live(); k++)
+			elSource[elSlots.slot(k)] = k;
+	}
+	meshCheck.report(cout, elSource.empty()   ? NULL : &elSource[0],
+	                       rectSource.empty() ? NULL : &rectSource[0]);
+	checkDirty       = false;
+	showCheck        = true;
+	highlightPending = true;
+}
+
+/**********************************************************************************//**
+ * \brief finds the element of every point in locateFile
+ * Points are read as "x y z [patch]", one per line, where z is relative to the patch if
+ * one is given and in scene coordinates otherwise. The elements are written one per
+ * line in the same order (-1 for points outside the mesh) to locateOut if it is set.
+ * Runs on the loader thread, so the elements found are highlighted from idle() once
+ * the mesh is up.
+ *************************************************************************************/
+bool locatePoints() {
+	istream *in = &cin;
+	ifstream file;
+	if(locateFile != "-") {
+		file.open(locateFile.c_str());
+		if(!file.good()) {
+			cerr << "Error: could not open point file " << locateFile << endl;
+			return false;
+		}
+		in = &file;
+	}
+	vector<double> points;
+	string line;
+	long lineNumber = 0;
+	while(getline(*in, line)) {
+		lineNumber++;
+		if(line.empty() || line[0] == '#')
+			continue;
+		istringstream fields(line);
+		double x[3];
+		int    patch = -1;
+		if(!(fields >> x[0] >> x[1] >> x[2])) {
+			cerr << "Error: expected x y z [patch] on line " << lineNumber << " of " << locateFile << endl;
+			return false;
+		}
+		if(fields >> patch) {
+			if(patch < 0 || patch >= (int) patches.size()) {
+				cerr << "Error: no patch " << patch << " on line " << lineNumber << " of " << locateFile << endl;
+				return false;
+			}
+			x[2] += patches[patch].offset;
+		}
+		points.insert(points.end(), x, x+3);
+	}
+	long nPoints = points.size() / 3;
+
+	timeval start, stop;
+	gettimeofday(&start, NULL);
+	if(locatorDirty) {
+		vector<double> domains;
+		for(Patch &p : patches) {
+			domains.insert(domains.end(), p.bbMin, p.bbMin+3);
+			domains.insert(domains.end(), p.bbMax, p.bbMax+3);
+		}
+		locator.build(elBox, nEl, deadEl.empty() ? NULL : &deadEl[0], domains);
+		locatorDirty = false;
+	}
+	vector<long> elements(nPoints);
+	locator.locate(points.data(), nPoints, elements.data());
+	gettimeofday(&stop, NULL);
+	double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) * 1e-6;
+
+	ofstream out;
+	if(!locateOut.empty()) {
+		out.open(locateOut.c_str());
+		if(!out.good()) {
+			cerr << "Error: could not write " << locateOut << endl;
+			return false;
+		}
+		for(long e : elements)
+			out << e << "\n";
+	}
+	long misses = count(elements.begin(), elements.end(), -1L);
+	cout << "Located " << nPoints << " points, " << misses << " outside the mesh, in " << seconds
+	     << " s (" << (long) (nPoints / max(seconds, 1e-6)) << " points/s)" << endl;
+
+	located = elements;
+	located.erase(remove(located.begin(), located.end(), -1L), located.end());
+	sort(located.begin(), located.end());
+	located.erase(unique(located.begin(), located.end()), located.end());
+	showLocated      = true;
+	highlightPending = true;
+	return true;
+}
+
+void selectBasis(int b) {
+	updateSupport();
+	int n = support.nBasis();
+	if(n == 0)
+		return;
+	selectedElement = -1;
+	selectedBasis   = (b + n) % n;
+	updateHighlight();
+	cout << "Basis function " << selectedBasis << " supported on " << support.supportSize(selectedBasis) << " elements" << endl;
+}
+
+//! \brief selects element e, or the next live one in the direction of step
+void selectElement(long e, int step) {
+	updateSupport();
+	if(support.nElements() == 0)
+		return;
+	e = (e + nEl) % nEl;
+	for(long tries=0; !elementLive(e); tries++) {
+		if(tries == nEl)
+			return;
+		e = (e + step + nEl) % nEl;
+	}
+	selectedBasis   = -1;
+	selectedElement = e;
+	updateHighlight();
+	cout << "Element " << selectedElement << " has active basis functions:";
+	for(int i=0; i<support.activeCount(selectedElement); i++)
+		cout << " " << support.active(selectedElement)[i];
+	cout << endl;
+}
+
+void moveSlice(double dist) {
+	int d = sliceAxis;
+	slicePos += dist;
+	if(slicePos < domainMin[d]) slicePos = domainMin[d];
+	if(slicePos > domainMax[d]) slicePos = domainMax[d];
+	updateSlice();
 }
 
 void rotateCamera(double mtime) {
@@ -335,63 +1577,446 @@ void rotateCamera(double mtime) {
 void addNewBlinks(double mtime) {
 	int mult = floor((mtime-lastSpawnTime) * startPerSec);
 	if(mult > 0) {
-		for(int i=0; i<mult; i++) {
-			int j = rand() % nEl;
-			if(!showingElement[j])
-				pushElement(j, mtime + lifeLength/2.0);
-		}
-		for(int i=0; i<mult; i++) {
-			int j = rand() % nRect;
-			if(!showingRectangle[j])
-				pushRect(j, mtime + lifeLength/2.0);
-		}
+		double midTime = mtime + lifeLength/2.0;
+		spawnElementBlinks(elLayout, nEl, mult, showingElement, elementShown, elCoord, midTime, viewEl);
+		spawnRectBlinks(nRect, mult, showingRectangle, rectLive, rectCoord, midTime, viewRect);
 		lastSpawnTime = mtime;
 	} 
 }
 
 void updateAlpha(double mtime) {
-	// double dt = mtime - lastTime.tv_sec - lastTime.tv_usec*1e-6;
-
-	int n = viewEl.size();
-	for(int i=0; i<n; i++) {
-		double alpha = 0.0;
-		if(fabs(viewEl[i].midTime - mtime) > lifeLength/2.0) {
-			showingElement[ viewEl[i].initI ] = false;
-			viewEl.erase(viewEl.begin() + i);
-			i--;
-			n--;
+	BlinkParams fade = {lifeLength, sigma, min_alpha, max_alpha};
+	TaskGroup fading;
+	fading.run([&]() { fadeBlinks(viewEl,   showingElement,   elColor,   mtime, fade); });
+	fading.run([&]() { fadeBlinks(viewRect, showingRectangle, rectColor, mtime, fade); });
+	fading.wait();
+}
+
+
+/**********************************************************************************//**
+ * \brief writes the corners, normals and a random color of meshrectangle m to slot i
+ * \param offset z-translation of the patch holding m
+ *************************************************************************************/
+void writeRect(long i, MeshRectangle *m, double offset) {
+	size_t k = (size_t) i*4*3;
+	size_t j = (size_t) i*4*3;
+	size_t l = (size_t) i*4*4;
+	double x1 = m->start_[0];
+	double y1 = m->start_[1];
+	double z1 = m->start_[2] + offset;
+	double x2 = m->stop_[0];
+	double y2 = m->stop_[1];
+	double z2 = m->stop_[2]  + offset;
+	rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
+	if(m->constDirection() == 0) {
+		rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
+		rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z2;
+		rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
+	} else if(m->constDirection() == 1) {
+		rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
+		rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
+		rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
+	} else {
+		rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
+		rectCoord[k++] = x2;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
+		rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
+	}
+	for(int c=0; c<4*3; c++)
+		rectNormal[j++] = (c%3==m->constDirection());
+	double r = 1.0*rand() / RAND_MAX;
+	double g = 1.0*rand() / RAND_MAX;
+	double b = 1.0*rand() / RAND_MAX;
+	for(int component=0; component<4; component++) {
+		rectColor[l++] = r;
+		rectColor[l++] = g;
+		rectColor[l++] = b;
+		rectColor[l++] = min_alpha;
+	}
+}
+
+//! \brief makes item k of the meshrectangle index buffers draw slot i
+void writeRectIndices(long k, long i) {
+	for(int c=0; c<4; c++) {
+		rectLines[k*8 + 2*c    ] = i*4 + c;
+		rectLines[k*8 + 2*c + 1] = i*4 + (c+1)%4;
+		rectFaces[k*4 + c      ] = i*4 + c;
+	}
+}
+
+//! \brief the box (min xyz, max xyz) of el in scene coordinates
+void elementBox(Element *el, double offset, double *box) {
+	for(int d=0; d<3; d++) {
+		box[d  ] = el->getParmin(d) + ((d==2) ? offset : 0.0);
+		box[d+3] = el->getParmax(d) + ((d==2) ? offset : 0.0);
+	}
+}
+
+void buildIndices();
+
+/**********************************************************************************//**
+ * \brief makes room for nE element and nR meshrectangle slots
+ * The buffers are at least doubled when they grow. Elements grow by whole chunks, so
+ * every chunk keeps its layout and only the pointers change. The buffers have
+ * mappings of their own in the refinement mode, and the old ones are released.
+ *************************************************************************************/
+void reserveSlots(long nE, long nR) {
+	if(nE > elCapacity) {
+		long   cap  = (max(nE, 2*elCapacity) + chunkElements-1) / chunkElements * chunkElements;
+		size_t used = elCapacity;
+		elCoord  = arena.grow(elCoord,  used*8*3*3, cap*8*3*3);
+		elCoord2 = arena.grow(elCoord2, used*8*3*3, cap*8*3*3);
+		elNormal = arena.grow(elNormal, used*8*3*3, cap*8*3*3);
+		elColor  = arena.grow(elColor,  used*8*4*3, cap*8*4*3);
+		elLines  = arena.grow(elLines,  used*12*2,  cap*12*2);
+		elFaces  = arena.grow(elFaces,  used*6*4,   cap*6*4);
+		elBox    = arena.grow(elBox,    used*6,     cap*6);
+		elCapacity   = cap;
+		elLayout.nEl = cap;
+		for(Rect &r : viewEl)
+			r.coords = elCoord;
+	}
+	if(nR > rectCapacity) {
+		long   cap  = max(nR, 2*rectCapacity);
+		size_t used = rectCapacity;
+		rectCoord  = arena.grow(rectCoord,  used*4*3, cap*4*3);
+		rectNormal = arena.grow(rectNormal, used*4*3, cap*4*3);
+		rectColor  = arena.grow(rectColor,  used*4*4, cap*4*4);
+		rectLines  = arena.grow(rectLines,  used*4*2, cap*4*2);
+		rectFaces  = arena.grow(rectFaces,  used*4,   cap*4);
+		rectCapacity = cap;
+		for(Rect &r : viewRect)
+			r.coords = rectCoord;
+	}
+}
+
+//! \brief numbers the elements and meshrectangles of the loaded spline by their slots
+void initSlots() {
+	Patch &p = patches[0];
+	vector<const void*> keys(p.lr->getAllElements().begin(), p.lr->getAllElements().end());
+	elSlots.assign(keys);
+	// the meshrectangles were written grouped by constDirection
+	keys.clear();
+	for(int d=0; d<3; d++)
+		for(MeshRectangle *m : p.lr->getAllMeshRectangles())
+			if(m->constDirection() == d)
+				keys.push_back(m);
+	rectSlots.assign(keys);
+	deadEl.assign(nEl, 0);
+	deadRect.assign(nRect, 0);
+	// extractGeometry() drew every meshrectangle slot at the same item
+	rectAt.resize(nRect);
+	rectPos.resize(nRect);
+	for(long s=0; s<nRect; s++)
+		rectAt[s] = rectPos[s] = s;
+}
+
+/**********************************************************************************//**
+ * \brief moves meshrectangle slot s to group g of the index buffers
+ * The index buffers hold the live meshrectangles grouped by constDirection (the
+ * rectAxis ranges of the patch), followed by the collapsed slots as group 3. A slot
+ * changes group by being swapped across the group boundaries in between, so this
+ * rewrites at most six items.
+ *************************************************************************************/
+void moveRect(Patch &p, long s, int g) {
+	long bound[] = {p.rectAxis[0].begin, p.rectAxis[1].begin, p.rectAxis[2].begin, p.rectAxis[2].end, nRect};
+	auto swapItems = [](long a, long b) {
+		swap(rectAt[a], rectAt[b]);
+		rectPos[rectAt[a]] = a;
+		rectPos[rectAt[b]] = b;
+		writeRectIndices(a, rectAt[a]);
+		writeRectIndices(b, rectAt[b]);
+	};
+	long k  = rectPos[s];
+	int  at = 0;
+	while(at < 3 && k >= bound[at+1])
+		at++;
+	for(; at < g; at++) {
+		long last = --bound[at+1];
+		swapItems(k, last);
+		k = last;
+	}
+	for(; at > g; at--) {
+		long first = bound[at]++;
+		swapItems(k, first);
+		k = first;
+	}
+	p.rectAxis[0].end = p.rectAxis[1].begin = bound[1];
+	p.rectAxis[1].end = p.rectAxis[2].begin = bound[2];
+	p.rectAxis[2].end = bound[3];
+}
+
+/**********************************************************************************//**
+ * \brief the solid shell of the refined patch, without the face adjacency
+ * The elements of an LR spline partition its domain, so the exposed faces of the
+ * live elements are the ones on the domain boundary.
+ *************************************************************************************/
+void updateRefinedShell() {
+	Patch &p = patches[0];
+	vector<long> faces;
+	for(long e=0; e<nEl; e++) {
+		if(deadEl[e])
 			continue;
-		} else {
-			double t2 = (mtime-viewEl[i].midTime)*(mtime-viewEl[i].midTime);
-			alpha = exp(-t2/sigma) * (max_alpha-min_alpha) + min_alpha;
+		const double *box = elBox + 6*e;
+		for(int d=0; d<3; d++) {
+			if(box[d] == p.bbMin[d])
+				faces.push_back(6*e + 2*d);
+			if(box[3+d] == p.bbMax[d])
+				faces.push_back(6*e + 2*d + 1);
 		}
+	}
+	shellEl.clear();
+	pushFaceQuads(shellEl, faces);
+	shellEl.finish();
+	p.shell.begin = 0;
+	p.shell.end   = shellEl.size();
+}
 
-		for(int j=0; j<4; j++)
-			elColor[ 4*viewEl[i].i[j] + 3 ] = alpha;
+//! \brief sends the vertices of the given element and meshrectangle slots to the backend again
+void uploadSlots(vector<long> &el, vector<long> &rect) {
+	sort(el.begin(), el.end());
+	el.erase(unique(el.begin(), el.end()), el.end());
+	sort(rect.begin(), rect.end());
+	rect.erase(unique(rect.begin(), rect.end()), rect.end());
+	// consecutive slots in one chunk are contiguous in every normal set
+	const double *elArrays[] = {elCoord, elCoord2, elNormal};
+	for(size_t i=0, j; i<el.size(); i=j) {
+		for(j=i+1; j<el.size() && el[j] == el[j-1]+1 && chunkOf(el[j]) == chunkOf(el[i]); j++)
+			;
+		for(const double *a : elArrays)
+			for(int s=0; s<3; s++)
+				backend->updateArray(a, globalVertex(el[i], s, 0)*3*sizeof(double), (j-i)*8*3*sizeof(double));
 	}
+	for(size_t i=0, j; i<rect.size(); i=j) {
+		for(j=i+1; j<rect.size() && rect[j] == rect[j-1]+1; j++)
+			;
+		backend->updateArray(rectCoord,  rect[i]*4*3*sizeof(double), (j-i)*4*3*sizeof(double));
+		backend->updateArray(rectNormal, rect[i]*4*3*sizeof(double), (j-i)*4*3*sizeof(double));
+	}
+}
 
-	n = viewRect.size();
-	for(int i=0; i<n; i++) {
-		double alpha = 0.0;
-		if(fabs(viewRect[i].midTime - mtime) > lifeLength/2.0) {
-			showingRectangle[ viewRect[i].initI ] = false;
-			viewRect.erase(viewRect.begin() + i);
-			i--;
-			n--;
+/**********************************************************************************//**
+ * \brief brings the buffers up to date after the spline has been refined
+ * Elements and meshrectangles are matched to their slots by address. Only new items
+ * and items whose extent changed are written, moved between the constDirection groups
+ * of the meshrectangle index buffers and sent to the GPU copies. Slots of items which
+ * are gone collapse to a point and stop blinking. The shell is found from the domain
+ * boundary, and the face adjacency, search trees and incidence are rebuilt when next
+ * used.
+ *************************************************************************************/
+void updateRefinedMesh() {
+	Patch &p = patches[0];
+	vector<Element*>       &elements = p.lr->getAllElements();
+	vector<MeshRectangle*> &rects    = p.lr->getAllMeshRectangles();
+	vector<long> elAdded, elFreed, rectAdded, rectFreed;
+	vector<const void*> keys(elements.begin(), elements.end());
+	elSlots.update(keys, elAdded, elFreed);
+	keys.assign(rects.begin(), rects.end());
+	rectSlots.update(keys, rectAdded, rectFreed);
+
+	const double *oldEl   = elCoord;
+	const double *oldRect = rectCoord;
+	reserveSlots(elSlots.size(), rectSlots.size());
+	bool grown = elCoord != oldEl || rectCoord != oldRect;
+	vector<long> elDirty(elFreed), rectDirty(rectFreed);
+	// new slots start out in the collapsed group of the index buffers
+	for(long s=nRect; s<(long) rectSlots.size(); s++) {
+		rectAt.push_back(s);
+		rectPos.push_back(s);
+		writeRectIndices(s, s);
+	}
+	nEl   = elSlots.size();
+	nRect = rectSlots.size();
+	deadEl.resize(nEl, 0);
+	deadRect.resize(nRect, 0);
+	showingElement.resize(nEl, false);
+	showingRectangle.resize(nRect, false);
+
+	// attribute values are per element of the loaded mesh
+	if(!attributes.empty()) {
+		cout << "Attributes dropped, they do not match the refined elements" << endl;
+		for(Attribute *a : attributes)
+			delete a;
+		attributes.clear();
+		currentAttribute = -1;
+	}
+
+	// freed slots collapse, and their blinking faces are dropped
+	ElementBuffers buffers = elementBuffers();
+	for(long s : elFreed) {
+		double *box = elBox + 6*s;
+		copy(box, box+3, box+3);
+		double rgb[] = {0, 0, 0};
+		tessellateElement(buffers, s, box, rgb, min_alpha);
+		deadEl[s] = 1;
+		showingElement[s] = false;
+	}
+	for(long s : rectFreed) {
+		double *c = rectCoord + 12*s;
+		for(int j=3; j<12; j++)
+			c[j] = c[j%3];
+		deadRect[s] = 1;
+		showingRectangle[s] = false;
+		moveRect(p, s, 3);
+	}
+	viewEl.erase(remove_if(viewEl.begin(), viewEl.end(), [](const Rect &r) { return deadEl[r.initI]; }), viewEl.end());
+	viewRect.erase(remove_if(viewRect.begin(), viewRect.end(), [](const Rect &r) { return deadRect[r.initI]; }), viewRect.end());
+
+	// new items get a random color, changed ones keep theirs
+	vector<char> fresh(nEl, 0);
+	for(long s : elAdded) {
+		fresh[s]  = 1;
+		deadEl[s] = 0;
+	}
+	long written = 0;
+	for(size_t k=0; k<elements.size(); k++) {
+		long   s = elSlots.slot(k);
+		double box[6];
+		elementBox(elements[k], p.offset, box);
+		if(!fresh[s] && equal(box, box+6, elBox + 6*s))
 			continue;
-		} else {
-			double t2 = (mtime-viewRect[i].midTime)*(mtime-viewRect[i].midTime);
-			alpha = exp(-t2/sigma) * (max_alpha-min_alpha) + min_alpha;
-		}
+		double rgb[3];
+		for(int c=0; c<3; c++)
+			rgb[c] = (fresh[s]) ? 1.0*rand() / RAND_MAX : elColor[4*globalVertex(s, 0, 0) + c];
+		copy(box, box+6, elBox + 6*s);
+		tessellateElement(buffers, s, box, rgb, min_alpha);
+		elDirty.push_back(s);
+		written++;
+	}
+	fresh.assign(nRect, 0);
+	for(long s : rectAdded) {
+		fresh[s]    = 1;
+		deadRect[s] = 0;
+	}
+	for(size_t k=0; k<rects.size(); k++) {
+		long s = rectSlots.slot(k);
+		const double *c = rectCoord + 12*s;
+		double start[] = {rects[k]->start_[0], rects[k]->start_[1], rects[k]->start_[2] + p.offset};
+		double stop[]  = {rects[k]->stop_[0],  rects[k]->stop_[1],  rects[k]->stop_[2]  + p.offset};
+		// corner 0 is the start and corner 2 the stop point
+		if(!fresh[s] && equal(start, start+3, c) && equal(stop, stop+3, c+6))
+			continue;
+		writeRect(s, rects[k], p.offset);
+		moveRect(p, s, rects[k]->constDirection());
+		rectDirty.push_back(s);
+		written++;
+	}
+	rectSource.assign(nRect, -1);
+	for(size_t k=0; k<rects.size(); k++)
+		rectSource[rectSlots.slot(k)] = k;
+	p.rect.begin = 0;
+	p.rect.end   = p.rectAxis[2].end;
+	p.el.begin   = 0;
+	p.el.end     = nEl;
+	elReady.store(nEl, memory_order_release);
+	rectReady.store(nRect, memory_order_release);
+
+	updateRefinedShell();
+	adjacencyDirty = true;
+	for(int d=0; d<3; d++)
+		treeDirty[d] = true;
+	supportDirty  = true;
+	selectedBasis = -1;    // the basis functions are renumbered
+	if(selectedElement >= nEl || (selectedElement >= 0 && deadEl[selectedElement]))
+		selectedElement = -1;
+	located.clear();       // the points may be in other elements now
+	locatorDirty = true;
+	checkDirty   = true;
+	if(showCheck)
+		checkConsistency();
+	updateHighlight();
+	coarseStride = 0;      // rebuilt at the next decimated frame
+	if(sliceAxis >= 0)
+		updateSlice();
+	if(grown || !buffersKept)
+		keepBuffers();
+	else
+		uploadSlots(elDirty, rectDirty);
+	overviewDirty = true;
+
+	cout << "Refined to " << elements.size() << " elements and " << rects.size() << " meshrectangles: "
+	     << written << " items written, " << elAdded.size() + rectAdded.size() << " new, "
+	     << elFreed.size() + rectFreed.size() << " slots freed" << endl;
+}
 
-		for(int j=0; j<4; j++)
-			rectColor[ 4*viewRect[i].i[j] + 3 ] = alpha;
+//! \brief refines the selected element, or the selected basis function
+void refineSelection() {
+	LRSplineVolume *lr = patches[0].lr;
+	if(selectedElement >= 0) {
+		const vector<long> &slot = elSlots.slots();
+		long k = find(slot.begin(), slot.end(), (long) selectedElement) - slot.begin();
+		if(k == (long) slot.size())
+			return;
+		lr->refineElement(k);
+	} else if(selectedBasis >= 0) {
+		lr->refineBasisFunction(selectedBasis);
+	} else {
+		cout << "Select an element (M) or basis function (N) to refine" << endl;
+		return;
 	}
+	updateRefinedMesh();
+}
 
+// meshrectangles typed on stdin, inserted by the render loop
+mutex         refineLock;
+deque<string> refineInput;
+
+//! \brief reads meshrectangles from stdin, one per line. Runs on its own thread
+void readRefineInput() {
+	cout << "Insert meshrectangles by typing: x0 y0 z0 x1 y1 z1 [multiplicity]" << endl;
+	string line;
+	while(getline(cin, line)) {
+		lock_guard<mutex> lock(refineLock);
+		refineInput.push_back(line);
+	}
 }
 
+//! \brief inserts the meshrectangles typed since the last frame
+void processRefineInput() {
+	deque<string> lines;
+	{
+		lock_guard<mutex> lock(refineLock);
+		lines.swap(refineInput);
+	}
+	if(lines.empty())
+		return;
+	LRSplineVolume *lr = patches[0].lr;
+	int inserted = 0;
+	for(string &line : lines) {
+		istringstream in(line);
+		double start[3], stop[3];
+		int    mult = 1;
+		if(!(in >> start[0] >> start[1] >> start[2] >> stop[0] >> stop[1] >> stop[2])) {
+			cerr << "Expected x0 y0 z0 x1 y1 z1 [multiplicity], got \"" << line << "\"" << endl;
+			continue;
+		}
+		in >> mult;
+		int flat = 0;
+		for(int d=0; d<3; d++) {
+			if(start[d] > stop[d])
+				swap(start[d], stop[d]);
+			if(start[d] < lr->startparam(d) || stop[d] > lr->endparam(d))
+				flat = -3;
+			flat += (start[d] == stop[d]);
+		}
+		if(flat != 1 || mult < 1) {
+			cerr << "Not a meshrectangle inside the domain: \"" << line << "\"" << endl;
+			continue;
+		}
+		lr->insert_line(new MeshRectangle(start[0], start[1], start[2], stop[0], stop[1], stop[2], mult));
+		inserted++;
+	}
+	if(inserted > 0)
+		updateRefinedMesh();
+}
 
 void handleResize(int w, int h) {
+	// every frame of a recording has the size it was started with
+	if(capture.active() && (w != capture.frameWidth() || h != capture.frameHeight())) {
+		cerr << "The window keeps its size of " << capture.frameWidth() << "x" << capture.frameHeight()
+		     << " while capturing" << endl;
+		glutReshapeWindow(capture.frameWidth(), capture.frameHeight());
+		return;
+	}
 	window_width  = w;
 	window_height = h;
 	glViewport(0,0, window_width, window_height);
@@ -414,6 +2039,25 @@ void handleKeypress(unsigned char key, int x, int y) {
 		cout << "[1] - start/stop blinking elements" << endl;
 		cout << "[2] - start/stop blinking meshrectangles" << endl;
 		cout << "[3] - show solid edges" << endl;
+		cout << "[4] - draw faces and their outlines in one shaded pass" << endl;
+		cout << "[C] - start/stop capturing frames" << endl;
+		cout << "[T] - render the view as a tiled high resolution poster" << endl;
+		cout << "[N] - select next/previous (shift) basis function and show its support" << endl;
+		cout << "[M] - select next/previous (shift) element and show its basis functions" << endl;
+		cout << "[U] - clear selection" << endl;
+		cout << "[P] - slice along x/y/z (or off)" << endl;
+		cout << "[+] - move slice forward (or drag with middle mouse button)" << endl;
+		cout << "[-] - move slice backward" << endl;
+		cout << "[]] - widen slice into a slab" << endl;
+		cout << "[[] - narrow slab (down to a plane)" << endl;
+		cout << "[A] - change rendering quality while moving the view" << endl;
+		cout << "[V] - change viewport layout (single/quad/compare)" << endl;
+		cout << "[O] - color elements by the next attribute file (or randomly)" << endl;
+		cout << "[K] - raise/lower (shift) the lower attribute threshold" << endl;
+		cout << "[J] - lower/raise (shift) the upper attribute threshold" << endl;
+		if(refineMode)
+			cout << "[G] - refine the selected element or basis function" << endl;
+		cout << "[D] - overview of element counts/refinement depth/off, or (shift) change its axis (in memory only)" << endl;
 		cout << "[Q] - Quit" << endl;
 	} else if (key == 'x') {
 		drawX = !drawX;
@@ -445,22 +2089,149 @@ void handleKeypress(unsigned char key, int x, int y) {
 	} else if (key == '3') {
 		drawSolidEdges = !drawSolidEdges;
 		cout << "Drawing solid box: " << drawSolidEdges << endl;
+	} else if (key == '4') {
+		edgeShading = !edgeShading && backend->initOutlines();
+		cout << "Single pass outlines: " << edgeShading << endl;
+	} else if (key == 'a') {
+		quality.setMovingLevel((quality.getMovingLevel()+1) % AdaptiveQuality::nLevels());
+		cout << "Quality level while moving: " << quality.getMovingLevel() << endl;
+	} else if (key == 'v' && cameraReady) {
+		setLayout((layout == "single") ? "quad" : (layout == "quad") ? "compare" : "single");
+		cout << "Viewport layout: " << layout << " (" << viewports.size() << " views)" << endl;
+	} else if (key == 'o' && meshReady()) {
+		currentAttribute = (currentAttribute+1 < (int) attributes.size()) ? currentAttribute+1 : -1;
+		applyAttribute();
+		if(sliceAxis >= 0)
+			updateSlice();
+		if(currentAttribute < 0) {
+			cout << "Coloring: random" << endl;
+		} else {
+			const Attribute *a = attributes[currentAttribute];
+			cout << "Coloring: " << a->getName() << " in [" << a->min() << ", " << a->max()
+			     << "], mean " << a->mean() << endl;
+		}
+	} else if ((key == 'k' || key == 'K' || key == 'j' || key == 'J') && meshReady() && currentAttribute >= 0) {
+		if(key == 'k') filterLo = min(filterLo + 0.05, filterHi);
+		if(key == 'K') filterLo = max(filterLo - 0.05, 0.0);
+		if(key == 'j') filterHi = max(filterHi - 0.05, filterLo);
+		if(key == 'J') filterHi = min(filterHi + 0.05, 1.0);
+		updateFilter();
+		if(sliceAxis >= 0)
+			updateSlice();
+		cout << "Showing attribute range: [" << filterLo << ", " << filterHi << "] of the values" << endl;
+	} else if (key == 't') {
+		renderPoster();
+	} else if (key == 'c') {
+		if(capture.active())
+			capture.stop();
+		else
+			capture.start(captureTarget, window_width, window_height, captureFps);
+		cout << "Capturing frames: " << capture.active() << endl;
+	} else if ((key == 'n' || key == 'N') && meshReady()) {
+		selectBasis(selectedBasis + ((key=='n') ? 1 : -1));
+	} else if ((key == 'm' || key == 'M') && meshReady()) {
+		selectElement(selectedElement + ((key=='m') ? 1 : -1), (key=='m') ? 1 : -1);
+	} else if (key == 'g' && refineMode && meshReady()) {
+		refineSelection();
+	} else if (key == 'd' && outOfCore) {
+		cout << "The overview needs the elements in memory, not --out-of-core" << endl;
+	} else if (key == 'd' && meshReady()) {
+		overviewMode = (overviewMode == DensityMap::DEPTH) ? -1 : overviewMode+1;
+		cout << "Overview: " << ((overviewMode < 0) ? "off" : (overviewMode == DensityMap::COUNT) ? "element count" : "refinement depth") << endl;
+	} else if (key == 'D') {
+		overviewAxis = (overviewAxis == 2) ? -1 : overviewAxis+1;
+		cout << "Overview axis: " << ((overviewAxis < 0) ? "view direction" : string(1, 'x'+overviewAxis)) << endl;
+	} else if (key == 'l' && meshReady()) {
+		showLocated = !showLocated;
+		updateHighlight();
+		cout << "Located elements: " << showLocated << " (" << located.size() << ")" << endl;
+	} else if (key == 'i' && meshReady()) {
+		if(checkDirty) {
+			checkConsistency();
+			updateHighlight();
+		} else {
+			showCheck = !showCheck;
+			updateHighlight();
+			cout << "Mesh check highlight: " << showCheck << endl;
+		}
+	} else if (key == 'u' && meshReady()) {
+		selectedBasis   = -1;
+		selectedElement = -1;
+		updateHighlight();
+		cout << "Selection cleared" << endl;
+	} else if (key == 'p' && meshReady()) {
+		sliceAxis = (sliceAxis==2) ? -1 : sliceAxis+1;
+		if(sliceAxis >= 0)
+			slicePos = (domainMin[sliceAxis] + domainMax[sliceAxis]) / 2.0;
+		updateSlice();
+		cout << "Slice axis: " << sliceAxis << endl;
+	} else if (key == '+' && sliceAxis >= 0) {
+		quality.moved();
+		moveSlice( (domainMax[sliceAxis]-domainMin[sliceAxis]) / 100.0);
+		cout << "Slice position: " << slicePos << endl;
+	} else if (key == '-' && sliceAxis >= 0) {
+		quality.moved();
+		moveSlice(-(domainMax[sliceAxis]-domainMin[sliceAxis]) / 100.0);
+		cout << "Slice position: " << slicePos << endl;
+	} else if (key == ']' && sliceAxis >= 0) {
+		sliceWidth += (domainMax[sliceAxis]-domainMin[sliceAxis]) / 50.0;
+		updateSlice();
+		cout << "Slab width: " << sliceWidth << endl;
+	} else if (key == '[' && sliceAxis >= 0) {
+		sliceWidth -= (domainMax[sliceAxis]-domainMin[sliceAxis]) / 50.0;
+		if(sliceWidth < 1e-10)
+			sliceWidth = 0.0;
+		updateSlice();
+		cout << "Slab width: " << sliceWidth << endl;
 	} else if (key == 'q') {
+		if(showStats && outOfCore)
+			cout << "Resident bricks: " << bricks.residentCount() << "/" << bricks.size()
+			     << " (" << bricks.residentBytes() << " bytes)" << endl;
+		if(showStats)
+			backend->report(cout);
+		if(showStats)
+			cout << "Peak RSS: " << Arena::peakRSS() << " bytes" << endl;
+		capture.stop();
 		cout << "Quit" << endl;
-		exit(0);
+		quit(0);
+	}
+}
+
+void dispatchMouse(int button, int state, int x, int y, int modifiers) {
+	if(button == GLUT_MIDDLE_BUTTON) {
+		dragSlice = (state == GLUT_DOWN);
+		lastDragY = y;
 	}
+	if(viewports.empty()) {
+		cam.processMouse(button, state, x, y, modifiers);
+		return;
+	}
+	if(state == GLUT_DOWN)
+		activeView = viewportAt(x, y);
+	viewports[activeView].camera->processMouse(button, state, x, y, modifiers);
 }
 
 void processMouse(int button, int state, int x, int y) {
-	cam.processMouse(button, state, x, y);
+	dispatchMouse(button, state, x, y, glutGetModifiers());
 }
 
 void processMouseActiveMotion(int x, int y) {
-	cam.processMouseActiveMotion(x,y);
+	quality.moved();
+	if(dragSlice && sliceAxis >= 0) {
+		moveSlice((lastDragY-y) * (domainMax[sliceAxis]-domainMin[sliceAxis]) / window_height);
+		lastDragY = y;
+	}
+	if(viewports.empty())
+		cam.processMouseActiveMotion(x,y);
+	else
+		viewports[activeView].camera->processMouseActiveMotion(x,y);
 }
 
 void processMousePassiveMotion(int x, int y) {
-	cam.processMousePassiveMotion(x,y);
+	if(viewports.empty())
+		cam.processMousePassiveMotion(x,y);
+	else
+		viewports[viewportAt(x,y)].camera->processMousePassiveMotion(x,y);
 }
 
 void initRendering() {
@@ -482,19 +2253,54 @@ void initRendering() {
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// setup smooth lines and anti-aliasing
-	glEnable( GL_LINE_SMOOTH );
-	glEnable( GL_POLYGON_SMOOTH );
-	glHint( GL_LINE_SMOOTH_HINT, GL_NICEST );
-	glEnable( GL_MULTISAMPLE_ARB );
+	// outlined faces sit just behind lines drawn on top of them
+	glPolygonOffset(1.0f, 1.0f);
 
-	// setup camera
-	cam.setPos(cam_dist,phi,theta);
-	cam.setLookAt(.5, .5, .5);
+	// the lights are state of this context, shared by the cameras of all viewports
+	Camera::setLights();
+
+	if(!backend->init()) {
+		cerr << "The " << backend->name() << " renderer can not run here, using the legacy one" << endl;
+		delete backend;
+		backend = RenderBackend::create("legacy");
+	}
+	GLfloat ambient[4], position[8], diffuse[8];
+	Camera::getLights(ambient, position, diffuse);
+	backend->setLights(ambient, position, diffuse);
+	cout << "Renderer: " << backend->name() << endl;
+	if(edgeShading)
+		edgeShading = backend->initOutlines();
+
+	// smooth lines and anti-aliasing are set every frame by the adaptive quality
+}
+
+//! \brief feeds input from the remote client through the regular callbacks
+void processRemoteEvents() {
+	if(server.poll())
+		cout << "Client connected" << endl;
+	RemoteEvent ev;
+	while(server.nextEvent(ev)) {
+		if(ev.type == RemoteEvent::KEY)
+			handleKeypress((unsigned char) ev.a, ev.b, ev.c);
+		else if(ev.type == RemoteEvent::MOUSE)
+			dispatchMouse(ev.a, ev.b, ev.c, ev.d, ev.e);
+		else if(ev.type == RemoteEvent::MOTION)
+			processMouseActiveMotion(ev.c, ev.d);
+		else if(ev.type == RemoteEvent::PASSIVE)
+			processMousePassiveMotion(ev.c, ev.d);
+		else if(ev.type == RemoteEvent::RESIZE && ev.a > 0 && ev.b > 0)
+			handleResize(ev.a, ev.b);
+	}
 }
 
 /* executed when program is idle */
 void idle() { 
+	if(servePort)
+		processRemoteEvents();
+	if(refineMode && meshReady())
+		processRefineInput();
+	if(meshReady() && highlightPending)
+		updateHighlight();
 	drawScene();
 
 	// first frame, start timer
@@ -513,10 +2319,10 @@ void idle() {
 	
 		mtime = ((seconds) * 1000 + useconds/1000.0) + 0.5;
 		if(seconds > 2) {
-			printf("Elapsed time: %ld milliseconds\n", mtime);
-			printf("Elapsed time since start: %ld s\n", end.tv_sec - startTime.tv_sec);
+			fprintf(statusFile, "Elapsed time: %ld milliseconds\n", mtime);
+			fprintf(statusFile, "Elapsed time since start: %ld s\n", end.tv_sec - startTime.tv_sec);
 			double fps = (frameCount - lastFrame) * 1000.0 / mtime;
-			printf("%ld frames in %ld milliseconds = %.3f fps\n", frameCount-lastFrame, mtime, fps);
+			fprintf(statusFile, "%ld frames in %ld milliseconds = %.3f fps\n", frameCount-lastFrame, mtime, fps);
 
 			gettimeofday(&lastTime, NULL);
 			lastFrame = frameCount;
@@ -530,14 +2336,25 @@ void idle() {
 	long useconds = end.tv_usec - startTime.tv_usec;
 	double mtime = seconds + useconds*1e-6;
 
+	// when recording, time follows the frame count so no frames are skipped
+	if(!capture.active())
+		captureStart = mtime;
+	else
+		mtime = captureStart + capture.time();
+	if(captureFrames > 0 && capture.frames() >= captureFrames) {
+		capture.stop();
+		quit(0);
+	}
+	if(posterAtStart && meshReady()) {
+		renderPoster();
+		quit(0);
+	}
+
 	// update the geometry
 	rotateCamera(mtime);
-	if(!drawSolidEdges) {
+	if(!drawSolidEdges && meshReady()) {
 		addNewBlinks(mtime);
 		updateAlpha(mtime);
-		sort(viewEl.begin(), viewEl.end());
-		sort(viewRect.begin(), viewRect.end());
-		makeSparseIndices();
 	}
 
 	// wait a few moments before continuing
@@ -548,330 +2365,719 @@ void idle() {
 }
 
 
-int main(int argc, char **argv) {
-	if(argc != 2) {
-		cerr << "File usage:\n" << argv[0] << " <filename>" << endl;
-		exit(1);
+/**********************************************************************************//**
+ * \brief stacks the patches along z with a small gap in between
+ * Expects bbMin and bbMax in the parameter domain of each patch, and moves them along
+ * with the offset.
+ *************************************************************************************/
+void placePatches() {
+	double gap = 0;
+	for(Patch &p : patches)
+		gap = max(gap, 0.1*(p.bbMax[2] - p.bbMin[2]));
+	for(uint i=0; i<patches.size(); i++) {
+		Patch &p = patches[i];
+		p.offset = (i==0) ? 0.0 : patches[i-1].bbMax[2] + gap - p.bbMin[2];
+		p.bbMin[2] += p.offset;
+		p.bbMax[2] += p.offset;
+		for(int d=0; d<3; d++) {
+			domainMin[d] = (i==0) ? p.bbMin[d] : min(domainMin[d], p.bbMin[d]);
+			domainMax[d] = (i==0) ? p.bbMax[d] : max(domainMax[d], p.bbMax[d]);
+		}
 	}
-	
-	// read geometry
-	ifstream inFile;
-	inFile.open(argv[1]);
-	if(!inFile.good()) {
-		cerr << "Error opening \"" << argv[1] << "\"\n";
-		exit(2);
+	patchVisible.resize(patches.size(), true);
+}
+
+/**********************************************************************************//**
+ * \brief reads one patch per file and stacks them along z with a small gap in between
+ *************************************************************************************/
+void readPatches(const vector<char*> &fileNames) {
+	nRect = 0;
+	nEl   = 0;
+	// the files are parsed concurrently, and then numbered in the order given
+	vector<LRSplineVolume*> models(fileNames.size());
+	TaskGroup parsing;
+	for(uint i=0; i<fileNames.size(); i++) {
+		char *fileName = fileNames[i];
+		if(!ifstream(fileName).good()) {
+			cerr << "Error opening \"" << fileName << "\"\n";
+			exit(2);
+		}
+		parsing.run([&models, i, fileName]() {
+			ifstream inFile(fileName);
+			models[i] = new LRSplineVolume();
+			inFile >> *models[i];
+		});
+	}
+	parsing.wait();
+
+	for(LRSplineVolume *lr : models) {
+		Patch p;
+		p.lr = lr;
+		p.el.begin   = nEl;
+		p.rect.begin = nRect;
+		nEl   += p.lr->nElements();
+		nRect += p.lr->nMeshRectangles();
+		p.el.end     = nEl;
+		p.rect.end   = nRect;
+		patches.push_back(p);
 	}
 
-	LRSplineVolume lr;
-	inFile >> lr;
-	inFile.close();
-
-	nRect  = lr.nMeshRectangles();
-	rectCoord  = new double[nRect*4*3];
-	rectNormal = new double[nRect*4*3];
-	rectColor  = new double[nRect*4*4];
-	rectLines  = new GLuint[nRect*4*2];
-	rectFaces  = new GLuint[nRect*4];
-
-	int i=0;
-	int j=0;
-	int k=0;
-	int l=0;
-	int n=0;
-	vector<int> constX;
-	vector<int> constY;
-	vector<int> constZ;
-
-	for(MeshRectangle* m : lr.getAllMeshRectangles() ) {
-		double x1 = m->start_[0];
-		double y1 = m->start_[1];
-		double z1 = m->start_[2];
-		double x2 = m->stop_[0];
-		double y2 = m->stop_[1];
-		double z2 = m->stop_[2];
-		if(fabs(x1-x2)     <1e-10) constX.push_back(n++);
-		else if(fabs(y1-y2)<1e-10) constY.push_back(n++);
-		else if(fabs(z1-z2)<1e-10) constZ.push_back(n++);
-		rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
-		if(m->constDirection() == 0) {
-			rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
-			rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z2;
-			rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
-		} else if(m->constDirection() == 1) {
-			rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
-			rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
-			rectCoord[k++] = x1;    rectCoord[k++] = y1;   rectCoord[k++] = z2;
-		} else {
-			rectCoord[k++] = x2;    rectCoord[k++] = y1;   rectCoord[k++] = z1;
-			rectCoord[k++] = x2;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
-			rectCoord[k++] = x1;    rectCoord[k++] = y2;   rectCoord[k++] = z1;
-		}
-		for(i=0; i<4*3; i++)
-			rectNormal[j++] = (i%3==m->constDirection());
-		double r = 1.0*rand() / RAND_MAX;
-		double g = 1.0*rand() / RAND_MAX;
-		double b = 1.0*rand() / RAND_MAX;
-		for(int component=0; component<4; component++) {
-			rectColor[l++] = r;
-			rectColor[l++] = g;
-			rectColor[l++] = b;
-			rectColor[l++] = min_alpha;
-		}
-	}
-
-	nRectX     = constX.size();
-	nRectY     = constY.size();
-	nRectZ     = constZ.size();
-	rectFacesX = new GLuint[constX.size()*4];
-	rectFacesY = new GLuint[constY.size()*4];
-	rectFacesZ = new GLuint[constZ.size()*4];
-	rectLinesX = new GLuint[constX.size()*4*2];
-	rectLinesY = new GLuint[constY.size()*4*2];
-	rectLinesZ = new GLuint[constZ.size()*4*2];
-
-	j=0;
-	k=0;
-	int kx=0, ky=0, kz=0;
-	int jx=0, jy=0, jz=0;
-	for(int i=0; i<nRect; i++) {
-		rectLines[j++] = i*4;
-		rectLines[j++] = i*4 + 1;
-		rectLines[j++] = i*4 + 1;
-		rectLines[j++] = i*4 + 2;
-		rectLines[j++] = i*4 + 2;
-		rectLines[j++] = i*4 + 3;
-		rectLines[j++] = i*4 + 3;
-		rectLines[j++] = i*4;
-
-		rectFaces[k++] = i*4  ;
-		rectFaces[k++] = i*4+1;
-		rectFaces[k++] = i*4+2;
-		rectFaces[k++] = i*4+3;
-	}
-
-	for(int i : constX) {
-		rectFacesX[kx++] = i*4  ;   rectLinesX[jx++] = i*4  ;
-		rectFacesX[kx++] = i*4+1;   rectLinesX[jx++] = i*4+1;   rectLinesX[jx++] = i*4+1;
-		rectFacesX[kx++] = i*4+2;   rectLinesX[jx++] = i*4+2;   rectLinesX[jx++] = i*4+2;
-		rectFacesX[kx++] = i*4+3;   rectLinesX[jx++] = i*4+3;   rectLinesX[jx++] = i*4+3;
-		                            rectLinesX[jx++] = i*4  ;                            
-	}
-	for(int i : constY) {
-		rectFacesY[ky++] = i*4  ;   rectLinesY[jy++] = i*4  ;
-		rectFacesY[ky++] = i*4+1;   rectLinesY[jy++] = i*4+1;   rectLinesY[jy++] = i*4+1;
-		rectFacesY[ky++] = i*4+2;   rectLinesY[jy++] = i*4+2;   rectLinesY[jy++] = i*4+2;
-		rectFacesY[ky++] = i*4+3;   rectLinesY[jy++] = i*4+3;   rectLinesY[jy++] = i*4+3;
-                                    rectLinesY[jy++] = i*4  ;                            
-	}
-	for(int i : constZ) {
-		rectFacesZ[kz++] = i*4  ;   rectLinesZ[jz++] = i*4  ;
-		rectFacesZ[kz++] = i*4+1;   rectLinesZ[jz++] = i*4+1;   rectLinesZ[jz++] = i*4+1;
-		rectFacesZ[kz++] = i*4+2;   rectLinesZ[jz++] = i*4+2;   rectLinesZ[jz++] = i*4+2;
-		rectFacesZ[kz++] = i*4+3;   rectLinesZ[jz++] = i*4+3;   rectLinesZ[jz++] = i*4+3;
-                                    rectLinesZ[jz++] = i*4  ;                            
-	}
-
-	nEl = lr.nElements();
-	elCoord  = new double[nEl*8*3*3]; 
-	elCoord2 = new double[nEl*8*3*3]; 
-	elNormal = new double[nEl*8*3*3];
-	elColor  = new double[nEl*8*4*3];
-	elLines  = new GLuint[nEl*12*2];
-	elFaces  = new GLuint[nEl*6*4];
-
-	j = 0;
-	k = 0;
-	l = 0;
-	n = 0;
-	int elementSetSize = nEl*8;
-	for(int normalDir=0; normalDir<3; normalDir++) {
-		for( Element *el : lr.getAllElements() ) {
-			double x1 = el->getParmin(0);
-			double y1 = el->getParmin(1);
-			double z1 = el->getParmin(2);
-			double x2 = el->getParmax(0);
-			double y2 = el->getParmax(1);
-			double z2 = el->getParmax(2);
-
-			if(x1<=y1) elCoord[k++] = x1; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z1;
-			if(x2<=y1) elCoord[k++] = x2; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z1;
-			if(x1<=y2) elCoord[k++] = x1; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z1;
-			if(x2<=y2) elCoord[k++] = x2; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z1;
-			if(x1<=y1) elCoord[k++] = x1; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z2;
-			if(x2<=y1) elCoord[k++] = x2; else elCoord[k++] = y1; elCoord[k++] = y1;  elCoord[k++] = z2;
-			if(x1<=y2) elCoord[k++] = x1; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z2;
-			if(x2<=y2) elCoord[k++] = x2; else elCoord[k++] = y2; elCoord[k++] = y2;  elCoord[k++] = z2;
-
-			if(x1>=y1) elCoord2[n++] = x1; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z1;
-			if(x2>=y1) elCoord2[n++] = x2; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z1;
-			if(x1>=y2) elCoord2[n++] = x1; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z1;
-			if(x2>=y2) elCoord2[n++] = x2; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z1;
-			if(x1>=y1) elCoord2[n++] = x1; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z2;
-			if(x2>=y1) elCoord2[n++] = x2; else elCoord2[n++] = y1; elCoord2[n++] = y1;  elCoord2[n++] = z2;
-			if(x1>=y2) elCoord2[n++] = x1; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z2;
-			if(x2>=y2) elCoord2[n++] = x2; else elCoord2[n++] = y2; elCoord2[n++] = y2;  elCoord2[n++] = z2;
-/*
-			elCoord[k++] = x1;  elCoord[k++] = y1;  elCoord[k++] = z1;
-			elCoord[k++] = x2;  elCoord[k++] = y1;  elCoord[k++] = z1;
-			elCoord[k++] = x1;  elCoord[k++] = y2;  elCoord[k++] = z1;
-			elCoord[k++] = x2;  elCoord[k++] = y2;  elCoord[k++] = z1;
-			elCoord[k++] = x1;  elCoord[k++] = y1;  elCoord[k++] = z2;
-			elCoord[k++] = x2;  elCoord[k++] = y1;  elCoord[k++] = z2;
-			elCoord[k++] = x1;  elCoord[k++] = y2;  elCoord[k++] = z2;
-			elCoord[k++] = x2;  elCoord[k++] = y2;  elCoord[k++] = z2;
-*/
-
-			// trust me... it's right. Completely unreadable, but right.
-			// the idea is to make 3 sets of complete cube coordinates. Corresponding to
-			// each set is a normal vector pointing in one of the three cardinal directions
-			if(normalDir == 0) // up-down normals
-				for(i=0; i<3*8; i++) 
-					elNormal[j++] = -(2*(i>11)-1)*(i%3==2) ;
-			else if(normalDir == 1) // left-right normals
-				for(i=0; i<3*8; i++) 
-					elNormal[j++] = -(2*(i%2)-1)*(i%3==0) ;
-			else if(normalDir == 2) // front-back normals
-				for(i=0; i<3*8; i++) 
-					elNormal[j++] = -((i&2)-1)*(i%3==1) ;
-			// set color
-			double r = 1.0*rand() / RAND_MAX;
-			double g = 1.0*rand() / RAND_MAX;
-			double b = 1.0*rand() / RAND_MAX;
-			for(int component=0; component<8; component++) {
-				if(normalDir == 0) {
-					elColor[l++] = r;
-					elColor[l++] = g;
-					elColor[l++] = b;
-					elColor[l++] = min_alpha;
-				} else {
-					for(int component=0; component<4; component++) {
-						elColor[l] = elColor[l-elementSetSize*4];
-						l++;
+	for(Patch &p : patches) {
+		for(int d=0; d<3; d++) {
+			p.bbMin[d] = p.lr->startparam(d);
+			p.bbMax[d] = p.lr->endparam(d);
+		}
+	}
+	placePatches();
+}
+
+/**********************************************************************************//**
+ * \brief reserves the arena and allocates every render buffer whose size follows from
+ *        the element and meshrectangle counts
+ *************************************************************************************/
+void allocateBuffers() {
+	// when refining, room for the mesh to double (by whole chunks) before any buffer grows
+	elCapacity   = nEl;
+	rectCapacity = nRect;
+	if(refineMode) {
+		elCapacity   = (2*nEl + chunkElements-1) / chunkElements * chunkElements;
+		rectCapacity = 2*nRect;
+	}
+
+	// all render buffers go in one mapping, unless they may grow and get one each
+	size_t nR = rectCapacity;
+	size_t nE = elCapacity;
+	bool   own = refineMode;
+	if(!own)
+		arena.reserve( nR*4*(3+3+4)*sizeof(double) + nR*4*(2+1)*sizeof(GLuint) +
+		               nE*8*3*(3+3+3+4)*sizeof(double) + nE*6*sizeof(double) +
+		               nE*(12*2+6*4)*sizeof(GLuint) );
+
+	rectCoord  = arena.alloc<double>("rectCoord",  nR*4*3,   own);
+	rectNormal = arena.alloc<double>("rectNormal", nR*4*3,   own);
+	rectColor  = arena.alloc<double>("rectColor",  nR*4*4,   own);
+	rectLines  = arena.alloc<GLuint>("rectLines",  nR*4*2,   own);
+	rectFaces  = arena.alloc<GLuint>("rectFaces",  nR*4,     own);
+
+	elCoord    = arena.alloc<double>("elCoord",    nE*8*3*3, own);
+	elCoord2   = arena.alloc<double>("elCoord2",   nE*8*3*3, own);
+	elNormal   = arena.alloc<double>("elNormal",   nE*8*3*3, own);
+	elColor    = arena.alloc<double>("elColor",    nE*8*4*3, own);
+	elLines    = arena.alloc<GLuint>("elLines",    nE*12*2,  own);
+	elFaces    = arena.alloc<GLuint>("elFaces",    nE*6*4,   own);
+	elBox      = arena.alloc<double>("elBox",      nE*6,     own);
+	elLayout.nEl = nE;
+}
+
+/**********************************************************************************//**
+ * \brief fills the element and meshrectangle buffers from the LR splines
+ * Items are published to the render loop through rectReady and elReady every
+ * loadChunk items, so the wireframe grows on screen while this runs.
+ *************************************************************************************/
+void extractGeometry() {
+	long rect=0;
+
+	// the meshrectangles of each patch are grouped by constDirection, so the drawX/Y/Z
+	// passes are sub-ranges of the patch rectangles in the one index buffer
+	rectSource.resize(nRect);
+	for(Patch &p : patches) {
+		vector<MeshRectangle*> &rects = p.lr->getAllMeshRectangles();
+		for(int dir=0; dir<3; dir++) {
+			p.rectAxis[dir].begin = rect;
+			for(size_t i=0; i<rects.size(); i++) {
+				MeshRectangle *m = rects[i];
+				if(m->constDirection() != dir)
+					continue;
+				rectSource[rect] = p.rect.begin + i;
+				writeRect(rect, m, p.offset);
+				writeRectIndices(rect, rect);
+				if(++rect % loadChunk == 0) {
+					rectReady.store(rect, memory_order_release);
+					if(loadCancel)
+						return;
+				}
+			}
+			p.rectAxis[dir].end = rect;
+		}
+	}
+	rectReady.store(nRect, memory_order_release);
+
+	// elements are written one at a time into all three normal sets, so that any
+	// prefix of them is complete and can be published
+	long e = 0;
+	ElementBuffers buffers = elementBuffers();
+	for( Patch &p : patches )
+	for( Element *el : p.lr->getAllElements() ) {
+		elementBox(el, p.offset, elBox + 6*e);
+
+		double rgb[3];
+		for(int c=0; c<3; c++)
+			rgb[c] = 1.0*rand() / RAND_MAX;
+		tessellateElement(buffers, e, elBox + 6*e, rgb, min_alpha);
+
+		if(++e % loadChunk == 0) {
+			elReady.store(e, memory_order_release);
+			if(loadCancel)
+				return;
+		}
+	}
+	elReady.store(nEl, memory_order_release);
+}
+
+/**********************************************************************************//**
+ * \brief builds the solid shell and search trees from the vertex data
+ *************************************************************************************/
+void buildIndices() {
+	long i;
+
+	// the solid shell is every face not covered by neighbouring (live) elements
+	adjacency.build(elBox, nEl);
+	vector<char> inSet(nEl);
+	for(i=0; i<nEl; i++)
+		inSet[i] = elementLive(i);
+	buildShell(inSet);
+
+	showingRectangle.resize(nRect, false);
+	showingElement.resize(nEl, false);
+
+	// per-axis interval trees for slicing
+	for(int d=0; d<3; d++)
+		buildTrees(d);
+}
+
+/**********************************************************************************//**
+ * \brief streams the element and meshrectangle boxes to a brick file instead of
+ *        building the in-memory render buffers
+ * A brick file written from the same files (by path, size and modification time) is
+ * opened as it is. Otherwise the patches are parsed and written one at a time, so only
+ * one LR spline is in memory at any time.
+ *************************************************************************************/
+void createBricks(const vector<char*> &fileNames) {
+	const int itemsPerBrick = 4096;
+	stringstream key;
+	key << "LRview bricks 1 " << itemsPerBrick << "\n";
+	for(char *fileName : fileNames) {
+		struct stat info;
+		if(stat(fileName, &info) != 0) {
+			cerr << "Error opening \"" << fileName << "\"\n";
+			exit(2);
+		}
+		key << fileName << " " << info.st_size << " " << info.st_mtime << "\n";
+	}
+	bricks.setBudget(brickBudget*1024*1024);
+
+	if(!bricks.open(brickFile, key.str())) {
+		if(!bricks.create(brickFile))
+			exit(3);
+		for(char *fileName : fileNames) {
+			if(loadCancel)
+				return;   // and the unfinished file is never reused
+			ifstream inFile(fileName);
+			LRSplineVolume *lr = new LRSplineVolume();
+			inFile >> *lr;
+			Patch p;
+			p.lr = NULL;
+			for(int d=0; d<3; d++) {
+				p.bbMin[d] = lr->startparam(d);
+				p.bbMax[d] = lr->endparam(d);
+			}
+			p.el.begin   = 0;
+			p.el.end     = lr->nElements();
+			p.rect.begin = 0;
+			p.rect.end   = lr->nMeshRectangles();
+			BrickStore::Items elements = [lr](const function<void(const double*)> &add) {
+				double box[6];
+				for(Element *el : lr->getAllElements()) {
+					for(int d=0; d<3; d++) {
+						box[d]   = el->getParmin(d);
+						box[3+d] = el->getParmax(d);
+					}
+					add(box);
+				}
+			};
+			BrickStore::Items rects = [lr](const function<void(const double*)> &add) {
+				double box[6];
+				for(MeshRectangle *m : lr->getAllMeshRectangles()) {
+					for(int d=0; d<3; d++) {
+						box[d]   = m->start_[d];
+						box[3+d] = m->stop_[d];
 					}
+					add(box);
 				}
-/*
-				elColor[l++] = 0.6313726;
-				elColor[l++] = 0.5058824;
-				elColor[l++] = 0.3137255;
-				elColor[l++] = min_alpha;
-*/
+			};
+			if(!bricks.addPatch(p.el.end, elements, p.rect.end, rects, p.bbMin, p.bbMax, itemsPerBrick))
+				exit(3);
+			delete lr;
+			patches.push_back(p);
+		}
+		placePatches();
+		vector<BrickStore::Domain> domains(patches.size());
+		for(uint i=0; i<patches.size(); i++) {
+			copy(patches[i].bbMin, patches[i].bbMin+3, domains[i].bbMin);
+			copy(patches[i].bbMax, patches[i].bbMax+3, domains[i].bbMax);
+			domains[i].offset = patches[i].offset;
+			domains[i].nEl    = patches[i].el.end   - patches[i].el.begin;
+			domains[i].nRect  = patches[i].rect.end - patches[i].rect.begin;
+		}
+		if(!bricks.finish(key.str(), domains))
+			exit(3);
+	} else {
+		for(const BrickStore::Domain &dom : bricks.domains()) {
+			Patch p;
+			p.lr = NULL;
+			copy(dom.bbMin, dom.bbMin+3, p.bbMin);
+			copy(dom.bbMax, dom.bbMax+3, p.bbMax);
+			p.offset = dom.offset;
+			p.el.begin   = 0;
+			p.el.end     = dom.nEl;
+			p.rect.begin = 0;
+			p.rect.end   = dom.nRect;
+			patches.push_back(p);
+		}
+		for(uint i=0; i<patches.size(); i++) {
+			for(int d=0; d<3; d++) {
+				domainMin[d] = (i==0) ? patches[i].bbMin[d] : min(domainMin[d], patches[i].bbMin[d]);
+				domainMax[d] = (i==0) ? patches[i].bbMax[d] : max(domainMax[d], patches[i].bbMax[d]);
 			}
+		}
+		patchVisible.resize(patches.size(), true);
+	}
 
+	// the patches number their items in one range each, as in memory
+	nEl   = 0;
+	nRect = 0;
+	for(Patch &p : patches) {
+		p.el.end     += nEl;
+		p.el.begin   += nEl;
+		p.rect.end   += nRect;
+		p.rect.begin += nRect;
+		nEl   = p.el.end;
+		nRect = p.rect.end;
+	}
+}
+
+/**********************************************************************************//**
+ * \brief writes the elements and meshrectangles to fileName, straight from the buffers
+ *************************************************************************************/
+bool exportMesh(const string &fileName) {
+	// elements with a face on the (filtered) solid shell, found one chunk at a time
+	vector<char> inSet(nEl);
+	vector<char> boundary(nEl, 0);
+	for(long i=0; i<nEl; i++)
+		inSet[i] = elementShown(i);
+	vector<long> elements, faces;
+	for(long c=0; c<nEl; c+=chunkElements) {
+		elements.clear();
+		faces.clear();
+		for(long i=c; i<min(nEl, c+chunkElements); i++)
+			if(inSet[i])
+				elements.push_back(i);
+		adjacency.exposedFaces(elements, inSet, faces);
+		for(long f : faces)
+			boundary[f/6] = 1;
+	}
+
+	ExportScene scene;
+	scene.nEl       = nEl;
+	scene.nRect     = nRect;
+	scene.elBox     = elBox;
+	scene.rectCoord = rectCoord;
+	scene.rectColor = rectColor;
+	scene.boundary  = &boundary[0];
+	scene.elColor   = [](long e) { return (const double*) elColor + 4*globalVertex(e, 0, 0); };
+	scene.attributes.assign(attributes.begin(), attributes.end());
+	MeshExport exporter(scene);
+	return exporter.write(fileName);
+}
+
+void printUsage(char *program) {
+	cerr << "File usage:\n" << program << " [options] <filename> [<filename> ...]" << endl;
+	cerr << "Options:" << endl;
+	cerr << "  --stats          report bytes per render buffer and peak RSS" << endl;
+	cerr << "  --hugepages      back the render buffers by huge pages" << endl;
+	cerr << "  --release-model  free the LR spline once the render buffers are built" << endl;
+	cerr << "  --capture <name> record frames from the start, to images if the name contains" << endl;
+	cerr << "                   a printf pattern (i.e. frame%05d.png) or else as raw rgb24 video" << endl;
+	cerr << "                   (- for stdout, moving all other output to stderr). The window" << endl;
+	cerr << "                   keeps its size while capturing" << endl;
+	cerr << "  --fps <n>        frames per second of animation time when capturing (30)" << endl;
+	cerr << "  --frames <n>     quit after capturing n frames" << endl;
+	cerr << "  --out-of-core <file>  stream the mesh as wireframe bricks through <file>, which is" << endl;
+	cerr << "                   reused for as long as the spline files are unchanged" << endl;
+	cerr << "  --budget <MB>    memory for resident bricks in out-of-core mode (512)" << endl;
+	cerr << "  --moving-quality <n>  quality while the view is moved; 0 full, 1 no smoothing and" << endl;
+	cerr << "                   thin lines (default), 2 also no multisampling and a decimated wireframe" << endl;
+	cerr << "  --still-delay <s>     seconds without movement before full quality returns (0.25)" << endl;
+	cerr << "  --attribute <file>  color elements by raw float64/float32 values, one per element" << endl;
+	cerr << "                   in getAllElements() order (may be repeated, cycle with 'o')" << endl;
+	cerr << "  --views <layout> single (default), quad for orthographic x/y/z views next to the" << endl;
+	cerr << "                   perspective one, or compare for one linked view per patch" << endl;
+	cerr << "  --poster <file>  render a tiled poster (.png or .ppm) once loaded and quit ('t' renders" << endl;
+	cerr << "                   one to poster.png at any time)" << endl;
+	cerr << "  --poster-width <n>  width of the poster in pixels (16384)" << endl;
+	cerr << "  --export <file>  write the elements and meshrectangles as binary .vtu (VTK) or .ply" << endl;
+	cerr << "                   with constDirection, boundary flag, color and attributes, and quit." << endl;
+	cerr << "                   .ply holds up to 2^32 vertices (8 per element), and neither works" << endl;
+	cerr << "                   with --out-of-core" << endl;
+	cerr << "  --refine         refine a single patch while viewing it: 'g' refines the selected" << endl;
+	cerr << "                   element or basis function, and meshrectangles typed on stdin as" << endl;
+	cerr << "                   x0 y0 z0 x1 y1 z1 [multiplicity] are inserted" << endl;
+	cerr << "  --renderer <name>  legacy (default) for fixed function OpenGL, or shader for buffer" << endl;
+	cerr << "                   objects and shaders (OpenGL 3.0 compatibility, not a core profile)." << endl;
+	cerr << "                   Both run the same scene and options" << endl;
+	cerr << "  --overview <mode>  start with the overview of element counts (count) or refinement" << endl;
+	cerr << "                   depth (depth) projected along the view, instead of the mesh." << endl;
+	cerr << "                   Needs the elements in memory, so not with --out-of-core" << endl;
+	cerr << "  --overview-resolution <n>  cells along each side of the overview (512)" << endl;
+	cerr << "  --locate <file>  find the element of every point \"x y z [patch]\" in <file> (- for" << endl;
+	cerr << "                   stdin) and highlight them (toggle with 'l'). Needs the elements in" << endl;
+	cerr << "                   memory, so not with --out-of-core" << endl;
+	cerr << "  --locate-out <file>  write the element of every point, one per line and -1 for" << endl;
+	cerr << "                   points outside the mesh, and quit" << endl;
+	cerr << "  --check          check the mesh for overlapping elements, gaps and meshrectangles off" << endl;
+	cerr << "                   the element faces once loaded, and highlight them ('i' checks at any" << endl;
+	cerr << "                   time and toggles the highlight)" << endl;
+	cerr << "  --edge-shader    draw faces and their outlines in one shaded pass (toggle with '4')" << endl;
+	cerr << "  --threads <n>    threads for loading and per-frame work, counting the calling" << endl;
+	cerr << "                   thread (default: all cores)" << endl;
+	cerr << "  --serve <port>   render offscreen in a hidden window and stream the frames to a" << endl;
+	cerr << "                   client on <port>, which sends its input back" << endl;
+	cerr << "  --bind <address> address to serve on (127.0.0.1, so only local clients or ssh" << endl;
+	cerr << "                   tunnels connect; 0.0.0.0 for any)" << endl;
+	cerr << "Client usage:\n" << program << " --connect <host>:<port>" << endl;
+	exit(1);
+}
+
+/**********************************************************************************//**
+ * \brief parses and tessellates the scene. Runs on its own thread while the window is up
+ *************************************************************************************/
+void loadScene(vector<char*> fileNames) {
+	if(outOfCore) {
+		createBricks(fileNames);
+		loadStage.store(LOAD_DONE, memory_order_release);
+		return;
+	}
+	readPatches(fileNames);
+	if(loadCancel)
+		return;
+
+	allocateBuffers();
+	loadStage.store(LOAD_BUILDING, memory_order_release);
+
+	// the build stages, run on the shared pool as soon as their inputs are ready
+	TaskGraph build;
+	TaskGraph::Node geometry = build.add(extractGeometry);
+	TaskGraph::Node incidence = build.add([]() {
+		// basis function <-> element incidence
+		if(loadCancel)
+			return;
+		vector<LRSplineVolume*> models;
+		for(Patch &p : patches)
+			models.push_back(p.lr);
+		support.build(models);
+	});
+	build.add([]() {
+		// nothing below needs the spline itself
+		if(releaseModel) {
+			for(Patch &p : patches) {
+				delete p.lr;
+				p.lr = NULL;
+			}
+		}
+	}, {geometry, incidence});
+	TaskGraph::Node indices = build.add([]() {
+		if(!loadCancel)
+			buildIndices();
+	}, {geometry});
+	TaskGraph::Node reading = build.add([]() {
+		for(string &fileName : attributeFiles) {
+			Attribute *a = new Attribute();
+			if(!a->open(fileName, nEl)) {
+				delete a;
+				continue;
+			}
+			cout << "Attribute " << fileName << ": min " << a->min() << ", max " << a->max()
+			     << ", mean " << a->mean() << ", " << a->nanCount() << " NaN" << endl;
+			attributes.push_back(a);
+		}
+	});
+	build.add([]() {
+		if(!attributes.empty() && !loadCancel) {
+			currentAttribute = 0;
+			applyAttribute();
 		}
+	}, {indices, reading});
+	build.run();
+	if(loadCancel)
+		return;
+	if(refineMode)
+		initSlots();
+	if(!locateFile.empty() && locateOut.empty())
+		locatePoints();
+	if(checkAtLoad)
+		checkConsistency();
+
+	if(showStats)
+		arena.report(cout);
+	loadStage.store(LOAD_DONE, memory_order_release);
+	cout << "Loaded " << nEl << " elements and " << nRect << " meshrectangles" << endl;
+}
+
+// thin client: the latest frame from the server, filled by the network thread
+FrameClient           client;
+mutex                 clientLock;
+vector<unsigned char> clientFrame;
+int                   clientWidth  = 0;
+int                   clientHeight = 0;
+bool                  clientNew    = false;
+bool                  clientClosed = false;
+thread                receiver;
+
+//! \brief network thread of the client, until the server closes the connection
+void receiveFrames() {
+	vector<unsigned char> rgb;
+	int w = 0;
+	int h = 0;
+	while(client.receiveFrame(rgb, w, h)) {
+		lock_guard<mutex> guard(clientLock);
+		clientFrame  = rgb;
+		clientWidth  = w;
+		clientHeight = h;
+		clientNew    = true;
 	}
+	lock_guard<mutex> guard(clientLock);
+	clientClosed = true;
+}
 
-	j = 0;
-	k = 0;
-	l = 0;
-	for(i=0; i<nEl; i++) {
-
-		// bottom lines
-		elLines[j++] = i*8    ;
-		elLines[j++] = i*8 + 1;
-		elLines[j++] = i*8    ;
-		elLines[j++] = i*8 + 2;
-		elLines[j++] = i*8 + 1;
-		elLines[j++] = i*8 + 3;
-		elLines[j++] = i*8 + 2;
-		elLines[j++] = i*8 + 3;
-
-		// top lines
-		elLines[j++] = i*8 + 4;
-		elLines[j++] = i*8 + 5;
-		elLines[j++] = i*8 + 4;
-		elLines[j++] = i*8 + 6;
-		elLines[j++] = i*8 + 5;
-		elLines[j++] = i*8 + 7;
-		elLines[j++] = i*8 + 6;
-		elLines[j++] = i*8 + 7;
-
-		// in-between-lines
-		elLines[j++] = i*8 + 0;
-		elLines[j++] = i*8 + 4;
-		elLines[j++] = i*8 + 1;
-		elLines[j++] = i*8 + 5;
-		elLines[j++] = i*8 + 2;
-		elLines[j++] = i*8 + 6;
-		elLines[j++] = i*8 + 3;
-		elLines[j++] = i*8 + 7;
-
-		// bottom face
-		elFaces[k++] = i*8 + 0;
-		elFaces[k++] = i*8 + 1;
-		elFaces[k++] = i*8 + 3;
-		elFaces[k++] = i*8 + 2;
-
-		// top face
-		elFaces[k++] = i*8 + 4;
-		elFaces[k++] = i*8 + 5;
-		elFaces[k++] = i*8 + 7;
-		elFaces[k++] = i*8 + 6;
-
-		// right face
-		elFaces[k++] = i*8 + 1 + elementSetSize;
-		elFaces[k++] = i*8 + 3 + elementSetSize;
-		elFaces[k++] = i*8 + 7 + elementSetSize;
-		elFaces[k++] = i*8 + 5 + elementSetSize;
-
-		// left face
-		elFaces[k++] = i*8 + 0 + elementSetSize;
-		elFaces[k++] = i*8 + 2 + elementSetSize;
-		elFaces[k++] = i*8 + 6 + elementSetSize;
-		elFaces[k++] = i*8 + 4 + elementSetSize;
-
-		// front face
-		elFaces[k++] = i*8 + 0 + elementSetSize*2;
-		elFaces[k++] = i*8 + 1 + elementSetSize*2;
-		elFaces[k++] = i*8 + 5 + elementSetSize*2;
-		elFaces[k++] = i*8 + 4 + elementSetSize*2;
-
-		// back face
-		elFaces[k++] = i*8 + 2 + elementSetSize*2;
-		elFaces[k++] = i*8 + 3 + elementSetSize*2;
-		elFaces[k++] = i*8 + 7 + elementSetSize*2;
-		elFaces[k++] = i*8 + 6 + elementSetSize*2;
-
-		if(lr.getElement(i)->getParmin(0) == lr.startparam(0)) {
-			shellEl.push_back(i*8 + 0 + elementSetSize);
-			shellEl.push_back(i*8 + 2 + elementSetSize);
-			shellEl.push_back(i*8 + 6 + elementSetSize);
-			shellEl.push_back(i*8 + 4 + elementSetSize);
-		}
-		if(lr.getElement(i)->getParmin(1) == lr.startparam(1)) {
-			shellEl.push_back(i*8 + 0 + elementSetSize*2);
-			shellEl.push_back(i*8 + 1 + elementSetSize*2);
-			shellEl.push_back(i*8 + 5 + elementSetSize*2);
-			shellEl.push_back(i*8 + 4 + elementSetSize*2);
-		}
-		if(lr.getElement(i)->getParmin(2) == lr.startparam(2)) {
-			shellEl.push_back(i*8 + 0);
-			shellEl.push_back(i*8 + 1);
-			shellEl.push_back(i*8 + 3);
-			shellEl.push_back(i*8 + 2);
-		}
-		if(lr.getElement(i)->getParmax(0) == lr.endparam(0)) {
-			shellEl.push_back(i*8 + 1 + elementSetSize);
-			shellEl.push_back(i*8 + 3 + elementSetSize);
-			shellEl.push_back(i*8 + 7 + elementSetSize);
-			shellEl.push_back(i*8 + 5 + elementSetSize);
-		}
-		if(lr.getElement(i)->getParmax(1) == lr.endparam(1)) {
-			shellEl.push_back(i*8 + 2 + elementSetSize*2);
-			shellEl.push_back(i*8 + 3 + elementSetSize*2);
-			shellEl.push_back(i*8 + 7 + elementSetSize*2);
-			shellEl.push_back(i*8 + 6 + elementSetSize*2);
-		}
-		if(lr.getElement(i)->getParmax(2) == lr.endparam(2)) {
-			shellEl.push_back(i*8 + 4);
-			shellEl.push_back(i*8 + 5);
-			shellEl.push_back(i*8 + 7);
-			shellEl.push_back(i*8 + 6);
+void clientDisplay() {
+	glViewport(0, 0, window_width, window_height);
+	glClear(GL_COLOR_BUFFER_BIT);
+	{
+		lock_guard<mutex> guard(clientLock);
+		clientNew = false;
+		if(!clientFrame.empty()) {
+			// the frame lags behind a resize; stretch it until the next one arrives
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+			glRasterPos2i(-1, -1);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelZoom((float) window_width / clientWidth, (float) window_height / clientHeight);
+			glDrawPixels(clientWidth, clientHeight, GL_RGB, GL_UNSIGNED_BYTE, &clientFrame[0]);
 		}
 	}
+	glutSwapBuffers();
+}
 
-	showingRectangle.resize(nRect, false);
-	showingElement.resize(nEl, false);
+void clientIdle() {
+	bool fresh, closed;
+	{
+		lock_guard<mutex> guard(clientLock);
+		fresh  = clientNew;
+		closed = clientClosed;
+	}
+	// GLUT never returns from its main loop, so the client ends here
+	if(closed) {
+		receiver.join();
+		cout << "Connection closed" << endl;
+		exit(0);
+	}
+	if(fresh)
+		clientDisplay();
+	else
+		usleep(2000);
+}
+
+void sendRemote(int type, int a, int b, int c, int d, int e) {
+	RemoteEvent ev;
+	ev.type = type;
+	ev.a    = a;
+	ev.b    = b;
+	ev.c    = c;
+	ev.d    = d;
+	ev.e    = e;
+	client.sendEvent(ev);
+}
+
+void clientKeypress(unsigned char key, int x, int y) {
+	// 'q' closes the client and leaves the server running
+	if(key == 'q') {
+		client.shutdown();
+		receiver.join();
+		exit(0);
+	}
+	sendRemote(RemoteEvent::KEY, key, x, y, 0, 0);
+}
+
+void clientMouse(int button, int state, int x, int y) {
+	sendRemote(RemoteEvent::MOUSE, button, state, x, y, glutGetModifiers());
+}
+
+void clientActiveMotion(int x, int y) {
+	sendRemote(RemoteEvent::MOTION, 0, 0, x, y, 0);
+}
+
+void clientPassiveMotion(int x, int y) {
+	sendRemote(RemoteEvent::PASSIVE, 0, 0, x, y, 0);
+}
+
+void clientResize(int w, int h) {
+	window_width  = w;
+	window_height = h;
+	sendRemote(RemoteEvent::RESIZE, w, h, 0, 0, 0);
+}
+
+/**********************************************************************************//**
+ * \brief runs the thin client, showing frames from the server at host:port
+ *************************************************************************************/
+void runClient(const string &hostPort) {
+	size_t colon = hostPort.rfind(':');
+	if(colon == string::npos)
+		printUsage((char*) "ViewLR");
+	if(!client.connect(hostPort.substr(0, colon), atoi(hostPort.c_str()+colon+1)))
+		exit(2);
+
+	int glArgc = 0;
+	glutInit(&glArgc, NULL);
+	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
+	glutInitWindowSize(window_width, window_height);
+	glutCreateWindow(("LR spline volume (" + hostPort + ")").c_str());
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	sendRemote(RemoteEvent::RESIZE, window_width, window_height, 0, 0, 0);
+
+	receiver = thread(receiveFrames);
+
+	glutDisplayFunc(clientDisplay);
+	glutKeyboardFunc(clientKeypress);
+	glutMouseFunc(clientMouse);
+	glutMotionFunc(clientActiveMotion);
+	glutPassiveMotionFunc(clientPassiveMotion);
+	glutReshapeFunc(clientResize);
+	glutIdleFunc(clientIdle);
 
+	glutMainLoop();
+}
+
+int main(int argc, char **argv) {
+	vector<char*> fileNames;
+	for(int i=1; i<argc; i++) {
+		if(strcmp(argv[i], "--stats") == 0)
+			showStats = true;
+		else if(strcmp(argv[i], "--hugepages") == 0)
+			arena.setHugePages(true);
+		else if(strcmp(argv[i], "--release-model") == 0)
+			releaseModel = true;
+		else if(strcmp(argv[i], "--capture") == 0 && i+1 < argc) {
+			captureTarget  = argv[++i];
+			captureAtStart = true;
+		} else if(strcmp(argv[i], "--fps") == 0 && i+1 < argc)
+			captureFps = atof(argv[++i]);
+		else if(strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+			captureFrames = atol(argv[++i]);
+		else if(strcmp(argv[i], "--out-of-core") == 0 && i+1 < argc) {
+			brickFile = argv[++i];
+			outOfCore = true;
+		} else if(strcmp(argv[i], "--budget") == 0 && i+1 < argc)
+			brickBudget = atol(argv[++i]);
+		else if(strcmp(argv[i], "--moving-quality") == 0 && i+1 < argc)
+			quality.setMovingLevel(atoi(argv[++i]));
+		else if(strcmp(argv[i], "--still-delay") == 0 && i+1 < argc)
+			quality.setStillDelay(atof(argv[++i]));
+		else if(strcmp(argv[i], "--attribute") == 0 && i+1 < argc)
+			attributeFiles.push_back(argv[++i]);
+		else if(strcmp(argv[i], "--views") == 0 && i+1 < argc)
+			layout = argv[++i];
+		else if(strcmp(argv[i], "--poster") == 0 && i+1 < argc) {
+			posterFile    = argv[++i];
+			posterAtStart = true;
+		} else if(strcmp(argv[i], "--poster-width") == 0 && i+1 < argc)
+			posterWidth = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--export") == 0 && i+1 < argc)
+			exportFile = argv[++i];
+		else if(strcmp(argv[i], "--renderer") == 0 && i+1 < argc)
+			rendererName = argv[++i];
+		else if(strcmp(argv[i], "--overview") == 0 && i+1 < argc) {
+			string mode = argv[++i];
+			overviewMode = (mode == "count") ? DensityMap::COUNT : (mode == "depth") ? DensityMap::DEPTH : -1;
+			if(overviewMode < 0)
+				printUsage(argv[0]);
+		} else if(strcmp(argv[i], "--overview-resolution") == 0 && i+1 < argc)
+			overviewSize = max(2, atoi(argv[++i]));
+		else if(strcmp(argv[i], "--locate") == 0 && i+1 < argc)
+			locateFile = argv[++i];
+		else if(strcmp(argv[i], "--locate-out") == 0 && i+1 < argc)
+			locateOut = argv[++i];
+		else if(strcmp(argv[i], "--check") == 0)
+			checkAtLoad = true;
+		else if(strcmp(argv[i], "--edge-shader") == 0)
+			edgeShading = true;
+		else if(strcmp(argv[i], "--refine") == 0)
+			refineMode = true;
+		else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+			TaskPool::shared().setThreads(atoi(argv[++i]));
+		else if(strcmp(argv[i], "--serve") == 0 && i+1 < argc)
+			servePort = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bind") == 0 && i+1 < argc)
+			serveAddress = argv[++i];
+		else if(strcmp(argv[i], "--connect") == 0 && i+1 < argc)
+			connectTo = argv[++i];
+		else if(argv[i][0] == '-')
+			printUsage(argv[0]);
+		else
+			fileNames.push_back(argv[i]);
+	}
+	if(!connectTo.empty())
+		runClient(connectTo);
+	if(fileNames.empty())
+		printUsage(argv[0]);
+	backend = RenderBackend::create(rendererName);
+	if(!backend)
+		printUsage(argv[0]);
+	if(refineMode && (fileNames.size() != 1 || outOfCore || releaseModel || !exportFile.empty())) {
+		cerr << "--refine needs exactly one file, and the model kept in memory" << endl;
+		exit(1);
+	}
+	if(!locateOut.empty() && locateFile.empty())
+		printUsage(argv[0]);
+	if(refineMode && locateFile == "-") {
+		cerr << "--refine and --locate cannot both read stdin" << endl;
+		exit(1);
+	}
+	if(outOfCore && !locateFile.empty()) {
+		cerr << "--locate needs the elements in memory, not --out-of-core" << endl;
+		exit(1);
+	}
+	if(outOfCore && checkAtLoad) {
+		cerr << "--check needs the elements in memory, not --out-of-core" << endl;
+		exit(1);
+	}
+	if(outOfCore && !exportFile.empty()) {
+		cerr << "--export needs the elements in memory, not --out-of-core" << endl;
+		exit(1);
+	}
+	if(outOfCore && overviewMode >= 0) {
+		cerr << "--overview needs the elements in memory, not --out-of-core" << endl;
+		exit(1);
+	}
+	// the video owns stdout, so everything else that would go there is status
+	if(captureTarget == "-") {
+		cout.rdbuf(cerr.rdbuf());
+		statusFile = stderr;
+	}
+
+	// exporting needs no window, only the buffers
+	if(!exportFile.empty()) {
+		loadScene(fileNames);
+		return exportMesh(exportFile) ? 0 : 3;
+	}
+
+	// so does batch point location
+	if(!locateOut.empty()) {
+		loadScene(fileNames);
+		return locatePoints() ? 0 : 3;
+	}
+	
 	// initalize GLUT
 	int glArgc = 0;
 	glutInit(&glArgc, NULL);
@@ -881,6 +3087,19 @@ int main(int argc, char **argv) {
 	
 	glutCreateWindow("LR spline volume (parametric space)");
 	initRendering();
+	if(servePort) {
+		if(!server.listen(servePort, serveAddress))
+			exit(2);
+		glutHideWindow();
+		cout << "Serving frames on " << serveAddress << ":" << servePort << endl;
+	}
+	if(captureAtStart)
+		capture.start(captureTarget, window_width, window_height, captureFps);
+
+	// the window is up; the mesh shows up as it is parsed and tessellated
+	loader = new thread(loadScene, fileNames);
+	if(refineMode)
+		thread(readRefineInput).detach();
 	
 	glutDisplayFunc(drawScene);
 	glutKeyboardFunc(handleKeypress);